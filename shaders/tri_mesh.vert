@@ -23,9 +23,15 @@ layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer
 	ObjectData objects[];
 } objectBuffer;
 
+//object buffer index of every instance, in draw order on the cpu path and draw object order on the gpu driven one
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer
+{
+	uint objectIndices[];
+} instanceBuffer;
+
 void main()
 {
-	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+	mat4 modelMatrix = objectBuffer.objects[instanceBuffer.objectIndices[gl_InstanceIndex]].model;
 	mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
 	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
 	outColor = vColor;
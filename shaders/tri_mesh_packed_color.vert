@@ -0,0 +1,59 @@
+#version 460
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec2 vNormal;
+layout (location = 2) in vec4 vColor;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 texCoord;
+layout (location = 2) out vec3 outNormal;
+
+layout(set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+} cameraData;
+
+struct ObjectData
+{
+	mat4 model;
+};
+layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+} objectBuffer;
+
+//object buffer index of every instance, in draw order on the cpu path and draw object order on the gpu driven one
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer
+{
+	uint objectIndices[];
+} instanceBuffer;
+
+//VertexQuantization, value = offset + unorm * scale
+layout(push_constant) uniform Dequantization
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	vec4 uvOffsetScale;
+} dequant;
+
+vec3 octahedral_decode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 position = dequant.positionOffset.xyz + vPosition.xyz * dequant.positionScale.xyz;
+	mat4 modelMatrix = objectBuffer.objects[instanceBuffer.objectIndices[gl_InstanceIndex]].model;
+	mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
+	gl_Position = transformMatrix * vec4(position, 1.0f);
+	outColor = vColor.rgb;
+	texCoord = dequant.uvOffsetScale.xy + vTexCoord * dequant.uvOffsetScale.zw;
+	outNormal = octahedral_decode(vNormal);
+}
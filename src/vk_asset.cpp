@@ -0,0 +1,356 @@
+#include "vk_asset.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//a blob of a mapped .vkmesh, behind the header, aligned and inside the file without the sum wrapping around
+	bool blob_in_file(uint64_t offset, uint64_t bytes, size_t fileSize)
+	{
+		return offset >= sizeof(vkn::MeshFileHeader) && offset % vkn::MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && bytes <= fileSize - offset;
+	}
+}
+
+namespace vkn
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const char* path)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		_file = file;
+		_mapping = mapping;
+		_data = static_cast<const uint8_t*>(view);
+		_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED)
+			return false;
+
+		madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+		_data = static_cast<const uint8_t*>(view);
+		_size = static_cast<size_t>(st.st_size);
+#endif
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (!_data)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+		CloseHandle(_mapping);
+		CloseHandle(_file);
+		_mapping = nullptr;
+		_file = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+	bool save_mesh_file(const char* path, Mesh& mesh, uint32_t flags)
+	{
+		const VkIndexType indexType = mesh.select_index_type();
+
+		MeshFileHeader header = {};
+		header.magic = MESH_FILE_MAGIC;
+		header.version = MESH_FILE_VERSION;
+		header.vertexFormat = mesh._vertexFormat;
+		header.vertexStride = vertex_stride(mesh._vertexFormat);
+		header.vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+		header.indexCount = static_cast<uint32_t>(mesh._indices.size());
+		header.indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		header.flags = flags | (mesh._meshlets.empty() ? 0 : MESH_FILE_FLAG_MESHLETS) | (mesh._lods.empty() ? 0 : MESH_FILE_FLAG_LODS);
+		memcpy(header.boundsMin, &mesh._bounds.min, sizeof(header.boundsMin));
+		memcpy(header.boundsMax, &mesh._bounds.max, sizeof(header.boundsMax));
+		memcpy(header.boundsOrigin, &mesh._bounds.origin, sizeof(header.boundsOrigin));
+		header.boundsRadius = mesh._bounds.radius;
+
+		std::vector<uint8_t> vertexData;
+		mesh.pack_vertices(vertexData);
+		header.quantization = mesh._quantization;
+
+		header.vertexBytes = uint64_t(header.vertexCount) * header.vertexStride;
+		header.vertexOffset = align_up(sizeof(MeshFileHeader), MESH_FILE_ALIGNMENT);
+		header.indexBytes = uint64_t(header.indexCount) * header.indexSize;
+		header.indexOffset = align_up(header.vertexOffset + header.vertexBytes, MESH_FILE_ALIGNMENT);
+		header.meshletCount = static_cast<uint32_t>(mesh._meshlets.size());
+		header.meshletStride = sizeof(Meshlet);
+		header.meshletBytes = uint64_t(header.meshletCount) * header.meshletStride;
+		header.meshletOffset = align_up(header.indexOffset + header.indexBytes, MESH_FILE_ALIGNMENT);
+		header.lodCount = static_cast<uint32_t>(mesh._lods.size());
+		header.lodStride = sizeof(MeshLod);
+		header.lodBytes = uint64_t(header.lodCount) * header.lodStride;
+		header.lodOffset = align_up(header.meshletOffset + header.meshletBytes, MESH_FILE_ALIGNMENT);
+
+		std::vector<uint8_t> blob(header.lodOffset + header.lodBytes, 0);
+		memcpy(blob.data(), &header, sizeof(MeshFileHeader));
+		memcpy(blob.data() + header.vertexOffset, vertexData.data(), header.vertexBytes);
+		if (indexType == VK_INDEX_TYPE_UINT16)
+		{
+			uint16_t* indices = reinterpret_cast<uint16_t*>(blob.data() + header.indexOffset);
+			for (size_t i = 0; i < mesh._indices.size(); i++)
+				indices[i] = static_cast<uint16_t>(mesh._indices[i]);
+		}
+		else
+		{
+			memcpy(blob.data() + header.indexOffset, mesh._indices.data(), header.indexBytes);
+		}
+		if (header.meshletBytes > 0)
+			memcpy(blob.data() + header.meshletOffset, mesh._meshlets.data(), header.meshletBytes);
+		if (header.lodBytes > 0)
+			memcpy(blob.data() + header.lodOffset, mesh._lods.data(), header.lodBytes);
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+		return file.good();
+	}
+
+	bool read_mesh_file(const MappedFile& file, MeshFileHeader& outHeader, MeshFileBlobs& outBlobs)
+	{
+		if (!file.data() || file.size() < sizeof(MeshFileHeader))
+			return false;
+
+		memcpy(&outHeader, file.data(), sizeof(MeshFileHeader));
+		if (outHeader.magic != MESH_FILE_MAGIC)
+			return false;
+
+		if (outHeader.version != MESH_FILE_VERSION)
+		{
+			std::cout << "Mesh file version " << outHeader.version << " does not match " << MESH_FILE_VERSION << ", recook the assets" << std::endl;
+			return false;
+		}
+
+		if (outHeader.vertexFormat > VertexFormat::PackedColor || outHeader.vertexStride != vertex_stride(outHeader.vertexFormat))
+			return false;
+
+		if (outHeader.indexSize != sizeof(uint16_t) && outHeader.indexSize != sizeof(uint32_t))
+			return false;
+
+		if ((outHeader.meshletCount > 0 && outHeader.meshletStride != sizeof(Meshlet)) || (outHeader.lodCount > 0 && outHeader.lodStride != sizeof(MeshLod)))
+			return false;
+
+		//the loaders go by the counts, the sizes have to cover exactly that many elements
+		if (outHeader.vertexBytes != uint64_t(outHeader.vertexCount) * outHeader.vertexStride || outHeader.indexBytes != uint64_t(outHeader.indexCount) * outHeader.indexSize
+			|| outHeader.meshletBytes != uint64_t(outHeader.meshletCount) * sizeof(Meshlet) || outHeader.lodBytes != uint64_t(outHeader.lodCount) * sizeof(MeshLod))
+			return false;
+
+		if (!blob_in_file(outHeader.vertexOffset, outHeader.vertexBytes, file.size()) || !blob_in_file(outHeader.indexOffset, outHeader.indexBytes, file.size())
+			|| !blob_in_file(outHeader.meshletOffset, outHeader.meshletBytes, file.size()) || !blob_in_file(outHeader.lodOffset, outHeader.lodBytes, file.size()))
+			return false;
+
+		outBlobs.vertices = file.data() + outHeader.vertexOffset;
+		outBlobs.indices = file.data() + outHeader.indexOffset;
+		outBlobs.meshlets = outHeader.meshletCount > 0 ? file.data() + outHeader.meshletOffset : nullptr;
+		outBlobs.lods = outHeader.lodCount > 0 ? file.data() + outHeader.lodOffset : nullptr;
+
+		//draws and the culling shader index straight into the index buffer with these ranges
+		for (uint32_t i = 0; i < outHeader.meshletCount; i++)
+		{
+			Meshlet meshlet;
+			memcpy(&meshlet, outBlobs.meshlets + sizeof(Meshlet) * i, sizeof(Meshlet));
+			if (uint64_t(meshlet.firstIndex) + uint64_t(meshlet.triangleCount) * 3 > outHeader.indexCount)
+				return false;
+		}
+		for (uint32_t i = 0; i < outHeader.lodCount; i++)
+		{
+			MeshLod lod;
+			memcpy(&lod, outBlobs.lods + sizeof(MeshLod) * i, sizeof(MeshLod));
+			if (uint64_t(lod.firstIndex) + lod.indexCount > outHeader.indexCount)
+				return false;
+		}
+		return true;
+	}
+
+	void apply_mesh_file_header(const MeshFileHeader& header, const MeshFileBlobs& blobs, Mesh& outMesh)
+	{
+		memcpy(&outMesh._bounds.min, header.boundsMin, sizeof(header.boundsMin));
+		memcpy(&outMesh._bounds.max, header.boundsMax, sizeof(header.boundsMax));
+		memcpy(&outMesh._bounds.origin, header.boundsOrigin, sizeof(header.boundsOrigin));
+		outMesh._bounds.radius = header.boundsRadius;
+		outMesh._vertexCount = header.vertexCount;
+		outMesh._indexCount = header.indexCount;
+		outMesh._indexType = header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		outMesh._vertexFormat = header.vertexFormat;
+		outMesh._quantization = header.quantization;
+
+		outMesh._meshlets.resize(header.meshletCount);
+		if (header.meshletCount > 0)
+			memcpy(outMesh._meshlets.data(), blobs.meshlets, header.meshletBytes);
+
+		outMesh._lods.resize(header.lodCount);
+		if (header.lodCount > 0)
+			memcpy(outMesh._lods.data(), blobs.lods, header.lodBytes);
+	}
+
+	bool load_mesh_file(const char* path, Mesh& outMesh)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return false;
+
+		MeshFileHeader header;
+		MeshFileBlobs blobs;
+		if (!read_mesh_file(file, header, blobs))
+		{
+			std::cout << "Invalid mesh file " << path << std::endl;
+			return false;
+		}
+
+		apply_mesh_file_header(header, blobs, outMesh);
+		outMesh.unpack_vertices(blobs.vertices, header.vertexCount);
+
+		outMesh._indices.resize(header.indexCount);
+		if (header.indexSize == sizeof(uint16_t))
+		{
+			const uint16_t* src = reinterpret_cast<const uint16_t*>(blobs.indices);
+			for (uint32_t i = 0; i < header.indexCount; i++)
+				outMesh._indices[i] = src[i];
+		}
+		else
+		{
+			memcpy(outMesh._indices.data(), blobs.indices, header.indexBytes);
+		}
+		return true;
+	}
+
+	bool save_texture_file(const char* path, const ImageData& image)
+	{
+		TextureFileHeader header = {};
+		header.magic = TEXTURE_FILE_MAGIC;
+		header.version = TEXTURE_FILE_VERSION;
+		header.format = image.format;
+		header.width = image.width;
+		header.height = image.height;
+		header.mipLevels = image.mipLevels;
+		header.dataOffset = align_up(sizeof(TextureFileHeader), MESH_FILE_ALIGNMENT);
+		header.dataBytes = mip_level_offset(image, image.mipLevels);
+		if (image.pixels.size() != header.dataBytes)
+			return false;
+
+		std::vector<uint8_t> blob(header.dataOffset, 0);
+		memcpy(blob.data(), &header, sizeof(TextureFileHeader));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+		file.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+		return file.good();
+	}
+
+	bool read_texture_file(const MappedFile& file, TextureFileHeader& outHeader, const uint8_t*& outData)
+	{
+		if (!file.data() || file.size() < sizeof(TextureFileHeader))
+			return false;
+
+		memcpy(&outHeader, file.data(), sizeof(TextureFileHeader));
+		if (outHeader.magic != TEXTURE_FILE_MAGIC)
+			return false;
+
+		if (outHeader.version != TEXTURE_FILE_VERSION)
+		{
+			std::cout << "Texture file version " << outHeader.version << " does not match " << TEXTURE_FILE_VERSION << ", recook the assets" << std::endl;
+			return false;
+		}
+
+		if (outHeader.format > TextureFormat::Bc7 || outHeader.width == 0 || outHeader.height == 0
+			|| outHeader.mipLevels == 0 || outHeader.mipLevels > mip_level_count(outHeader.width, outHeader.height))
+			return false;
+
+		if (outHeader.dataBytes != mip_level_offset(outHeader.format, outHeader.width, outHeader.height, outHeader.mipLevels)
+			|| outHeader.dataOffset + outHeader.dataBytes > file.size())
+			return false;
+
+		outData = file.data() + outHeader.dataOffset;
+		return true;
+	}
+
+	bool load_texture_file(const char* path, ImageData& outImage)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return false;
+
+		TextureFileHeader header;
+		const uint8_t* data;
+		if (!read_texture_file(file, header, data))
+		{
+			std::cout << "Invalid texture file " << path << std::endl;
+			return false;
+		}
+
+		outImage.width = header.width;
+		outImage.height = header.height;
+		outImage.mipLevels = header.mipLevels;
+		outImage.format = header.format;
+		outImage.pixels.assign(data, data + header.dataBytes);
+		return true;
+	}
+}
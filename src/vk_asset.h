@@ -0,0 +1,118 @@
+#pragma once
+#include "vk_types.h"
+#include "vk_mesh.h"
+#include "vk_image.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vkn
+{
+	//read only view of a whole file, backed by the OS page cache
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const char* path);
+		void close();
+
+		const uint8_t* data() const { return _data; }
+		size_t size() const { return _size; }
+
+	private:
+		const uint8_t* _data{ nullptr };
+		size_t _size{ 0 };
+#ifdef _WIN32
+		void* _file{ nullptr };
+		void* _mapping{ nullptr };
+#endif
+	};
+
+	//cooked mesh container (.vkmesh)
+	//[MeshFileHeader][pad][vertex blob][pad][index blob][pad][meshlet blob][pad][lod blob], blobs aligned to MESH_FILE_ALIGNMENT
+	constexpr uint32_t MESH_FILE_MAGIC = 0x534D4B56; // "VKMS"
+	constexpr uint32_t MESH_FILE_VERSION = 4;
+	constexpr uint32_t MESH_FILE_ALIGNMENT = 16;
+
+	//MeshFileHeader::flags
+	constexpr uint32_t MESH_FILE_FLAG_OPTIMIZED = 1u << 0; //vk_mesh_optimizer passes were applied
+	constexpr uint32_t MESH_FILE_FLAG_MESHLETS = 1u << 1; //indices are in meshlet order and the meshlet blob is present
+	constexpr uint32_t MESH_FILE_FLAG_LODS = 1u << 2; //the index blob holds a lod chain described by the lod blob
+
+	struct MeshFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		VertexFormat vertexFormat;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexSize;
+		uint32_t flags;
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundsOrigin[3];
+		float boundsRadius;
+		VertexQuantization quantization; //only meaningful for the packed vertex formats
+		uint64_t vertexOffset;
+		uint64_t vertexBytes;
+		uint64_t indexOffset;
+		uint64_t indexBytes;
+		uint32_t meshletCount;
+		uint32_t meshletStride; //sizeof(Meshlet) when written
+		uint64_t meshletOffset;
+		uint64_t meshletBytes;
+		uint32_t lodCount;
+		uint32_t lodStride; //sizeof(MeshLod) when written
+		uint64_t lodOffset;
+		uint64_t lodBytes;
+	};
+
+	//writes the vertices in mesh._vertexFormat, which updates the mesh quantization for packed formats
+	//mesh._meshlets and mesh._lods are stored when present and their flags are set for them
+	bool save_mesh_file(const char* path, Mesh& mesh, uint32_t flags = 0);
+
+	//blobs of a mapped .vkmesh, the optional ones are null when the file has none
+	struct MeshFileBlobs
+	{
+		const uint8_t* vertices;
+		const uint8_t* indices;
+		const uint8_t* meshlets;
+		const uint8_t* lods;
+	};
+
+	//validates the header of a mapped .vkmesh and returns pointers to its blobs
+	bool read_mesh_file(const MappedFile& file, MeshFileHeader& outHeader, MeshFileBlobs& outBlobs);
+	//header fields, meshlets and lods, which the cpu keeps for culling and lod selection even when the rest only goes to the gpu
+	void apply_mesh_file_header(const MeshFileHeader& header, const MeshFileBlobs& blobs, Mesh& outMesh);
+
+	//cpu only load, fills the mesh arrays from the blobs, packed vertices are dequantized
+	bool load_mesh_file(const char* path, Mesh& outMesh);
+
+	//cooked texture container (.vktex)
+	//[TextureFileHeader][pad][mip chain], the levels back to back in the layout of ImageData::pixels
+	constexpr uint32_t TEXTURE_FILE_MAGIC = 0x58544B56; // "VKTX"
+	constexpr uint32_t TEXTURE_FILE_VERSION = 1;
+
+	struct TextureFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		TextureFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint64_t dataOffset;
+		uint64_t dataBytes;
+	};
+
+	bool save_texture_file(const char* path, const ImageData& image);
+	//validates the header of a mapped .vktex and returns a pointer to its mip chain
+	bool read_texture_file(const MappedFile& file, TextureFileHeader& outHeader, const uint8_t*& outData);
+	//cpu only load, for the tools
+	bool load_texture_file(const char* path, ImageData& outImage);
+}
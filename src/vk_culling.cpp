@@ -0,0 +1,188 @@
+#include "vk_culling.h"
+#include "vk_parallel.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX__)
+#define VKN_CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define VKN_CULL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//spheres one worker culls at a time, big enough that handing chunks out costs nothing next to testing them
+	constexpr size_t CULL_CHUNK_SIZE = 16384;
+
+#if defined(VKN_CULL_AVX)
+	using Wide = __m256;
+	constexpr size_t CULL_LANES = 8;
+	inline Wide wide_load(const float* values) { return _mm256_loadu_ps(values); }
+	inline Wide wide_set(float value) { return _mm256_set1_ps(value); }
+	inline Wide wide_add(Wide a, Wide b) { return _mm256_add_ps(a, b); }
+	inline Wide wide_mul(Wide a, Wide b) { return _mm256_mul_ps(a, b); }
+	inline Wide wide_and(Wide a, Wide b) { return _mm256_and_ps(a, b); }
+	//set where a < b does not hold, nan included, so the lanes agree with the scalar test
+	inline Wide wide_not_less(Wide a, Wide b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+	inline uint32_t wide_mask(Wide a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+#elif defined(VKN_CULL_SSE2)
+	using Wide = __m128;
+	constexpr size_t CULL_LANES = 4;
+	inline Wide wide_load(const float* values) { return _mm_loadu_ps(values); }
+	inline Wide wide_set(float value) { return _mm_set1_ps(value); }
+	inline Wide wide_add(Wide a, Wide b) { return _mm_add_ps(a, b); }
+	inline Wide wide_mul(Wide a, Wide b) { return _mm_mul_ps(a, b); }
+	inline Wide wide_and(Wide a, Wide b) { return _mm_and_ps(a, b); }
+	inline Wide wide_not_less(Wide a, Wide b) { return _mm_cmpnlt_ps(a, b); }
+	inline uint32_t wide_mask(Wide a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+#endif
+
+#if defined(VKN_CULL_AVX) || defined(VKN_CULL_SSE2)
+	//the frustum planes broadcast to every lane once per range
+	struct WideFrustum
+	{
+		Wide x[6];
+		Wide y[6];
+		Wide z[6];
+		Wide w[6];
+	};
+
+	//bit i is set when sphere index + i is inside, the arithmetic runs in the same order as sphere_in_frustum
+	inline uint32_t cull_block(const WideFrustum& frustum, const vkn::SphereArrays& spheres, size_t index)
+	{
+		const Wide x = wide_load(&spheres.x[index]);
+		const Wide y = wide_load(&spheres.y[index]);
+		const Wide z = wide_load(&spheres.z[index]);
+		const Wide negativeRadius = wide_mul(wide_load(&spheres.radius[index]), wide_set(-1.f));
+
+		auto plane_test = [&](int i)
+		{
+			const Wide distance = wide_add(wide_mul(x, frustum.x[i]), wide_mul(y, frustum.y[i]));
+			return wide_not_less(wide_add(wide_add(distance, wide_mul(z, frustum.z[i])), frustum.w[i]), negativeRadius);
+		};
+		Wide inside = plane_test(0);
+		for (int i = 1; i < 6; i++)
+			inside = wide_and(inside, plane_test(i));
+		return wide_mask(inside);
+	}
+#endif
+}
+
+namespace vkn
+{
+	Frustum extract_frustum(const glm::mat4& matrix)
+	{
+		//glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		const glm::vec4 row0{ matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0] };
+		const glm::vec4 row1{ matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1] };
+		const glm::vec4 row2{ matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2] };
+		const glm::vec4 row3{ matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3] };
+
+		//the projection is built with glm's -1..1 depth, using that near plane keeps the test conservative for vulkan's 0..1
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0;
+		frustum.planes[1] = row3 - row0;
+		frustum.planes[2] = row3 + row1;
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row3 + row2;
+		frustum.planes[5] = row3 - row2;
+
+		for (glm::vec4& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center, float radius)
+	{
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	void SphereArrays::resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		radius.resize(count);
+	}
+
+	void SphereArrays::set(size_t index, const glm::vec3& center, float sphereRadius)
+	{
+		x[index] = center.x;
+		y[index] = center.y;
+		z[index] = center.z;
+		radius[index] = sphereRadius;
+	}
+
+	size_t cull_sphere_range(const Frustum& frustum, const SphereArrays& spheres, size_t begin, size_t end, uint32_t* outVisible)
+	{
+		size_t visibleCount = 0;
+		size_t i = begin;
+#if defined(VKN_CULL_AVX) || defined(VKN_CULL_SSE2)
+		WideFrustum wideFrustum;
+		for (int p = 0; p < 6; p++)
+		{
+			wideFrustum.x[p] = wide_set(frustum.planes[p].x);
+			wideFrustum.y[p] = wide_set(frustum.planes[p].y);
+			wideFrustum.z[p] = wide_set(frustum.planes[p].z);
+			wideFrustum.w[p] = wide_set(frustum.planes[p].w);
+		}
+
+		for (; i + CULL_LANES <= end; i += CULL_LANES)
+		{
+			const uint32_t mask = cull_block(wideFrustum, spheres, i);
+			if (mask == 0)
+				continue;
+			//every lane is written and only the inside ones are kept, which never runs past the lanes tested so far
+			for (size_t lane = 0; lane < CULL_LANES; lane++)
+			{
+				outVisible[visibleCount] = static_cast<uint32_t>(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+#endif
+		for (; i < end; i++)
+		{
+			if (sphere_in_frustum(frustum, glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]))
+				outVisible[visibleCount++] = static_cast<uint32_t>(i);
+		}
+		return visibleCount;
+	}
+
+	void cull_spheres(const Frustum& frustum, const SphereArrays& spheres, std::vector<uint32_t>& visible)
+	{
+		const size_t count = spheres.size();
+		visible.resize(count);
+		if (count < PARALLEL_CULL_THRESHOLD)
+		{
+			visible.resize(cull_sphere_range(frustum, spheres, 0, count, visible.data()));
+			return;
+		}
+
+		//every chunk culls into its own part of the output, the parts are moved together in order afterwards
+		const size_t chunkCount = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+		std::vector<size_t> chunkVisible(chunkCount);
+		parallel_for(chunkCount, [&](size_t chunk)
+		{
+			const size_t begin = chunk * CULL_CHUNK_SIZE;
+			const size_t end = std::min(begin + CULL_CHUNK_SIZE, count);
+			chunkVisible[chunk] = cull_sphere_range(frustum, spheres, begin, end, visible.data() + begin);
+		});
+
+		size_t visibleCount = chunkVisible[0];
+		for (size_t chunk = 1; chunk < chunkCount; chunk++)
+		{
+			memmove(visible.data() + visibleCount, visible.data() + chunk * CULL_CHUNK_SIZE, sizeof(uint32_t) * chunkVisible[chunk]);
+			visibleCount += chunkVisible[chunk];
+		}
+		visible.resize(visibleCount);
+	}
+}
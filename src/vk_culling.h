@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace vkn
+{
+	//planes point inwards, xyz normalized normal and w distance, a point p is inside when dot(xyz, p) + w >= 0 for all six
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+	};
+
+	//frustum of a clip space matrix (Gribb/Hartmann), the planes end up in whatever space the matrix takes its input in
+	//so passing viewproj * model gives object space planes
+	Frustum extract_frustum(const glm::mat4& matrix);
+
+	bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center, float radius);
+
+	//spheres below this count are culled on the calling thread, starting the workers costs more than they save
+	constexpr size_t PARALLEL_CULL_THRESHOLD = 65536;
+
+	//bounding spheres of many objects, one array per component so the planes are tested against 4 or 8 of them at once
+	struct SphereArrays
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+
+		size_t size() const { return radius.size(); }
+		void resize(size_t count);
+		void set(size_t index, const glm::vec3& center, float sphereRadius);
+	};
+
+	//same test as sphere_in_frustum over [begin, end), writes the indices of the spheres that pass to outVisible in
+	//ascending order and returns how many, outVisible needs room for end - begin
+	size_t cull_sphere_range(const Frustum& frustum, const SphereArrays& spheres, size_t begin, size_t end, uint32_t* outVisible);
+
+	//every sphere in the arrays, spread over the worker threads from PARALLEL_CULL_THRESHOLD spheres on
+	//visible is overwritten with the indices that pass, in ascending order
+	void cull_spheres(const Frustum& frustum, const SphereArrays& spheres, std::vector<uint32_t>& visible);
+}
@@ -0,0 +1,118 @@
+#include "vk_frame_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VKN_STREAM_STORES 1
+#endif
+
+namespace
+{
+	void create_mapped_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, AllocatedBuffer& outBuffer, uint8_t*& outData)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		VmaAllocationInfo mapped;
+		vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &outBuffer._buffer, &outBuffer._allocation, &mapped);
+		outData = static_cast<uint8_t*>(mapped.pMappedData);
+	}
+}
+
+namespace vkn
+{
+	void FrameAllocator::init(VmaAllocator newAllocator, VkDeviceSize capacity, VkBufferUsageFlags usage, RetireQueue* retire, const Timeline* timeline)
+	{
+		_allocator = newAllocator;
+		_retire = retire;
+		_timeline = timeline;
+		_usage = usage;
+		_capacity = capacity;
+		_used = 0;
+		create_mapped_buffer(_allocator, _capacity, _usage, _buffer, _data);
+	}
+
+	void FrameAllocator::cleanup()
+	{
+		vmaDestroyBuffer(_allocator, _buffer._buffer, _buffer._allocation);
+	}
+
+	void FrameAllocator::reset()
+	{
+		_used = 0;
+	}
+
+	FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		const VkDeviceSize offset = (_used + alignment - 1) & ~(alignment - 1);
+		if (offset + size > _capacity)
+			grow(offset + size);
+
+		_used = offset + size;
+		FrameAllocation allocation;
+		allocation.data = _data + offset;
+		allocation.buffer = _buffer._buffer;
+		allocation.offset = offset;
+		return allocation;
+	}
+
+	void FrameAllocator::flush()
+	{
+#if VKN_STREAM_STORES
+		_mm_sfence();
+#endif
+		if (_used > 0)
+			vmaFlushAllocation(_allocator, _buffer._allocation, 0, _used);
+	}
+
+	void FrameAllocator::grow(VkDeviceSize minCapacity)
+	{
+		AllocatedBuffer buffer;
+		uint8_t* data;
+		const VkDeviceSize capacity = std::max(minCapacity, _capacity * 2);
+		create_mapped_buffer(_allocator, capacity, _usage, buffer, data);
+
+		//reads from write combined memory are slow, but this only happens until the capacity settled
+		memcpy(data, _data, _used);
+		_retire->retire_buffer(_timeline->next(), _buffer);
+		_buffer = buffer;
+		_data = data;
+		_capacity = capacity;
+		_generation++;
+	}
+
+	void stream_copy(void* dst, const void* src, size_t bytes)
+	{
+#if VKN_STREAM_STORES
+		if ((reinterpret_cast<uintptr_t>(dst) & 15) == 0)
+		{
+			__m128i* out = static_cast<__m128i*>(dst);
+			const __m128i* in = static_cast<const __m128i*>(src);
+			size_t blocks = bytes / 16;
+			for (; blocks >= 4; blocks -= 4, out += 4, in += 4)
+			{
+				const __m128i a = _mm_loadu_si128(in + 0);
+				const __m128i b = _mm_loadu_si128(in + 1);
+				const __m128i c = _mm_loadu_si128(in + 2);
+				const __m128i d = _mm_loadu_si128(in + 3);
+				_mm_stream_si128(out + 0, a);
+				_mm_stream_si128(out + 1, b);
+				_mm_stream_si128(out + 2, c);
+				_mm_stream_si128(out + 3, d);
+			}
+			for (; blocks > 0; blocks--, out++, in++)
+				_mm_stream_si128(out, _mm_loadu_si128(in));
+			memcpy(out, in, bytes & 15);
+			return;
+		}
+#endif
+		memcpy(dst, src, bytes);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "vk_types.h"
+#include "vk_retire.h"
+#include "vk_timeline.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vkn
+{
+	//a slice of a frame allocator, data points into mapped write combined memory, write it once and never read it
+	struct FrameAllocation
+	{
+		void* data;
+		VkBuffer buffer;
+		VkDeviceSize offset;
+	};
+
+	//bump allocator over one persistently mapped host visible buffer, for uniform and storage data that only lives
+	//for one frame, reset once the frame's submission retired
+	//when an allocation does not fit, the buffer is replaced by one at least twice the size and what the frame wrote
+	//so far is copied over, so earlier offsets stay valid in the new buffer, the old one is retired with the frame
+	class FrameAllocator
+	{
+	public:
+		//replaced buffers are retired at the value timeline signals next, the one of the frame being recorded
+		void init(VmaAllocator newAllocator, VkDeviceSize capacity, VkBufferUsageFlags usage, RetireQueue* retire, const Timeline* timeline);
+		void cleanup();
+
+		//the gpu must be done with everything handed out since the last reset
+		void reset();
+		//alignment has to be a power of two
+		FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+		//orders the streamed writes and makes them visible to the gpu, call it before submitting work that reads them
+		void flush();
+
+		VkBuffer buffer() const { return _buffer._buffer; }
+		//changes whenever the buffer is replaced, descriptors written against an older one need writing again
+		uint32_t generation() const { return _generation; }
+		VkDeviceSize used() const { return _used; }
+		VkDeviceSize capacity() const { return _capacity; }
+
+	private:
+		void grow(VkDeviceSize minCapacity);
+
+		VmaAllocator _allocator;
+		VkBufferUsageFlags _usage;
+		AllocatedBuffer _buffer{};
+		uint8_t* _data{ nullptr };
+		VkDeviceSize _capacity{ 0 };
+		VkDeviceSize _used{ 0 };
+		uint32_t _generation{ 0 };
+		RetireQueue* _retire{ nullptr };
+		const Timeline* _timeline{ nullptr };
+	};
+
+	//copies with non temporal stores where dst is 16 byte aligned, so write combined memory gets whole lines and the
+	//data does not evict anything on its way, FrameAllocator::flush orders them before the gpu reads
+	void stream_copy(void* dst, const void* src, size_t bytes);
+}
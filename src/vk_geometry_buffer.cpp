@@ -0,0 +1,175 @@
+#include "vk_geometry_buffer.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void create_geometry_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, const std::vector<uint32_t>& queueFamilies,
+		AllocatedBuffer& outBuffer)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		if (queueFamilies.size() > 1)
+		{
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+		}
+
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &outBuffer._buffer, &outBuffer._allocation, nullptr);
+	}
+}
+
+namespace vkn
+{
+	void RangeAllocator::init(VkDeviceSize size)
+	{
+		_capacity = size;
+		_used = 0;
+		_allocations = 0;
+		_freeByOffset.clear();
+		_freeBySize.clear();
+		insert_free(0, size);
+	}
+
+	bool RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset)
+	{
+		if (size == 0)
+			return false;
+
+		//smallest range first, a range only fails when alignment padding pushes the end out, which the next ones
+		//up in size absorb
+		for (auto candidate = _freeBySize.lower_bound(size); candidate != _freeBySize.end(); ++candidate)
+		{
+			const VkDeviceSize rangeSize = candidate->first;
+			const VkDeviceSize rangeOffset = candidate->second;
+			const VkDeviceSize offset = align_up(rangeOffset, alignment);
+			if (offset + size > rangeOffset + rangeSize)
+				continue;
+
+			erase_free(_freeByOffset.find(rangeOffset));
+			if (offset > rangeOffset)
+				insert_free(rangeOffset, offset - rangeOffset);
+			const VkDeviceSize end = offset + size;
+			if (end < rangeOffset + rangeSize)
+				insert_free(end, rangeOffset + rangeSize - end);
+
+			_used += size;
+			_allocations++;
+			outOffset = offset;
+			return true;
+		}
+		return false;
+	}
+
+	void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (size == 0)
+			return;
+		_used -= size;
+		_allocations--;
+
+		VkDeviceSize start = offset;
+		VkDeviceSize end = offset + size;
+		auto next = _freeByOffset.lower_bound(offset);
+		if (next != _freeByOffset.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == start)
+			{
+				start = previous->first;
+				erase_free(previous);
+			}
+		}
+		if (next != _freeByOffset.end() && next->first == end)
+		{
+			end += next->second;
+			erase_free(next);
+		}
+		insert_free(start, end - start);
+	}
+
+	RangeStats RangeAllocator::stats() const
+	{
+		RangeStats stats = {};
+		stats.capacity = _capacity;
+		stats.used = _used;
+		stats.allocations = _allocations;
+		stats.freeRanges = static_cast<uint32_t>(_freeByOffset.size());
+		stats.largestFree = _freeBySize.empty() ? 0 : _freeBySize.rbegin()->first;
+		//padding between aligned ranges is free space too, so it counts here
+		const VkDeviceSize freeBytes = _capacity - _used;
+		stats.fragmentation = freeBytes > 0 ? 1.f - static_cast<float>(stats.largestFree) / static_cast<float>(freeBytes) : 0.f;
+		return stats;
+	}
+
+	void RangeAllocator::insert_free(VkDeviceSize offset, VkDeviceSize size)
+	{
+		_freeByOffset.emplace(offset, size);
+		_freeBySize.emplace(size, offset);
+	}
+
+	void RangeAllocator::erase_free(std::map<VkDeviceSize, VkDeviceSize>::iterator range)
+	{
+		auto sized = _freeBySize.equal_range(range->second);
+		for (auto it = sized.first; it != sized.second; ++it)
+		{
+			if (it->second == range->first)
+			{
+				_freeBySize.erase(it);
+				break;
+			}
+		}
+		_freeByOffset.erase(range);
+	}
+
+	void GeometryBuffer::init(VmaAllocator newAllocator, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, const std::vector<uint32_t>& queueFamilies)
+	{
+		_allocator = newAllocator;
+		create_geometry_buffer(_allocator, vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, queueFamilies, _vertexBuffer);
+		create_geometry_buffer(_allocator, indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, queueFamilies, _indexBuffer);
+		_vertexRanges.init(vertexCapacity);
+		_indexRanges.init(indexCapacity);
+	}
+
+	void GeometryBuffer::cleanup()
+	{
+		vmaDestroyBuffer(_allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
+		vmaDestroyBuffer(_allocator, _indexBuffer._buffer, _indexBuffer._allocation);
+	}
+
+	bool GeometryBuffer::allocate(VkDeviceSize vertexBytes, uint32_t vertexStride, VkDeviceSize indexBytes, uint32_t indexSize, GeometryAllocation& outAllocation)
+	{
+		VkDeviceSize vertexOffset;
+		if (!_vertexRanges.allocate(vertexBytes, vertexStride, vertexOffset))
+			return false;
+		VkDeviceSize indexOffset;
+		if (!_indexRanges.allocate(indexBytes, indexSize, indexOffset))
+		{
+			_vertexRanges.free(vertexOffset, vertexBytes);
+			return false;
+		}
+
+		outAllocation.vertexOffset = vertexOffset;
+		outAllocation.vertexBytes = vertexBytes;
+		outAllocation.indexOffset = indexOffset;
+		outAllocation.indexBytes = indexBytes;
+		return true;
+	}
+
+	void GeometryBuffer::free(const GeometryAllocation& allocation)
+	{
+		_vertexRanges.free(allocation.vertexOffset, allocation.vertexBytes);
+		_indexRanges.free(allocation.indexOffset, allocation.indexBytes);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "vk_types.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace vkn
+{
+	struct RangeStats
+	{
+		VkDeviceSize capacity;
+		VkDeviceSize used;
+		VkDeviceSize largestFree;
+		uint32_t allocations;
+		uint32_t freeRanges;
+		//share of the free space outside the largest free range, 0 when all of it is in one piece
+		float fragmentation;
+	};
+
+	//sub-allocates ranges of a fixed size space, best fit over a free list that is coalesced on every free
+	class RangeAllocator
+	{
+	public:
+		void init(VkDeviceSize size);
+
+		//false when no free range fits, alignment does not have to be a power of two so vertex strides work as is
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset);
+		//offset and size exactly as allocated
+		void free(VkDeviceSize offset, VkDeviceSize size);
+
+		RangeStats stats() const;
+
+	private:
+		void insert_free(VkDeviceSize offset, VkDeviceSize size);
+		void erase_free(std::map<VkDeviceSize, VkDeviceSize>::iterator range);
+
+		VkDeviceSize _capacity{ 0 };
+		VkDeviceSize _used{ 0 };
+		uint32_t _allocations{ 0 };
+		//offset to size, neighbours are found here when coalescing
+		std::map<VkDeviceSize, VkDeviceSize> _freeByOffset;
+		//size to offset, the best fit search runs here
+		std::multimap<VkDeviceSize, VkDeviceSize> _freeBySize;
+	};
+
+	//where a mesh lives in the geometry buffer, byte offsets and sizes
+	struct GeometryAllocation
+	{
+		VkDeviceSize vertexOffset;
+		VkDeviceSize vertexBytes;
+		VkDeviceSize indexOffset;
+		VkDeviceSize indexBytes;
+	};
+
+	//one vertex and one index buffer every mesh is sub-allocated from, so draws of different meshes only differ in
+	//vertexOffset and firstIndex and the buffers stay bound
+	class GeometryBuffer
+	{
+	public:
+		//more than one queue family makes the buffers concurrent over them, uploads from another family then write new
+		//ranges while graphics keeps reading the others without a release of the whole buffer first
+		void init(VmaAllocator newAllocator, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, const std::vector<uint32_t>& queueFamilies);
+		void cleanup();
+
+		//the vertex range is aligned to the stride and the index range to the index size, so both can be addressed
+		//in elements from the start of the buffers, false when either does not fit
+		bool allocate(VkDeviceSize vertexBytes, uint32_t vertexStride, VkDeviceSize indexBytes, uint32_t indexSize, GeometryAllocation& outAllocation);
+		//the gpu must be done with the ranges
+		void free(const GeometryAllocation& allocation);
+
+		const AllocatedBuffer& vertex_buffer() const { return _vertexBuffer; }
+		const AllocatedBuffer& index_buffer() const { return _indexBuffer; }
+		RangeStats vertex_stats() const { return _vertexRanges.stats(); }
+		RangeStats index_stats() const { return _indexRanges.stats(); }
+
+	private:
+		VmaAllocator _allocator;
+		AllocatedBuffer _vertexBuffer;
+		AllocatedBuffer _indexBuffer;
+		RangeAllocator _vertexRanges;
+		RangeAllocator _indexRanges;
+	};
+}
@@ -0,0 +1,357 @@
+#include "vk_gltf.h"
+#include "vk_parallel.h"
+
+//tinygltf is built without its own stb_image include, the declarations come from here and the implementation from vk_image.cpp
+#include <stb_image.h>
+#define TINYGLTF_IMPLEMENTATION
+#include <tiny_gltf.h>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	//encoded images tinygltf hands over while parsing (glb buffer views and data uris), decoded later on the workers
+	struct EncodedImages
+	{
+		std::vector<std::vector<uint8_t>> bytes;
+	};
+
+	bool store_encoded_image(tinygltf::Image*, const int imageIndex, std::string*, std::string*, int, int,
+		const unsigned char* bytes, int size, void* userData)
+	{
+		EncodedImages& encoded = *static_cast<EncodedImages*>(userData);
+		if (encoded.bytes.size() <= size_t(imageIndex))
+			encoded.bytes.resize(imageIndex + 1);
+		encoded.bytes[imageIndex].assign(bytes, bytes + size);
+		return true;
+	}
+
+	//typed view of an accessor, element i starts at data + i * stride
+	struct AccessorView
+	{
+		const uint8_t* data;
+		size_t stride;
+		size_t count;
+		int componentType;
+		int components;
+		bool normalized;
+	};
+
+	bool view_accessor(const tinygltf::Model& model, int accessorIndex, AccessorView& outView)
+	{
+		if (accessorIndex < 0 || size_t(accessorIndex) >= model.accessors.size())
+			return false;
+		const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+		if (accessor.sparse.isSparse || accessor.bufferView < 0 || size_t(accessor.bufferView) >= model.bufferViews.size())
+			return false;
+
+		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+		if (bufferView.buffer < 0 || size_t(bufferView.buffer) >= model.buffers.size())
+			return false;
+		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+
+		const int stride = accessor.ByteStride(bufferView);
+		const int components = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+		const int componentSize = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+		if (stride <= 0 || components <= 0 || componentSize <= 0)
+			return false;
+
+		const size_t offset = bufferView.byteOffset + accessor.byteOffset;
+		const size_t elementSize = size_t(components) * componentSize;
+		if (accessor.count > 0 && offset + (accessor.count - 1) * stride + elementSize > buffer.data.size())
+			return false;
+
+		outView.data = buffer.data.data() + offset;
+		outView.stride = static_cast<size_t>(stride);
+		outView.count = accessor.count;
+		outView.componentType = accessor.componentType;
+		outView.components = components;
+		outView.normalized = accessor.normalized;
+		return true;
+	}
+
+	//component c of element i as a float, normalized integers map to 0..1 or -1..1 as the spec defines
+	float read_float(const AccessorView& view, size_t i, int c)
+	{
+		const uint8_t* element = view.data + i * view.stride;
+		switch (view.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_FLOAT:
+		{
+			float value;
+			memcpy(&value, element + c * sizeof(float), sizeof(float));
+			return value;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return view.normalized ? element[c] / 255.f : float(element[c]);
+		case TINYGLTF_COMPONENT_TYPE_BYTE:
+		{
+			const int8_t value = static_cast<int8_t>(element[c]);
+			return view.normalized ? std::max(value / 127.f, -1.f) : float(value);
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, element + c * sizeof(uint16_t), sizeof(uint16_t));
+			return view.normalized ? value / 65535.f : float(value);
+		}
+		case TINYGLTF_COMPONENT_TYPE_SHORT:
+		{
+			int16_t value;
+			memcpy(&value, element + c * sizeof(int16_t), sizeof(int16_t));
+			return view.normalized ? std::max(value / 32767.f, -1.f) : float(value);
+		}
+		default:
+			return 0.f;
+		}
+	}
+
+	uint32_t read_index(const AccessorView& view, size_t i)
+	{
+		const uint8_t* element = view.data + i * view.stride;
+		switch (view.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return element[0];
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, element, sizeof(uint16_t));
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, element, sizeof(uint32_t));
+			return value;
+		}
+		}
+	}
+
+	int find_attribute(const tinygltf::Primitive& primitive, const char* name)
+	{
+		auto it = primitive.attributes.find(name);
+		return it == primitive.attributes.end() ? -1 : it->second;
+	}
+
+	bool decode_primitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, Mesh& outMesh)
+	{
+		AccessorView positions;
+		if (!view_accessor(model, find_attribute(primitive, "POSITION"), positions) || positions.components != 3
+			|| positions.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT)
+			return false;
+
+		AccessorView normals, uvs, colors;
+		const bool hasNormals = view_accessor(model, find_attribute(primitive, "NORMAL"), normals) && normals.components == 3 && normals.count == positions.count;
+		const bool hasUvs = view_accessor(model, find_attribute(primitive, "TEXCOORD_0"), uvs) && uvs.components == 2 && uvs.count == positions.count;
+		const bool hasColors = view_accessor(model, find_attribute(primitive, "COLOR_0"), colors) && colors.components >= 3 && colors.count == positions.count;
+
+		outMesh._vertices.resize(positions.count);
+		for (size_t i = 0; i < positions.count; i++)
+		{
+			Vertex& vertex = outMesh._vertices[i];
+			vertex.position = { read_float(positions, i, 0), read_float(positions, i, 1), read_float(positions, i, 2) };
+			vertex.normal = hasNormals ? glm::vec3{ read_float(normals, i, 0), read_float(normals, i, 1), read_float(normals, i, 2) } : glm::vec3{ 0.f };
+			vertex.color = hasColors ? glm::vec3{ read_float(colors, i, 0), read_float(colors, i, 1), read_float(colors, i, 2) } : glm::vec3{ 0.f };
+			//gltf puts the uv origin at the top left like vulkan does, no flip unlike obj
+			vertex.uv = hasUvs ? glm::vec2{ read_float(uvs, i, 0), read_float(uvs, i, 1) } : glm::vec2{ 0.f };
+		}
+
+		if (primitive.indices >= 0)
+		{
+			AccessorView indices;
+			if (!view_accessor(model, primitive.indices, indices) || indices.components != 1 || indices.count % 3 != 0)
+				return false;
+
+			outMesh._indices.resize(indices.count);
+			for (size_t i = 0; i < indices.count; i++)
+			{
+				outMesh._indices[i] = read_index(indices, i);
+				if (outMesh._indices[i] >= positions.count)
+					return false;
+			}
+		}
+		else
+		{
+			//unindexed, one vertex per corner like obj before welding
+			if (positions.count % 3 != 0)
+				return false;
+			outMesh.weld_vertices();
+		}
+
+		outMesh.compute_bounds();
+		outMesh._indexType = outMesh.select_index_type();
+		return true;
+	}
+
+	glm::mat4 node_transform(const tinygltf::Node& node)
+	{
+		if (node.matrix.size() == 16)
+		{
+			glm::dmat4 matrix = glm::make_mat4(node.matrix.data());
+			return glm::mat4(matrix);
+		}
+
+		glm::mat4 transform{ 1.f };
+		if (node.translation.size() == 3)
+			transform = glm::translate(glm::vec3(glm::make_vec3(node.translation.data())));
+		if (node.rotation.size() == 4)
+		{
+			//gltf stores x y z w, glm takes w first
+			const glm::quat rotation(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
+			transform = transform * glm::mat4_cast(rotation);
+		}
+		if (node.scale.size() == 3)
+			transform = transform * glm::scale(glm::vec3(glm::make_vec3(node.scale.data())));
+		return transform;
+	}
+
+	std::string directory_of(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+}
+
+namespace vkn
+{
+	bool load_gltf(const char* path, GltfScene& outScene, const std::function<void(Mesh&)>& processMesh)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		tinygltf::TinyGLTF loader;
+		EncodedImages encoded;
+		loader.SetImageLoader(store_encoded_image, &encoded);
+
+		tinygltf::Model model;
+		std::string err, warn;
+		const std::string filename = path;
+		const bool binary = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".glb") == 0;
+		const bool parsed = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, filename) : loader.LoadASCIIFromFile(&model, &err, &warn, filename);
+		if (!warn.empty())
+			std::cout << "glTF warning " << path << ": " << warn << std::endl;
+		if (!parsed)
+		{
+			std::cout << "Failed to load glTF " << path << ": " << err << std::endl;
+			return false;
+		}
+		encoded.bytes.resize(model.images.size());
+
+		//one decode job per triangle primitive, gltf meshes map to ranges of them
+		struct PrimitiveSource
+		{
+			const tinygltf::Primitive* primitive;
+		};
+		std::vector<PrimitiveSource> sources;
+		outScene.meshes.resize(model.meshes.size());
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			outScene.meshes[m].firstPrimitive = static_cast<uint32_t>(sources.size());
+			for (const tinygltf::Primitive& primitive : model.meshes[m].primitives)
+			{
+				if (primitive.mode == TINYGLTF_MODE_TRIANGLES || primitive.mode == -1)
+					sources.push_back({ &primitive });
+			}
+			outScene.meshes[m].primitiveCount = static_cast<uint32_t>(sources.size()) - outScene.meshes[m].firstPrimitive;
+		}
+
+		outScene.primitives.resize(sources.size());
+		outScene.images.resize(model.images.size());
+		const std::string directory = directory_of(filename);
+		std::atomic<uint32_t> failedPrimitives{ 0 };
+		std::atomic<uint32_t> failedImages{ 0 };
+
+		//images first, they are the longest jobs
+		parallel_for(model.images.size() + sources.size(), [&](size_t job)
+		{
+			if (job < model.images.size())
+			{
+				const tinygltf::Image& image = model.images[job];
+				const std::vector<uint8_t>& bytes = encoded.bytes[job];
+				const bool decoded = !bytes.empty() ? decode_image(bytes.data(), bytes.size(), outScene.images[job])
+					: !image.uri.empty() && load_image((directory + image.uri).c_str(), outScene.images[job]);
+				if (!decoded)
+					failedImages++;
+				return;
+			}
+
+			const size_t p = job - model.images.size();
+			GltfPrimitive& primitive = outScene.primitives[p];
+			primitive.material = sources[p].primitive->material;
+			if (!decode_primitive(model, *sources[p].primitive, primitive.mesh))
+			{
+				failedPrimitives++;
+				primitive.mesh = Mesh{};
+				return;
+			}
+			if (processMesh)
+				processMesh(primitive.mesh);
+		});
+
+		outScene.materials.resize(model.materials.size());
+		for (size_t m = 0; m < model.materials.size(); m++)
+		{
+			const tinygltf::PbrMetallicRoughness& pbr = model.materials[m].pbrMetallicRoughness;
+			const int texture = pbr.baseColorTexture.index;
+			if (texture >= 0 && size_t(texture) < model.textures.size())
+				outScene.materials[m].baseColorImage = model.textures[texture].source;
+			if (pbr.baseColorFactor.size() == 4)
+				outScene.materials[m].baseColorFactor = glm::vec4(glm::make_vec4(pbr.baseColorFactor.data()));
+		}
+
+		//walk the node hierarchy, every node with a mesh becomes an instance of it
+		std::vector<int> roots;
+		if (!model.scenes.empty())
+			roots = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0].nodes;
+		else
+		{
+			std::vector<bool> isChild(model.nodes.size(), false);
+			for (const tinygltf::Node& node : model.nodes)
+			{
+				for (int child : node.children)
+				{
+					if (child >= 0 && size_t(child) < isChild.size())
+						isChild[child] = true;
+				}
+			}
+			for (size_t n = 0; n < model.nodes.size(); n++)
+			{
+				if (!isChild[n])
+					roots.push_back(static_cast<int>(n));
+			}
+		}
+
+		std::vector<std::pair<int, glm::mat4>> stack;
+		for (auto it = roots.rbegin(); it != roots.rend(); it++)
+			stack.push_back({ *it, glm::mat4{ 1.f } });
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, parent] = stack.back();
+			stack.pop_back();
+			if (nodeIndex < 0 || size_t(nodeIndex) >= model.nodes.size())
+				continue;
+
+			const tinygltf::Node& node = model.nodes[nodeIndex];
+			const glm::mat4 transform = parent * node_transform(node);
+			if (node.mesh >= 0 && size_t(node.mesh) < outScene.meshes.size())
+				outScene.instances.push_back({ static_cast<uint32_t>(node.mesh), transform });
+			for (auto it = node.children.rbegin(); it != node.children.rend(); it++)
+				stack.push_back({ *it, transform });
+		}
+
+		if (failedPrimitives > 0 || failedImages > 0)
+			std::cout << "glTF " << path << ": skipped " << failedPrimitives << " primitives and " << failedImages << " images it could not decode" << std::endl;
+
+		auto end = std::chrono::high_resolution_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+		std::cout << "glTF loaded " << path << ", " << outScene.meshes.size() << " meshes (" << outScene.primitives.size() << " primitives), "
+			<< outScene.instances.size() << " instances, " << outScene.images.size() << " images in " << diff.count() / 1000.f << " ms" << std::endl;
+		return true;
+	}
+}
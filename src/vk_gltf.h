@@ -0,0 +1,53 @@
+#pragma once
+#include "vk_mesh.h"
+#include "vk_image.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+namespace vkn
+{
+	struct GltfMaterial
+	{
+		int baseColorImage{ -1 }; //index into GltfScene::images, -1 when untextured
+		glm::vec4 baseColorFactor{ 1.f };
+	};
+
+	//a gltf mesh primitive, engine meshes carry a single material so every primitive becomes its own Mesh
+	struct GltfPrimitive
+	{
+		Mesh mesh;
+		int material{ -1 };
+	};
+
+	//range of GltfScene::primitives
+	struct GltfMesh
+	{
+		uint32_t firstPrimitive;
+		uint32_t primitiveCount;
+	};
+
+	//a node that draws a mesh, every node referencing the same gltf mesh shares its primitives
+	struct GltfInstance
+	{
+		uint32_t mesh;
+		glm::mat4 transform;
+	};
+
+	struct GltfScene
+	{
+		std::vector<GltfPrimitive> primitives;
+		std::vector<GltfMesh> meshes;
+		std::vector<GltfMaterial> materials;
+		std::vector<ImageData> images;
+		std::vector<GltfInstance> instances;
+	};
+
+	//cpu side load of a .gltf or .glb, primitives and images are decoded on the worker threads
+	//processMesh runs on the worker that decoded a primitive, right after its mesh is complete
+	//only triangle primitives with float positions are kept, skins, morph targets and sparse accessors are not supported
+	bool load_gltf(const char* path, GltfScene& outScene, const std::function<void(Mesh&)>& processMesh = nullptr);
+}
@@ -0,0 +1,201 @@
+#include "vk_image.h"
+#include "vk_parallel.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define VKN_IMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//rows of the destination level a mip task filters
+	constexpr uint32_t MIP_ROWS_PER_TASK = 32;
+	//resolution of the linear -> srgb table, fine enough that the darkest srgb steps still span several entries
+	constexpr uint32_t LINEAR_TO_SRGB_STEPS = 65536;
+
+	bool take_pixels(stbi_uc* pixels, int width, int height, vkn::ImageData& outImage)
+	{
+		if (!pixels)
+			return false;
+
+		outImage.width = static_cast<uint32_t>(width);
+		outImage.height = static_cast<uint32_t>(height);
+		outImage.mipLevels = 1;
+		outImage.pixels.resize(size_t(width) * height * 4);
+		memcpy(outImage.pixels.data(), pixels, outImage.pixels.size());
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	struct SrgbTables
+	{
+		float toLinear[256];
+		uint8_t toSrgb[LINEAR_TO_SRGB_STEPS];
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				const float c = i / 255.f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < LINEAR_TO_SRGB_STEPS; i++)
+			{
+				const float l = i / float(LINEAR_TO_SRGB_STEPS - 1);
+				const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+				toSrgb[i] = static_cast<uint8_t>(std::min(255.f, c * 255.f + 0.5f));
+			}
+		}
+	};
+
+	const SrgbTables& srgb_tables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	//one destination row, every texel averages the 2x2 block under it, the last row or column is reused when the
+	//source is a single texel wide or tall
+	void downsample_row(const SrgbTables& tables, const uint8_t* row0, const uint8_t* row1, uint32_t srcWidth, uint8_t* dst, uint32_t dstWidth)
+	{
+		const uint32_t lastX = srcWidth - 1;
+#ifdef VKN_IMAGE_SSE2
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 scale = _mm_set_ps(255.f, float(LINEAR_TO_SRGB_STEPS - 1), float(LINEAR_TO_SRGB_STEPS - 1), float(LINEAR_TO_SRGB_STEPS - 1));
+		const __m128 alphaBias = _mm_set_ps(0.5f, 0.f, 0.f, 0.f);
+		auto texel = [&](const uint8_t* p)
+		{
+			return _mm_set_ps(p[3] * (1.f / 255.f), tables.toLinear[p[2]], tables.toLinear[p[1]], tables.toLinear[p[0]]);
+		};
+
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			const uint32_t x0 = std::min(x * 2, lastX) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, lastX) * 4;
+			__m128 sum = _mm_add_ps(_mm_add_ps(texel(row0 + x0), texel(row0 + x1)), _mm_add_ps(texel(row1 + x0), texel(row1 + x1)));
+			sum = _mm_min_ps(_mm_max_ps(_mm_mul_ps(sum, quarter), zero), one);
+
+			//rgb become table indices, alpha is already the rounded result
+			alignas(16) int32_t packed[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(packed), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, scale), alphaBias)));
+			dst[x * 4 + 0] = tables.toSrgb[packed[0]];
+			dst[x * 4 + 1] = tables.toSrgb[packed[1]];
+			dst[x * 4 + 2] = tables.toSrgb[packed[2]];
+			dst[x * 4 + 3] = static_cast<uint8_t>(packed[3]);
+		}
+#else
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			const uint32_t x0 = std::min(x * 2, lastX) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, lastX) * 4;
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				const float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+				dst[x * 4 + c] = tables.toSrgb[static_cast<uint32_t>(std::min(1.f, sum * 0.25f) * (LINEAR_TO_SRGB_STEPS - 1))];
+			}
+			const uint32_t alpha = row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3];
+			dst[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) / 4);
+		}
+#endif
+	}
+}
+
+namespace vkn
+{
+	bool load_image(const char* path, ImageData& outImage)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
+		return take_pixels(pixels, width, height, outImage);
+	}
+
+	bool decode_image(const uint8_t* data, size_t size, ImageData& outImage)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channels, STBI_rgb_alpha);
+		return take_pixels(pixels, width, height, outImage);
+	}
+
+	uint32_t mip_level_count(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+			levels++;
+		return levels;
+	}
+
+	uint32_t mip_level_width(const ImageData& image, uint32_t level)
+	{
+		return std::max(1u, image.width >> level);
+	}
+
+	uint32_t mip_level_height(const ImageData& image, uint32_t level)
+	{
+		return std::max(1u, image.height >> level);
+	}
+
+	size_t mip_level_bytes(TextureFormat format, uint32_t width, uint32_t height)
+	{
+		if (format == TextureFormat::Rgba8)
+			return size_t(width) * height * 4;
+
+		const size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+		return blocks * (format == TextureFormat::Bc1 ? 8 : 16);
+	}
+
+	size_t mip_level_offset(TextureFormat format, uint32_t width, uint32_t height, uint32_t level)
+	{
+		size_t offset = 0;
+		for (uint32_t l = 0; l < level; l++)
+			offset += mip_level_bytes(format, std::max(1u, width >> l), std::max(1u, height >> l));
+		return offset;
+	}
+
+	size_t mip_level_offset(const ImageData& image, uint32_t level)
+	{
+		return mip_level_offset(image.format, image.width, image.height, level);
+	}
+
+	void generate_mips(ImageData& image)
+	{
+		if (image.pixels.empty() || image.format != TextureFormat::Rgba8)
+			return;
+
+		const uint32_t levels = mip_level_count(image.width, image.height);
+		image.mipLevels = 1;
+		image.pixels.resize(mip_level_offset(image, levels));
+		const SrgbTables& tables = srgb_tables();
+
+		//each level reads the one before it, so the levels run in order and their rows are split across the workers
+		for (uint32_t level = 1; level < levels; level++)
+		{
+			const uint32_t srcWidth = mip_level_width(image, level - 1);
+			const uint32_t srcHeight = mip_level_height(image, level - 1);
+			const uint32_t dstWidth = mip_level_width(image, level);
+			const uint32_t dstHeight = mip_level_height(image, level);
+			const uint8_t* src = image.pixels.data() + mip_level_offset(image, level - 1);
+			uint8_t* dst = image.pixels.data() + mip_level_offset(image, level);
+
+			const uint32_t tasks = (dstHeight + MIP_ROWS_PER_TASK - 1) / MIP_ROWS_PER_TASK;
+			parallel_for(tasks, [&](size_t task)
+			{
+				const uint32_t end = std::min<uint32_t>(dstHeight, uint32_t(task + 1) * MIP_ROWS_PER_TASK);
+				for (uint32_t y = uint32_t(task) * MIP_ROWS_PER_TASK; y < end; y++)
+				{
+					const uint8_t* row0 = src + size_t(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+					const uint8_t* row1 = src + size_t(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+					downsample_row(tables, row0, row1, srcWidth, dst + size_t(y) * dstWidth * 4, dstWidth);
+				}
+			});
+		}
+		image.mipLevels = levels;
+	}
+}
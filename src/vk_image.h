@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkn
+{
+	//layout of ImageData::pixels, the block compressed formats store 4x4 texel blocks row by row
+	enum class TextureFormat : uint32_t
+	{
+		Rgba8, //4 bytes per texel
+		Bc1, //8 bytes per block, opaque
+		Bc3, //16 bytes per block, bc1 color plus interpolated alpha
+		Bc7, //16 bytes per block
+	};
+
+	//decoded image, rows tightly packed, always srgb color with linear alpha
+	//pixels holds mipLevels levels back to back, level 0 first, each half the size of the previous one rounded down
+	struct ImageData
+	{
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t mipLevels{ 1 };
+		TextureFormat format{ TextureFormat::Rgba8 };
+		std::vector<uint8_t> pixels;
+	};
+
+	//png, jpg, tga... anything stb_image reads, always expanded to rgba, safe to call from several threads
+	bool load_image(const char* path, ImageData& outImage);
+	bool decode_image(const uint8_t* data, size_t size, ImageData& outImage);
+
+	//levels of a full chain down to 1x1
+	uint32_t mip_level_count(uint32_t width, uint32_t height);
+	uint32_t mip_level_width(const ImageData& image, uint32_t level);
+	uint32_t mip_level_height(const ImageData& image, uint32_t level);
+	//bytes of one level, partial blocks at the edges of compressed levels count as whole ones
+	size_t mip_level_bytes(TextureFormat format, uint32_t width, uint32_t height);
+	//byte offset of a level inside ImageData::pixels, mip_level_offset(image, image.mipLevels) is the size of the chain
+	size_t mip_level_offset(TextureFormat format, uint32_t width, uint32_t height, uint32_t level);
+	size_t mip_level_offset(const ImageData& image, uint32_t level);
+
+	//appends the full mip chain to a single level rgba8 image, every level is a 2x2 box filter of the previous one
+	//done in linear space so srgb colors darken correctly, alpha is averaged as is
+	//rows of each level are filtered on the worker threads
+	void generate_mips(ImageData& image);
+}
@@ -0,0 +1,700 @@
+#include "vk_image_compress.h"
+#include "vk_parallel.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	//least squares refits of the endpoints after the initial principal axis fit, the best pass is kept
+	constexpr uint32_t ENDPOINT_REFINE_PASSES = 2;
+	//bc7 interpolation weights for 2 and 4 bit indices, out of 64
+	constexpr uint32_t BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+	constexpr uint32_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	uint32_t block_bytes(vkn::TextureFormat format)
+	{
+		return format == vkn::TextureFormat::Bc1 ? 8 : 16;
+	}
+
+	//direction of largest variance of the block, zero when every texel is the same
+	glm::vec4 principal_axis(const glm::vec4* points, const glm::vec4& mean)
+	{
+		glm::mat4 covariance{ 0.f };
+		glm::vec4 minimum{ 255.f };
+		glm::vec4 maximum{ 0.f };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const glm::vec4 d = points[i] - mean;
+			covariance += glm::outerProduct(d, d);
+			minimum = glm::min(minimum, points[i]);
+			maximum = glm::max(maximum, points[i]);
+		}
+
+		//power iteration, seeded with the bounding box diagonal which is usually close already
+		glm::vec4 axis = maximum - minimum;
+		if (glm::dot(axis, axis) == 0.f)
+			return axis;
+		axis = glm::normalize(axis);
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			const glm::vec4 next = covariance * axis;
+			const float length = glm::length(next);
+			if (length < 1e-6f)
+				break;
+			axis = next / length;
+		}
+		return axis;
+	}
+
+	//endpoints at the extremes of the texels projected on the principal axis
+	void fit_endpoints(const glm::vec4* points, glm::vec4& outLow, glm::vec4& outHigh)
+	{
+		glm::vec4 mean{ 0.f };
+		for (uint32_t i = 0; i < 16; i++)
+			mean += points[i];
+		mean /= 16.f;
+
+		const glm::vec4 axis = principal_axis(points, mean);
+		float minT = 0.f;
+		float maxT = 0.f;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const float t = glm::dot(points[i] - mean, axis);
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		outLow = glm::clamp(mean + axis * minT, 0.f, 255.f);
+		outHigh = glm::clamp(mean + axis * maxT, 0.f, 255.f);
+	}
+
+	//endpoints that minimize the squared error for fixed interpolation weights, weights[i] is how much of the second
+	//endpoint texel i gets, false when every texel uses the same weight and the system has no unique solution
+	bool refit_endpoints(const glm::vec4* points, const float* weights, glm::vec4& outFirst, glm::vec4& outSecond)
+	{
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		glm::vec4 ax{ 0.f };
+		glm::vec4 bx{ 0.f };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const float b = weights[i];
+			const float a = 1.f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ax += a * points[i];
+			bx += b * points[i];
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+		outFirst = glm::clamp((bb * ax - ab * bx) / determinant, 0.f, 255.f);
+		outSecond = glm::clamp((aa * bx - ab * ax) / determinant, 0.f, 255.f);
+		return true;
+	}
+
+	uint32_t squared_error(const uint8_t* a, const uint8_t* b, uint32_t channels)
+	{
+		uint32_t error = 0;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			const int d = int(a[c]) - int(b[c]);
+			error += uint32_t(d * d);
+		}
+		return error;
+	}
+
+	uint16_t pack_565(const glm::vec4& color)
+	{
+		const uint32_t r = uint32_t(color.r * (31.f / 255.f) + 0.5f);
+		const uint32_t g = uint32_t(color.g * (63.f / 255.f) + 0.5f);
+		const uint32_t b = uint32_t(color.b * (31.f / 255.f) + 0.5f);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void unpack_565(uint16_t color, uint8_t* outColor)
+	{
+		const uint32_t r = (color >> 11) & 31;
+		const uint32_t g = (color >> 5) & 63;
+		const uint32_t b = color & 31;
+		outColor[0] = uint8_t((r << 3) | (r >> 2));
+		outColor[1] = uint8_t((g << 2) | (g >> 4));
+		outColor[2] = uint8_t((b << 3) | (b >> 2));
+		outColor[3] = 255;
+	}
+
+	//bc3 color blocks always interpolate four colors, bc1 only when the first endpoint is the larger one
+	void bc1_palette(uint16_t c0, uint16_t c1, bool fourColors, uint8_t (*outPalette)[4])
+	{
+		unpack_565(c0, outPalette[0]);
+		unpack_565(c1, outPalette[1]);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			const uint32_t p0 = outPalette[0][c];
+			const uint32_t p1 = outPalette[1][c];
+			if (fourColors)
+			{
+				outPalette[2][c] = uint8_t((2 * p0 + p1) / 3);
+				outPalette[3][c] = uint8_t((p0 + 2 * p1) / 3);
+			}
+			else
+			{
+				outPalette[2][c] = uint8_t((p0 + p1) / 2);
+				outPalette[3][c] = 0;
+			}
+		}
+		outPalette[2][3] = 255;
+		outPalette[3][3] = fourColors ? 255 : 0;
+	}
+
+	//rgb part shared by bc1 and bc3, always written in four color mode
+	void encode_color_block(const uint8_t* texels, uint8_t* outBlock)
+	{
+		glm::vec4 points[16];
+		for (uint32_t i = 0; i < 16; i++)
+			points[i] = glm::vec4{ texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], 0.f };
+
+		glm::vec4 first, second;
+		fit_endpoints(points, second, first);
+
+		//index -> share of the second endpoint
+		constexpr float weightOf[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+		uint32_t bestError = UINT32_MAX;
+		uint16_t best0 = 0, best1 = 0;
+		uint32_t bestIndices = 0;
+		for (uint32_t pass = 0; pass <= ENDPOINT_REFINE_PASSES; pass++)
+		{
+			uint16_t c0 = pack_565(first);
+			uint16_t c1 = pack_565(second);
+			if (c0 < c1)
+			{
+				std::swap(c0, c1);
+				std::swap(first, second);
+			}
+
+			uint8_t palette[4][4];
+			bc1_palette(c0, c1, true, palette);
+			uint32_t indices = 0;
+			uint32_t error = 0;
+			float weights[16];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t bestIndex = 0;
+				uint32_t bestTexelError = UINT32_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					const uint32_t texelError = squared_error(texels + i * 4, palette[p], 3);
+					if (texelError < bestTexelError)
+					{
+						bestTexelError = texelError;
+						bestIndex = p;
+					}
+				}
+				indices |= bestIndex << (i * 2);
+				error += bestTexelError;
+				weights[i] = weightOf[bestIndex];
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				best0 = c0;
+				best1 = c1;
+				bestIndices = indices;
+			}
+			if (error == 0 || c0 == c1 || !refit_endpoints(points, weights, first, second))
+				break;
+		}
+
+		//equal endpoints select bc1's three color mode, where index 3 is transparent black
+		if (best0 == best1)
+			bestIndices = 0;
+
+		memcpy(outBlock + 0, &best0, 2);
+		memcpy(outBlock + 2, &best1, 2);
+		memcpy(outBlock + 4, &bestIndices, 4);
+	}
+
+	void bc4_palette(uint8_t a0, uint8_t a1, uint8_t* outPalette)
+	{
+		outPalette[0] = a0;
+		outPalette[1] = a1;
+		if (a0 > a1)
+		{
+			for (uint32_t i = 2; i < 8; i++)
+				outPalette[i] = uint8_t(((8 - i) * a0 + (i - 1) * a1 + 3) / 7);
+		}
+		else
+		{
+			for (uint32_t i = 2; i < 6; i++)
+				outPalette[i] = uint8_t(((6 - i) * a0 + (i - 1) * a1 + 2) / 5);
+			outPalette[6] = 0;
+			outPalette[7] = 255;
+		}
+	}
+
+	//alpha half of bc3, the block's range split in 8 steps
+	void encode_alpha_block(const uint8_t* texels, uint8_t* outBlock)
+	{
+		uint8_t minimum = 255;
+		uint8_t maximum = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, texels[i * 4 + 3]);
+			maximum = std::max(maximum, texels[i * 4 + 3]);
+		}
+
+		memset(outBlock, 0, 8);
+		outBlock[0] = maximum;
+		outBlock[1] = minimum;
+		if (maximum == minimum)
+			return;
+
+		uint8_t palette[8];
+		bc4_palette(maximum, minimum, palette);
+		uint64_t indices = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t bestIndex = 0;
+			int bestError = 256;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				const int error = std::abs(int(texels[i * 4 + 3]) - int(palette[p]));
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+			indices |= uint64_t(bestIndex) << (i * 3);
+		}
+		for (uint32_t b = 0; b < 6; b++)
+			outBlock[2 + b] = uint8_t(indices >> (b * 8));
+	}
+
+	void decode_color_block(const uint8_t* block, bool fourColors, uint8_t* outTexels)
+	{
+		uint16_t c0, c1;
+		uint32_t indices;
+		memcpy(&c0, block + 0, 2);
+		memcpy(&c1, block + 2, 2);
+		memcpy(&indices, block + 4, 4);
+
+		uint8_t palette[4][4];
+		bc1_palette(c0, c1, fourColors || c0 > c1, palette);
+		for (uint32_t i = 0; i < 16; i++)
+			memcpy(outTexels + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+	}
+
+	void decode_alpha_block(const uint8_t* block, uint8_t* outTexels)
+	{
+		uint8_t palette[8];
+		bc4_palette(block[0], block[1], palette);
+		uint64_t indices = 0;
+		for (uint32_t b = 0; b < 6; b++)
+			indices |= uint64_t(block[2 + b]) << (b * 8);
+		for (uint32_t i = 0; i < 16; i++)
+			outTexels[i * 4 + 3] = palette[(indices >> (i * 3)) & 7];
+	}
+
+	struct BitWriter
+	{
+		uint8_t* data;
+		uint32_t position;
+
+		void write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, position++)
+			{
+				if ((value >> i) & 1)
+					data[position >> 3] |= uint8_t(1 << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* data;
+		uint32_t position;
+
+		uint32_t read(uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++)
+				value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	//endpoint pair and indices for a range of channels, endpoints as the 8 bit values the hardware expands them to
+	struct Bc7Fit
+	{
+		uint8_t endpoints[2][4];
+		uint8_t indices[16];
+		uint32_t error;
+	};
+
+	//7 bit endpoint plus the pbit that together land closest to the target, mode 6 color and alpha
+	void quantize_pbit(const glm::vec4& color, uint32_t begin, uint32_t end, uint8_t* outEndpoint)
+	{
+		float bestError = 1e30f;
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			uint8_t endpoint[4] = {};
+			float error = 0.f;
+			for (uint32_t c = begin; c < end; c++)
+			{
+				const int q = std::clamp(int((color[c] - p) * 0.5f + 0.5f), 0, 127);
+				endpoint[c] = uint8_t((q << 1) | p);
+				const float d = float(endpoint[c]) - color[c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(outEndpoint, endpoint, 4);
+			}
+		}
+	}
+
+	//7 bit endpoint with the top bit replicated, mode 5 color
+	void quantize_7bit(const glm::vec4& color, uint32_t begin, uint32_t end, uint8_t* outEndpoint)
+	{
+		for (uint32_t c = begin; c < end; c++)
+		{
+			const uint32_t q = std::min(127u, uint32_t(color[c] * (127.f / 255.f) + 0.5f));
+			outEndpoint[c] = uint8_t((q << 1) | (q >> 6));
+		}
+	}
+
+	//full 8 bit endpoint, mode 5 alpha
+	void quantize_8bit(const glm::vec4& color, uint32_t begin, uint32_t end, uint8_t* outEndpoint)
+	{
+		for (uint32_t c = begin; c < end; c++)
+			outEndpoint[c] = uint8_t(color[c] + 0.5f);
+	}
+
+	uint8_t bc7_interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+	{
+		return uint8_t(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+	}
+
+	//fits the channels [begin, end) of the block with one endpoint pair and weightCount interpolation steps,
+	//the first index ends up below weightCount / 2 as the anchor texel stores one bit less
+	Bc7Fit fit_bc7(const uint8_t* texels, uint32_t begin, uint32_t end, const uint32_t* weights, uint32_t weightCount,
+		void (*quantize)(const glm::vec4&, uint32_t, uint32_t, uint8_t*))
+	{
+		glm::vec4 points[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			points[i] = glm::vec4{ 0.f };
+			for (uint32_t c = begin; c < end; c++)
+				points[i][c] = texels[i * 4 + c];
+		}
+
+		glm::vec4 first, second;
+		fit_endpoints(points, first, second);
+
+		Bc7Fit best = {};
+		best.error = UINT32_MAX;
+		for (uint32_t pass = 0; pass <= ENDPOINT_REFINE_PASSES; pass++)
+		{
+			Bc7Fit fit = {};
+			quantize(first, begin, end, fit.endpoints[0]);
+			quantize(second, begin, end, fit.endpoints[1]);
+
+			uint8_t palette[16][4] = {};
+			for (uint32_t w = 0; w < weightCount; w++)
+			{
+				for (uint32_t c = begin; c < end; c++)
+					palette[w][c] = bc7_interpolate(fit.endpoints[0][c], fit.endpoints[1][c], weights[w]);
+			}
+
+			float blend[16];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t bestIndex = 0;
+				uint32_t bestTexelError = UINT32_MAX;
+				for (uint32_t w = 0; w < weightCount; w++)
+				{
+					const uint32_t texelError = squared_error(texels + i * 4 + begin, palette[w] + begin, end - begin);
+					if (texelError < bestTexelError)
+					{
+						bestTexelError = texelError;
+						bestIndex = w;
+					}
+				}
+				fit.indices[i] = uint8_t(bestIndex);
+				fit.error += bestTexelError;
+				blend[i] = weights[bestIndex] / 64.f;
+			}
+
+			if (fit.error < best.error)
+				best = fit;
+			if (fit.error == 0 || !refit_endpoints(points, blend, first, second))
+				break;
+		}
+
+		//the weight tables are symmetric, so swapping the endpoints mirrors the indices
+		if (best.indices[0] >= weightCount / 2)
+		{
+			std::swap(best.endpoints[0], best.endpoints[1]);
+			for (uint8_t& index : best.indices)
+				index = uint8_t(weightCount - 1 - index);
+		}
+		return best;
+	}
+
+	void write_bc7_indices(BitWriter& writer, const uint8_t* indices, uint32_t bits)
+	{
+		writer.write(indices[0], bits - 1);
+		for (uint32_t i = 1; i < 16; i++)
+			writer.write(indices[i], bits);
+	}
+}
+
+namespace vkn
+{
+	TextureFormat select_texture_format(const ImageData& image, TextureQuality quality)
+	{
+		if (quality == TextureQuality::High)
+			return TextureFormat::Bc7;
+
+		const size_t texels = size_t(image.width) * image.height;
+		for (size_t i = 0; i < texels; i++)
+		{
+			if (image.pixels[i * 4 + 3] != 255)
+				return TextureFormat::Bc3;
+		}
+		return TextureFormat::Bc1;
+	}
+
+	void encode_bc1_block(const uint8_t* texels, uint8_t* outBlock)
+	{
+		encode_color_block(texels, outBlock);
+	}
+
+	void encode_bc3_block(const uint8_t* texels, uint8_t* outBlock)
+	{
+		encode_alpha_block(texels, outBlock);
+		encode_color_block(texels, outBlock + 8);
+	}
+
+	void encode_bc7_block(const uint8_t* texels, uint8_t* outBlock)
+	{
+		//mode 6 fits rgba along one line with 16 steps, mode 5 fits color and alpha separately with 4 steps each,
+		//which wins on blocks where alpha does not follow color, like cutout edges
+		const Bc7Fit mode6 = fit_bc7(texels, 0, 4, BC7_WEIGHTS4, 16, quantize_pbit);
+		const Bc7Fit mode5Color = fit_bc7(texels, 0, 3, BC7_WEIGHTS2, 4, quantize_7bit);
+		const Bc7Fit mode5Alpha = fit_bc7(texels, 3, 4, BC7_WEIGHTS2, 4, quantize_8bit);
+
+		memset(outBlock, 0, 16);
+		BitWriter writer{ outBlock, 0 };
+		if (mode6.error <= mode5Color.error + mode5Alpha.error)
+		{
+			writer.write(1 << 6, 7);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				writer.write(mode6.endpoints[0][c] >> 1, 7);
+				writer.write(mode6.endpoints[1][c] >> 1, 7);
+			}
+			writer.write(mode6.endpoints[0][0] & 1, 1);
+			writer.write(mode6.endpoints[1][0] & 1, 1);
+			write_bc7_indices(writer, mode6.indices, 4);
+		}
+		else
+		{
+			//no channel rotation
+			writer.write(1 << 5, 6);
+			writer.write(0, 2);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				writer.write(mode5Color.endpoints[0][c] >> 1, 7);
+				writer.write(mode5Color.endpoints[1][c] >> 1, 7);
+			}
+			writer.write(mode5Alpha.endpoints[0][3], 8);
+			writer.write(mode5Alpha.endpoints[1][3], 8);
+			write_bc7_indices(writer, mode5Color.indices, 2);
+			write_bc7_indices(writer, mode5Alpha.indices, 2);
+		}
+	}
+
+	void decode_block(TextureFormat format, const uint8_t* block, uint8_t* outTexels)
+	{
+		switch (format)
+		{
+		case TextureFormat::Bc1:
+			decode_color_block(block, false, outTexels);
+			break;
+		case TextureFormat::Bc3:
+			decode_color_block(block + 8, true, outTexels);
+			decode_alpha_block(block, outTexels);
+			break;
+		case TextureFormat::Bc7:
+		{
+			uint8_t endpoints[2][4];
+			uint8_t colorIndices[16];
+			uint8_t alphaIndices[16];
+			const uint32_t* weights;
+			if ((block[0] & 0x7F) == 0x40)
+			{
+				BitReader reader{ block, 7 };
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					endpoints[0][c] = uint8_t(reader.read(7) << 1);
+					endpoints[1][c] = uint8_t(reader.read(7) << 1);
+				}
+				const uint32_t p0 = reader.read(1);
+				const uint32_t p1 = reader.read(1);
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					endpoints[0][c] |= p0;
+					endpoints[1][c] |= p1;
+				}
+				for (uint32_t i = 0; i < 16; i++)
+					colorIndices[i] = alphaIndices[i] = uint8_t(reader.read(i == 0 ? 3 : 4));
+				weights = BC7_WEIGHTS4;
+			}
+			else if ((block[0] & 0x3F) == 0x20 && (block[0] & 0xC0) == 0)
+			{
+				BitReader reader{ block, 8 };
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					for (uint32_t e = 0; e < 2; e++)
+					{
+						const uint32_t q = reader.read(7);
+						endpoints[e][c] = uint8_t((q << 1) | (q >> 6));
+					}
+				}
+				endpoints[0][3] = uint8_t(reader.read(8));
+				endpoints[1][3] = uint8_t(reader.read(8));
+				for (uint32_t i = 0; i < 16; i++)
+					colorIndices[i] = uint8_t(reader.read(i == 0 ? 1 : 2));
+				for (uint32_t i = 0; i < 16; i++)
+					alphaIndices[i] = uint8_t(reader.read(i == 0 ? 1 : 2));
+				weights = BC7_WEIGHTS2;
+			}
+			else
+			{
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					const uint8_t magenta[4] = { 255, 0, 255, 255 };
+					memcpy(outTexels + i * 4, magenta, 4);
+				}
+				break;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					const uint32_t weight = weights[c == 3 ? alphaIndices[i] : colorIndices[i]];
+					outTexels[i * 4 + c] = bc7_interpolate(endpoints[0][c], endpoints[1][c], weight);
+				}
+			}
+			break;
+		}
+		case TextureFormat::Rgba8:
+			memcpy(outTexels, block, 64);
+			break;
+		}
+	}
+
+	void compress_image(const ImageData& image, TextureFormat format, ImageData& outImage)
+	{
+		outImage.width = image.width;
+		outImage.height = image.height;
+		outImage.mipLevels = image.mipLevels;
+		outImage.format = format;
+		if (format == TextureFormat::Rgba8 || image.format != TextureFormat::Rgba8)
+		{
+			outImage.format = image.format;
+			outImage.pixels = image.pixels;
+			return;
+		}
+		outImage.pixels.assign(mip_level_offset(outImage, outImage.mipLevels), 0);
+
+		void (*encode)(const uint8_t*, uint8_t*) = format == TextureFormat::Bc1 ? encode_bc1_block
+			: format == TextureFormat::Bc3 ? encode_bc3_block : encode_bc7_block;
+		const uint32_t blockSize = block_bytes(format);
+
+		//block rows of every level in one list, the small levels would not keep the workers busy on their own
+		std::vector<std::pair<uint32_t, uint32_t>> rows;
+		for (uint32_t level = 0; level < image.mipLevels; level++)
+		{
+			for (uint32_t row = 0; row < (mip_level_height(image, level) + 3) / 4; row++)
+				rows.emplace_back(level, row);
+		}
+
+		parallel_for(rows.size(), [&](size_t r)
+		{
+			const uint32_t level = rows[r].first;
+			const uint32_t row = rows[r].second;
+			const uint32_t width = mip_level_width(image, level);
+			const uint32_t height = mip_level_height(image, level);
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint8_t* src = image.pixels.data() + mip_level_offset(image, level);
+			uint8_t* dst = outImage.pixels.data() + mip_level_offset(outImage, level) + size_t(row) * blocksX * blockSize;
+
+			//texels past the edge of the level repeat the last row and column
+			uint8_t texels[64];
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					const uint32_t sy = std::min(row * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						const uint32_t sx = std::min(bx * 4 + x, width - 1);
+						memcpy(texels + (y * 4 + x) * 4, src + (size_t(sy) * width + sx) * 4, 4);
+					}
+				}
+				encode(texels, dst + size_t(bx) * blockSize);
+			}
+		});
+	}
+
+	void decompress_image(const ImageData& image, ImageData& outImage)
+	{
+		outImage.width = image.width;
+		outImage.height = image.height;
+		outImage.mipLevels = image.mipLevels;
+		outImage.format = TextureFormat::Rgba8;
+		if (image.format == TextureFormat::Rgba8)
+		{
+			outImage.pixels = image.pixels;
+			return;
+		}
+		outImage.pixels.assign(mip_level_offset(outImage, outImage.mipLevels), 0);
+
+		const uint32_t blockSize = block_bytes(image.format);
+		parallel_for(image.mipLevels, [&](size_t l)
+		{
+			const uint32_t level = uint32_t(l);
+			const uint32_t width = mip_level_width(image, level);
+			const uint32_t height = mip_level_height(image, level);
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint8_t* src = image.pixels.data() + mip_level_offset(image, level);
+			uint8_t* dst = outImage.pixels.data() + mip_level_offset(outImage, level);
+
+			uint8_t texels[64];
+			for (uint32_t by = 0; by < (height + 3) / 4; by++)
+			{
+				for (uint32_t bx = 0; bx < blocksX; bx++)
+				{
+					decode_block(image.format, src + (size_t(by) * blocksX + bx) * blockSize, texels);
+					for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+					{
+						for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+							memcpy(dst + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "vk_image.h"
+
+#include <cstdint>
+
+namespace vkn
+{
+	//what the cooker trades encode time and texture quality for
+	enum class TextureQuality : uint32_t
+	{
+		Fast, //bc1, or bc3 when the image has alpha
+		High, //bc7
+	};
+
+	//bc1 or bc3 depending on whether any texel of level 0 is translucent, bc7 at high quality
+	TextureFormat select_texture_format(const ImageData& image, TextureQuality quality);
+
+	//block encoders, texels are the 16 rgba8 texels of a 4x4 block in row order
+	//colors are fitted in srgb space, which is where the hardware interpolates them for the srgb formats
+	void encode_bc1_block(const uint8_t* texels, uint8_t* outBlock);
+	void encode_bc3_block(const uint8_t* texels, uint8_t* outBlock);
+	//single subset modes only, 5 or 6 whichever fits the block better, blocks with several distinct colors would
+	//need the partitioned modes
+	void encode_bc7_block(const uint8_t* texels, uint8_t* outBlock);
+	//decodes any block the encoders produce, bc7 blocks in modes other than 5 and 6 or with a channel rotation are
+	//returned as opaque magenta
+	void decode_block(TextureFormat format, const uint8_t* block, uint8_t* outTexels);
+
+	//encodes every mip level of an rgba8 image, the block rows of all levels are spread over the worker threads
+	void compress_image(const ImageData& image, TextureFormat format, ImageData& outImage);
+	//back to rgba8, for the tools
+	void decompress_image(const ImageData& image, ImageData& outImage);
+}
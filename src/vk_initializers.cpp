@@ -148,7 +148,7 @@ namespace vkn
 		return result;
 	}
 
-	VkImageCreateInfo image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent)
+	VkImageCreateInfo image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent, uint32_t mipLevels /*= 1*/)
 	{
 		VkImageCreateInfo info = { };
 		info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -156,7 +156,7 @@ namespace vkn
 		info.imageType = VK_IMAGE_TYPE_2D;
 		info.format = format;
 		info.extent = extent;
-		info.mipLevels = 1;
+		info.mipLevels = mipLevels;
 		info.arrayLayers = 1;
 		info.samples = VK_SAMPLE_COUNT_1_BIT;
 		info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -173,7 +173,7 @@ namespace vkn
 		info.image = image;
 		info.format = format;
 		info.subresourceRange.baseMipLevel = 0;
-		info.subresourceRange.levelCount = 1;
+		info.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
 		info.subresourceRange.baseArrayLayer = 0;
 		info.subresourceRange.layerCount = 1;
 		info.subresourceRange.aspectMask = aspectFlags;
@@ -293,6 +293,9 @@ namespace vkn
 		info.addressModeU = samplerAdressMode;
 		info.addressModeV = samplerAdressMode;
 		info.addressModeW = samplerAdressMode;
+		//every mip the image has, blended the same way texels are
+		info.mipmapMode = filters == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		info.maxLod = VK_LOD_CLAMP_NONE;
 		return info;
 	}
 
@@ -0,0 +1,243 @@
+#include "vk_jobs.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	//spins this many times through the deques before an idle worker goes to sleep, short gaps between two
+	//batches of jobs then never pay for a wake up
+	constexpr uint32_t IDLE_SPINS = 64;
+
+	//which deque the calling thread pushes to and pops from, only meaningful for the system it was set by
+	thread_local const vkn::JobSystem* tlsSystem = nullptr;
+	thread_local uint32_t tlsQueue = 0;
+
+	vkn::JobSystem& job_system_instance()
+	{
+		static vkn::JobSystem system;
+		return system;
+	}
+	std::once_flag jobSystemStarted;
+
+	void pin_to_core(uint32_t core)
+	{
+#if defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core % CPU_SETSIZE, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)core;
+#endif
+	}
+}
+
+namespace vkn
+{
+	void JobSystem::init(uint32_t threadCount, bool pinThreads)
+	{
+		cleanup();
+
+		_queues.clear();
+		for (uint32_t i = 0; i <= threadCount; i++)
+			_queues.push_back(std::make_unique<Queue>());
+		_queued = 0;
+		_running = true;
+		for (uint32_t i = 0; i < threadCount; i++)
+			_threads.emplace_back(&JobSystem::worker_main, this, i + 1, pinThreads);
+	}
+
+	void JobSystem::cleanup()
+	{
+		if (!_running)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_running = false;
+		}
+		_wake.notify_all();
+		for (std::thread& thread : _threads)
+			thread.join();
+		_threads.clear();
+	}
+
+	void JobSystem::submit(const Job& job)
+	{
+		if (job.counter)
+			job.counter->_pending.fetch_add(1, std::memory_order_relaxed);
+		push(job);
+	}
+
+	void JobSystem::submit_after(JobCounter& dependency, const Job& job)
+	{
+		if (job.counter)
+			job.counter->_pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(dependency._mutex);
+			if (!dependency.done())
+			{
+				dependency._continuations.push_back(job);
+				return;
+			}
+		}
+		push(job);
+	}
+
+	void JobSystem::wait(JobCounter& counter)
+	{
+		Job job;
+		while (!counter.done())
+		{
+			if (find_job(job))
+				run(job);
+			else
+				std::this_thread::yield();
+		}
+		//the last job drops the counter to zero under its lock, taking the lock makes sure that job let go of it
+		std::lock_guard<std::mutex> lock(counter._mutex);
+	}
+
+	void JobSystem::push(const Job& job)
+	{
+		//not started, jobs run right where they are submitted
+		if (!_running)
+		{
+			run(job);
+			return;
+		}
+
+		Queue& queue = *_queues[queue_index()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(job);
+		}
+		_queued.fetch_add(1);
+
+		//a sleeper checks _queued under the sleep lock after counting itself, so taking the lock here means it
+		//either sees the job or is already waiting for the notify
+		if (_sleeping.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+			}
+			_wake.notify_one();
+		}
+	}
+
+	bool JobSystem::find_job(Job& outJob)
+	{
+		if (_queued.load(std::memory_order_relaxed) == 0)
+			return false;
+
+		//own deque from the back, the newest job is the one whose data is still in cache, the others from the front,
+		//the oldest jobs tend to be the biggest pieces of work left
+		const uint32_t own = queue_index();
+		const uint32_t queueCount = static_cast<uint32_t>(_queues.size());
+		for (uint32_t i = 0; i < queueCount; i++)
+		{
+			Queue& queue = *_queues[(own + i) % queueCount];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.jobs.empty())
+				continue;
+
+			if (i == 0)
+			{
+				outJob = queue.jobs.back();
+				queue.jobs.pop_back();
+			}
+			else
+			{
+				outJob = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+			_queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	void JobSystem::run(const Job& job)
+	{
+		job.function(job.data, job.index);
+
+		JobCounter* counter = job.counter;
+		if (!counter)
+			return;
+
+		std::vector<Job> released;
+		{
+			std::lock_guard<std::mutex> lock(counter->_mutex);
+			if (counter->_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			released.swap(counter->_continuations);
+		}
+		//the counter may be gone already, the continuations were taken out of it
+		for (const Job& next : released)
+			push(next);
+	}
+
+	void JobSystem::worker_main(uint32_t queue, bool pin)
+	{
+		tlsSystem = this;
+		tlsQueue = queue;
+		//the thread that started the system usually runs on core 0, workers take the cores after it
+		if (pin)
+			pin_to_core(queue);
+
+		Job job;
+		uint32_t idle = 0;
+		while (_running.load(std::memory_order_acquire))
+		{
+			if (find_job(job))
+			{
+				run(job);
+				idle = 0;
+				continue;
+			}
+			if (++idle < IDLE_SPINS)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			_sleeping.fetch_add(1);
+			{
+				std::unique_lock<std::mutex> lock(_sleepMutex);
+				_wake.wait(lock, [this]() { return _queued.load() > 0 || !_running.load(); });
+			}
+			_sleeping.fetch_sub(1);
+			idle = 0;
+		}
+	}
+
+	uint32_t JobSystem::queue_index() const
+	{
+		return tlsSystem == this ? tlsQueue : 0;
+	}
+
+	void start_job_system(uint32_t threadCount, bool pinThreads)
+	{
+		std::call_once(jobSystemStarted, [=]()
+		{
+			job_system_instance().init(threadCount, pinThreads);
+		});
+	}
+
+	JobSystem& job_system()
+	{
+		start_job_system(std::max(1u, std::thread::hardware_concurrency()) - 1, false);
+		return job_system_instance();
+	}
+}
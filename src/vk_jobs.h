@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkn
+{
+	class JobCounter;
+
+	struct Job
+	{
+		void (*function)(void* data, size_t index);
+		void* data;
+		size_t index;
+		//decremented once the job ran, may be null
+		JobCounter* counter;
+	};
+
+	//jobs of a group that have not finished yet, a counter has to outlive every wait on it
+	class JobCounter
+	{
+	public:
+		bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> _pending{ 0 };
+		//guards the continuations and the drop to zero, so wait cannot return while the last job still holds the counter
+		std::mutex _mutex;
+		std::vector<Job> _continuations;
+	};
+
+	//work stealing scheduler, every worker pops the newest job of its own deque and steals the oldest of the others
+	//when it runs dry, threads that are not workers share one more deque and run jobs too while they wait
+	class JobSystem
+	{
+	public:
+		~JobSystem() { cleanup(); }
+
+		//threadCount background workers, each pinned to a core of its own when asked, 0 runs everything in wait
+		void init(uint32_t threadCount, bool pinThreads = false);
+		void cleanup();
+
+		//counts the job on its counter and queues it on the calling thread's deque
+		void submit(const Job& job);
+		//counts the job on its counter right away but only queues it once dependency reached zero
+		void submit_after(JobCounter& dependency, const Job& job);
+		//runs queued jobs until the counter is zero
+		void wait(JobCounter& counter);
+
+		uint32_t thread_count() const { return static_cast<uint32_t>(_threads.size()); }
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void push(const Job& job);
+		bool find_job(Job& outJob);
+		void run(const Job& job);
+		void worker_main(uint32_t queue, bool pin);
+		uint32_t queue_index() const;
+
+		//0 is shared by every thread that is not a worker, worker i owns i + 1
+		std::vector<std::unique_ptr<Queue>> _queues;
+		std::vector<std::thread> _threads;
+		std::atomic<bool> _running{ false };
+		std::atomic<uint32_t> _queued{ 0 };
+		std::atomic<uint32_t> _sleeping{ 0 };
+		std::mutex _sleepMutex;
+		std::condition_variable _wake;
+	};
+
+	//starts the engine's scheduler, only the first call does and only before anything used job_system
+	void start_job_system(uint32_t threadCount, bool pinThreads);
+	//the engine's scheduler, started with a worker per core besides the calling thread on first use when
+	//start_job_system never ran
+	JobSystem& job_system();
+}
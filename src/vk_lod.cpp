@@ -0,0 +1,333 @@
+#include "vk_lod.h"
+#include "vk_mesh_optimizer.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//plane distance quadric, sum of area * (n.p + d)^2 over the planes it collected
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void add_plane(const glm::vec3& normal, float d, float area)
+		{
+			const double x = normal.x, y = normal.y, z = normal.z;
+			a00 += area * x * x; a01 += area * x * y; a02 += area * x * z;
+			a11 += area * y * y; a12 += area * y * z; a22 += area * z * z;
+			b0 += area * x * d; b1 += area * y * d; b2 += area * z * d;
+			c += area * double(d) * d;
+			weight += area;
+		}
+
+		void add(const Quadric& other)
+		{
+			a00 += other.a00; a01 += other.a01; a02 += other.a02;
+			a11 += other.a11; a12 += other.a12; a22 += other.a22;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		//mean squared distance of p to the planes
+		float error(const glm::vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			const double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? float(std::max(e, 0.0) / weight) : 0.f;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float cost;
+	};
+
+	//same position, different attributes, these seams share a canonical vertex
+	std::vector<uint32_t> canonical_vertices(const std::vector<Vertex>& vertices)
+	{
+		std::vector<uint32_t> order(vertices.size());
+		for (uint32_t v = 0; v < order.size(); v++)
+			order[v] = v;
+
+		auto less = [&](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = vertices[a].position;
+			const glm::vec3& pb = vertices[b].position;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		std::vector<uint32_t> canonical(vertices.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const bool same = i > 0 && vertices[order[i]].position == vertices[order[i - 1]].position;
+			canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+		}
+		return canonical;
+	}
+
+}
+
+namespace vkn
+{
+	std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float targetError, float* outError)
+	{
+		std::vector<uint32_t> result = indices;
+		float resultError = 0.f;
+		if (outError)
+			*outError = 0.f;
+		if (result.size() <= targetIndexCount || vertices.empty())
+			return result;
+
+		const size_t vertexCount = vertices.size();
+
+		//errors are relative to the largest dimension so the limits mean the same for every mesh
+		glm::vec3 min = vertices[indices[0]].position;
+		glm::vec3 max = min;
+		for (uint32_t index : indices)
+		{
+			min = glm::min(min, vertices[index].position);
+			max = glm::max(max, vertices[index].position);
+		}
+		const glm::vec3 extent = max - min;
+		const float scale = std::max({ extent.x, extent.y, extent.z, 1e-20f });
+		std::vector<glm::vec3> positions(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			positions[v] = (vertices[v].position - min) / scale;
+
+		const std::vector<uint32_t> canonical = canonical_vertices(vertices);
+		std::vector<uint32_t> groupSize(vertexCount, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			groupSize[canonical[v]]++;
+
+		//an edge without its reverse is on a border, one seen twice in the same direction is non manifold
+		std::vector<uint32_t> canonicalIndices(result.size());
+		for (size_t i = 0; i < result.size(); i++)
+			canonicalIndices[i] = canonical[result[i]];
+		const TriangleAdjacency canonicalAdjacency(canonicalIndices, vertexCount);
+
+		auto directed_edges = [&](uint32_t a, uint32_t b)
+		{
+			uint32_t count = 0;
+			for (uint32_t t = canonicalAdjacency.offsets[a]; t < canonicalAdjacency.offsets[a + 1]; t++)
+			{
+				const uint32_t* triangle = &canonicalIndices[canonicalAdjacency.triangles[t] * 3];
+				for (uint32_t k = 0; k < 3; k++)
+					count += triangle[k] == a && triangle[(k + 1) % 3] == b;
+			}
+			return count;
+		};
+
+		std::vector<bool> locked(vertexCount, false);
+		for (size_t i = 0; i < canonicalIndices.size(); i += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const uint32_t a = canonicalIndices[i + k];
+				const uint32_t b = canonicalIndices[i + (k + 1) % 3];
+				if (directed_edges(b, a) != 1 || directed_edges(a, b) != 1)
+					locked[a] = locked[b] = true;
+			}
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (groupSize[canonical[v]] > 1 || locked[canonical[v]])
+				locked[v] = true;
+		}
+
+		std::vector<Quadric> quadrics(vertexCount, Quadric{});
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const glm::vec3& p0 = positions[result[i + 0]];
+			const glm::vec3& p1 = positions[result[i + 1]];
+			const glm::vec3& p2 = positions[result[i + 2]];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			if (length == 0.f)
+				continue;
+			normal /= length;
+			for (uint32_t k = 0; k < 3; k++)
+				quadrics[result[i + k]].add_plane(normal, -glm::dot(normal, p0), length * 0.5f);
+		}
+
+		auto collapse_cost = [&](uint32_t from, uint32_t to)
+		{
+			const Vertex& a = vertices[from];
+			const Vertex& b = vertices[to];
+			const float normalError = SIMPLIFY_NORMAL_WEIGHT * glm::length(a.normal - b.normal);
+			const float uvError = SIMPLIFY_UV_WEIGHT * glm::length(a.uv - b.uv);
+			return quadrics[from].error(positions[to]) + normalError * normalError + uvError * uvError;
+		};
+
+		//moving from onto to must not turn any of the triangles that survive the collapse around
+		auto flips = [&](const TriangleAdjacency& adjacency, uint32_t from, uint32_t to)
+		{
+			for (uint32_t a = adjacency.offsets[from]; a < adjacency.offsets[from + 1]; a++)
+			{
+				const uint32_t* triangle = &result[adjacency.triangles[a] * 3];
+				const uint32_t k = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+				const uint32_t v1 = triangle[(k + 1) % 3];
+				const uint32_t v2 = triangle[(k + 2) % 3];
+				if (canonical[v1] == canonical[to] || canonical[v2] == canonical[to])
+					continue;
+
+				const glm::vec3 before = glm::cross(positions[v1] - positions[from], positions[v2] - positions[from]);
+				const glm::vec3 after = glm::cross(positions[v1] - positions[to], positions[v2] - positions[to]);
+				if (glm::dot(before, after) <= 0.f)
+					return true;
+			}
+			return false;
+		};
+
+		const float targetCost = targetError * targetError;
+		std::vector<Collapse> collapses;
+		collapses.reserve(result.size());
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint32_t> touched(vertexCount, 0);
+		uint32_t pass = 0;
+
+		while (result.size() > targetIndexCount)
+		{
+			pass++;
+			const TriangleAdjacency adjacency(result, vertexCount);
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t from = result[i + k];
+					const uint32_t to = result[i + (k + 1) % 3];
+					//the reverse direction comes from the triangle on the other side of the edge
+					if (!locked[from] && canonical[from] != canonical[to])
+						collapses.push_back({ from, to, collapse_cost(from, to) });
+				}
+			}
+			if (collapses.empty())
+				break;
+
+			//a collapse removes two triangles on a closed surface, the pass goes no further than that count suggests and
+			//leaves collapses much costlier than the ones it needed for later passes once the cheap ones opened up
+			const size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+			const size_t collapseGoal = std::max<size_t>(1, trianglesToRemove / 2);
+			auto cheaper = [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; };
+			const auto goal = collapses.begin() + std::min(collapseGoal, collapses.size()) - 1;
+			std::nth_element(collapses.begin(), goal, collapses.end(), cheaper);
+			const float passLimit = goal->cost * 1.5f;
+
+			//only the candidates under the limit can be taken, the rest does not need ordering
+			const auto end = std::partition(collapses.begin(), collapses.end(), [&](const Collapse& c) { return c.cost <= passLimit; });
+			collapses.erase(end, collapses.end());
+			std::sort(collapses.begin(), collapses.end(), cheaper);
+
+			for (size_t v = 0; v < vertexCount; v++)
+				remap[v] = static_cast<uint32_t>(v);
+
+			size_t collapsed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.cost > targetCost || collapse.cost > passLimit || collapsed >= collapseGoal)
+					break;
+				if (touched[collapse.from] == pass || touched[collapse.to] == pass)
+					continue;
+				if (flips(adjacency, collapse.from, collapse.to))
+					continue;
+
+				//the whole fan of the collapsed vertex changes, nothing else in it may move in this pass
+				for (uint32_t a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1]; a++)
+				{
+					const uint32_t* triangle = &result[adjacency.triangles[a] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = pass;
+				}
+				touched[collapse.to] = pass;
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				resultError = std::max(resultError, collapse.cost);
+				collapsed++;
+			}
+			if (collapsed == 0)
+				break;
+
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				const uint32_t a = remap[result[i + 0]];
+				const uint32_t b = remap[result[i + 1]];
+				const uint32_t c = remap[result[i + 2]];
+				if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+					continue;
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		if (outError)
+			*outError = std::sqrt(resultError);
+		return result;
+	}
+
+	void generate_lods(Mesh& mesh, uint32_t maxLods)
+	{
+		mesh._lods.clear();
+		if (mesh._indices.empty())
+			return;
+
+		glm::vec3 extent = mesh._bounds.max - mesh._bounds.min;
+		const float scale = std::max({ extent.x, extent.y, extent.z });
+
+		mesh._lods.push_back({ 0, static_cast<uint32_t>(mesh._indices.size()), 0.f });
+		std::vector<uint32_t> previous = mesh._indices;
+		float error = 0.f;
+		while (mesh._lods.size() < maxLods)
+		{
+			const size_t target = previous.size() / 6 * 3;
+			float lodError = 0.f;
+			std::vector<uint32_t> lod = simplify(previous, mesh._vertices, target, 1.f, &lodError);
+
+			//nothing left to remove without breaking a locked border or seam
+			if (lod.empty() || lod.size() > previous.size() * 85 / 100)
+				break;
+
+			//each level starts from the previous one, so its deviation from the full mesh is at most the sum
+			error += lodError;
+			optimize_vertex_cache(lod, mesh._vertices.size());
+			mesh._lods.push_back({ static_cast<uint32_t>(mesh._indices.size()), static_cast<uint32_t>(lod.size()), error * scale });
+			mesh._indices.insert(mesh._indices.end(), lod.begin(), lod.end());
+			previous = std::move(lod);
+		}
+	}
+
+	uint32_t select_lod(const Mesh& mesh, const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale, float pixelThreshold)
+	{
+		if (mesh._lods.size() <= 1)
+			return 0;
+
+		//errors and bounds scale with the largest axis of the model matrix
+		const float modelScale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+		const glm::vec3 center = model * glm::vec4(mesh._bounds.origin, 1.f);
+		const float distance = glm::length(center - cameraPosition) - mesh._bounds.radius * modelScale;
+		if (distance <= 0.f)
+			return 0;
+
+		const float pixelsPerUnit = projectionScale * modelScale / distance;
+		uint32_t lod = 0;
+		while (lod + 1 < mesh._lods.size() && mesh._lods[lod + 1].error * pixelsPerUnit <= pixelThreshold)
+			lod++;
+		return lod;
+	}
+}
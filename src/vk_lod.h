@@ -0,0 +1,29 @@
+#pragma once
+#include "vk_mesh.h"
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+namespace vkn
+{
+	constexpr uint32_t MAX_MESH_LODS = 8;
+
+	//weights of the attribute differences against the position error, which is measured relative to the mesh extent
+	constexpr float SIMPLIFY_NORMAL_WEIGHT = 0.05f;
+	constexpr float SIMPLIFY_UV_WEIGHT = 0.5f;
+
+	//quadric error edge collapse (Garland and Heckbert 1997) onto existing vertices, so the result indexes the same vertex
+	//buffer, border and seam vertices are locked so open edges and uv/normal splits do not crack
+	//stops at targetIndexCount or once the next collapse would exceed targetError, relative to the mesh extent
+	//outError receives the largest error accepted, also relative to the extent
+	std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float targetError, float* outError);
+
+	//appends a chain of lods to mesh._indices, each about half the triangles of the previous one, and fills mesh._lods
+	//runs after optimize_mesh and build_meshlets, which both rewrite the whole index buffer
+	void generate_lods(Mesh& mesh, uint32_t maxLods = MAX_MESH_LODS);
+
+	//coarsest lod whose error projected at the closest point of the bounds stays under pixelThreshold
+	//projectionScale converts a size at distance 1 into pixels, viewport height / (2 tan(fovy / 2))
+	uint32_t select_lod(const Mesh& mesh, const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale, float pixelThreshold);
+}
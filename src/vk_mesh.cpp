@@ -1,8 +1,93 @@
 #include "vk_mesh.h"
+#include "vk_obj_parser.h"
+#include "vk_parallel.h"
 
 #include <tiny_obj_loader.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
+namespace
+{
+	//below this many corners sharding the weld costs more than it saves
+	constexpr size_t PARALLEL_WELD_MIN_CORNERS = 64 * 1024;
+
+	//welding only merges bitwise identical vertices, so hash the raw bytes
+	uint64_t hash_vertex(const Vertex& v)
+	{
+		uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+		memcpy(words, &v, sizeof(Vertex));
+
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t w : words)
+		{
+			hash ^= w;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint16_t quantize_unorm16(float value, float extent)
+	{
+		if (extent <= 0.f)
+			return 0;
+		return static_cast<uint16_t>(std::clamp(value / extent, 0.f, 1.f) * 65535.f + 0.5f);
+	}
+
+	int16_t quantize_snorm16(float value)
+	{
+		return static_cast<int16_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f));
+	}
+
+	uint8_t quantize_unorm8(float value)
+	{
+		return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	float sign_not_zero(float value)
+	{
+		return value >= 0.f ? 1.f : -1.f;
+	}
+
+	//octahedral normal encoding (Cigolle et al. 2014), a zero normal maps to the center and decodes to +z
+	glm::vec2 octahedral_encode(const glm::vec3& n)
+	{
+		const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (l1 == 0.f)
+			return glm::vec2{ 0.f };
+
+		glm::vec2 e{ n.x / l1, n.y / l1 };
+		if (n.z < 0.f)
+			e = glm::vec2{ (1.f - std::abs(e.y)) * sign_not_zero(e.x), (1.f - std::abs(e.x)) * sign_not_zero(e.y) };
+		return e;
+	}
+
+	glm::vec3 octahedral_decode(const glm::vec2& e)
+	{
+		glm::vec3 n{ e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y) };
+		const float t = std::max(-n.z, 0.f);
+		n.x += n.x >= 0.f ? -t : t;
+		n.y += n.y >= 0.f ? -t : t;
+		return glm::normalize(n);
+	}
+}
+
+uint32_t vertex_stride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed:
+		return sizeof(PackedVertex);
+	case VertexFormat::PackedColor:
+		return sizeof(PackedVertex) + 4;
+	default:
+		return sizeof(Vertex);
+	}
+}
+
 VertexInputDescription Vertex::get_vertex_description()
 {
 	VkVertexInputBindingDescription mainBinding = {};
@@ -43,6 +128,49 @@ VertexInputDescription Vertex::get_vertex_description()
 	return description;
 }
 
+VertexInputDescription PackedVertex::get_vertex_description(bool withColor)
+{
+	VkVertexInputBindingDescription mainBinding = {};
+	mainBinding.binding = 0;
+	mainBinding.stride = vertex_stride(withColor ? VertexFormat::PackedColor : VertexFormat::Packed);
+	mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription positionAttribute = {};
+	positionAttribute.binding = 0;
+	positionAttribute.location = 0;
+	positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+	positionAttribute.offset = offsetof(PackedVertex, position);
+
+	VkVertexInputAttributeDescription normalAttribute = {};
+	normalAttribute.binding = 0;
+	normalAttribute.location = 1;
+	normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+	normalAttribute.offset = offsetof(PackedVertex, normal);
+
+	VkVertexInputAttributeDescription uvAttribute = {};
+	uvAttribute.binding = 0;
+	uvAttribute.location = 3;
+	uvAttribute.format = VK_FORMAT_R16G16_UNORM;
+	uvAttribute.offset = offsetof(PackedVertex, uv);
+
+	VertexInputDescription description{};
+	description.bindings.push_back(mainBinding);
+	description.attributes.push_back(positionAttribute);
+	description.attributes.push_back(normalAttribute);
+	description.attributes.push_back(uvAttribute);
+
+	if (withColor)
+	{
+		VkVertexInputAttributeDescription colorAttribute = {};
+		colorAttribute.binding = 0;
+		colorAttribute.location = 2;
+		colorAttribute.format = VK_FORMAT_R8G8B8A8_UNORM;
+		colorAttribute.offset = sizeof(PackedVertex);
+		description.attributes.push_back(colorAttribute);
+	}
+	return description;
+}
+
 bool Mesh::load_from_obj(const char* filename)
 {
 	tinyobj::attrib_t attrib;
@@ -63,6 +191,9 @@ bool Mesh::load_from_obj(const char* filename)
 		return false;
 	}
 
+	_vertices.clear();
+	_indices.clear();
+
 	for (size_t s = 0; s < shapes.size(); s++)
 	{
 		size_t index_offset = 0;
@@ -76,21 +207,23 @@ bool Mesh::load_from_obj(const char* filename)
 				tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
 				tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
 				tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-				tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-				tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-				tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-				tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
-				tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
 
-				Vertex new_vert;
+				//zero initialized so that the unused color never prevents welding
+				Vertex new_vert{};
 				new_vert.position.x = vx;
 				new_vert.position.y = vy;
 				new_vert.position.z = vz;
-				new_vert.normal.x = nx;
-				new_vert.normal.y = ny;
-				new_vert.normal.z = nz;
-				new_vert.uv.x = ux;
-				new_vert.uv.y = 1 - uy;
+				if (idx.normal_index >= 0)
+				{
+					new_vert.normal.x = attrib.normals[3 * idx.normal_index + 0];
+					new_vert.normal.y = attrib.normals[3 * idx.normal_index + 1];
+					new_vert.normal.z = attrib.normals[3 * idx.normal_index + 2];
+				}
+				if (idx.texcoord_index >= 0)
+				{
+					new_vert.uv.x = attrib.texcoords[2 * idx.texcoord_index + 0];
+					new_vert.uv.y = 1 - attrib.texcoords[2 * idx.texcoord_index + 1];
+				}
 				//new_vert.color = new_vert.normal;
 				_vertices.push_back(new_vert);
 			}
@@ -98,5 +231,260 @@ bool Mesh::load_from_obj(const char* filename)
 		}
 	}
 
+	finish_obj_load(filename);
+	return true;
+}
+
+bool Mesh::load_from_obj_parallel(const char* filename)
+{
+	if (!vkn::parse_obj_parallel(filename, _vertices))
+		return load_from_obj(filename);
+
+	_indices.clear();
+	finish_obj_load(filename);
 	return true;
 }
+
+void Mesh::finish_obj_load(const char* filename)
+{
+	const size_t expandedCount = _vertices.size();
+	weld_vertices();
+	compute_bounds();
+	_indexType = select_index_type();
+
+	const size_t indexSize = _indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	std::cout << "Mesh " << filename << " welded " << expandedCount << " vertices into " << _vertices.size()
+		<< " (" << expandedCount * sizeof(Vertex) / 1024 << " KB -> "
+		<< (_vertices.size() * sizeof(Vertex) + _indices.size() * indexSize) / 1024 << " KB with indices)" << std::endl;
+}
+
+void Mesh::weld_vertices()
+{
+	const size_t cornerCount = _indices.empty() ? _vertices.size() : _indices.size();
+	auto corner_vertex = [this](size_t corner) -> const Vertex&
+	{
+		return _indices.empty() ? _vertices[corner] : _vertices[_indices[corner]];
+	};
+
+	//corners are sharded by hash and every shard dedupes on its own thread, walking a shard in corner order finds the
+	//same first occurrence a single serial scan would, so the result does not depend on the thread count
+	const size_t shardCount = cornerCount < PARALLEL_WELD_MIN_CORNERS ? 1 : size_t(vkn::worker_count()) * 4;
+	const size_t blockSize = (cornerCount + shardCount - 1) / shardCount;
+	auto shard_of = [shardCount](uint64_t hash)
+	{
+		return static_cast<size_t>((hash >> 40) % shardCount);
+	};
+
+	std::vector<uint64_t> hashes(cornerCount);
+	std::vector<size_t> blockShardOffsets(shardCount * shardCount, 0);
+	vkn::parallel_for(shardCount, [&](size_t block)
+	{
+		const size_t end = std::min(cornerCount, (block + 1) * blockSize);
+		for (size_t i = block * blockSize; i < end; i++)
+		{
+			hashes[i] = hash_vertex(corner_vertex(i));
+			blockShardOffsets[block * shardCount + shard_of(hashes[i])]++;
+		}
+	});
+
+	//counts -> offsets, shard major so that each shard is one contiguous run of corners in block order
+	std::vector<size_t> shardBegin(shardCount + 1, 0);
+	size_t offset = 0;
+	for (size_t shard = 0; shard < shardCount; shard++)
+	{
+		shardBegin[shard] = offset;
+		for (size_t block = 0; block < shardCount; block++)
+		{
+			const size_t count = blockShardOffsets[block * shardCount + shard];
+			blockShardOffsets[block * shardCount + shard] = offset;
+			offset += count;
+		}
+	}
+	shardBegin[shardCount] = offset;
+
+	std::vector<uint32_t> shardCorners(cornerCount);
+	vkn::parallel_for(shardCount, [&](size_t block)
+	{
+		const size_t end = std::min(cornerCount, (block + 1) * blockSize);
+		for (size_t i = block * blockSize; i < end; i++)
+			shardCorners[blockShardOffsets[block * shardCount + shard_of(hashes[i])]++] = static_cast<uint32_t>(i);
+	});
+
+	//open addressing table per shard, slots hold the upper hash bits next to the corner index so most mismatches
+	//are rejected without touching the vertex, sized for a load factor of at most one half
+	std::vector<uint32_t> firstCorner(cornerCount);
+	vkn::parallel_for(shardCount, [&](size_t shard)
+	{
+		constexpr uint64_t EMPTY_SLOT = UINT64_MAX;
+		size_t capacity = 16;
+		while (capacity < (shardBegin[shard + 1] - shardBegin[shard]) * 2)
+			capacity *= 2;
+		std::vector<uint64_t> table(capacity, EMPTY_SLOT);
+
+		for (size_t i = shardBegin[shard]; i < shardBegin[shard + 1]; i++)
+		{
+			const uint32_t corner = shardCorners[i];
+			const uint64_t tag = hashes[corner] & 0xFFFFFFFF00000000ull;
+			size_t slot = static_cast<size_t>(hashes[corner]) & (capacity - 1);
+			for (;;)
+			{
+				const uint64_t entry = table[slot];
+				if (entry == EMPTY_SLOT)
+				{
+					table[slot] = tag | corner;
+					firstCorner[corner] = corner;
+					break;
+				}
+
+				const uint32_t other = static_cast<uint32_t>(entry);
+				if ((entry & 0xFFFFFFFF00000000ull) == tag && memcmp(&corner_vertex(other), &corner_vertex(corner), sizeof(Vertex)) == 0)
+				{
+					firstCorner[corner] = other;
+					break;
+				}
+				slot = (slot + 1) & (capacity - 1);
+			}
+		}
+	});
+
+	//unique vertices are numbered in order of first use, like the serial scan did
+	std::vector<Vertex> weldedVertices;
+	std::vector<uint32_t> weldedIndices(cornerCount);
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		if (firstCorner[i] == i)
+		{
+			weldedIndices[i] = static_cast<uint32_t>(weldedVertices.size());
+			weldedVertices.push_back(corner_vertex(i));
+		}
+		else
+		{
+			weldedIndices[i] = weldedIndices[firstCorner[i]];
+		}
+	}
+
+	weldedVertices.shrink_to_fit();
+	_vertices = std::move(weldedVertices);
+	_indices = std::move(weldedIndices);
+}
+
+void Mesh::compute_bounds()
+{
+	if (_vertices.empty())
+	{
+		_bounds = {};
+		return;
+	}
+
+	glm::vec3 min = _vertices[0].position;
+	glm::vec3 max = _vertices[0].position;
+	for (const Vertex& v : _vertices)
+	{
+		min = glm::min(min, v.position);
+		max = glm::max(max, v.position);
+	}
+
+	_bounds.min = min;
+	_bounds.max = max;
+	_bounds.origin = (min + max) * 0.5f;
+
+	float radiusSq = 0.f;
+	for (const Vertex& v : _vertices)
+	{
+		glm::vec3 d = v.position - _bounds.origin;
+		radiusSq = std::max(radiusSq, glm::dot(d, d));
+	}
+	_bounds.radius = std::sqrt(radiusSq);
+}
+
+VkIndexType Mesh::select_index_type() const
+{
+	return _vertices.size() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void Mesh::pack_vertices(std::vector<uint8_t>& outData)
+{
+	const uint32_t stride = vertex_stride(_vertexFormat);
+	outData.resize(_vertices.size() * stride);
+	if (_vertexFormat == VertexFormat::Full)
+	{
+		memcpy(outData.data(), _vertices.data(), outData.size());
+		return;
+	}
+
+	glm::vec2 uvMin{ 0.f };
+	glm::vec2 uvMax{ 0.f };
+	if (!_vertices.empty())
+		uvMin = uvMax = _vertices[0].uv;
+	for (const Vertex& v : _vertices)
+	{
+		uvMin = glm::min(uvMin, v.uv);
+		uvMax = glm::max(uvMax, v.uv);
+	}
+
+	const glm::vec3 positionExtent = _bounds.max - _bounds.min;
+	const glm::vec2 uvExtent = uvMax - uvMin;
+	_quantization.positionOffset = glm::vec4(_bounds.min, 0.f);
+	_quantization.positionScale = glm::vec4(positionExtent, 0.f);
+	_quantization.uvOffsetScale = glm::vec4(uvMin, uvExtent);
+
+	for (size_t i = 0; i < _vertices.size(); i++)
+	{
+		const Vertex& v = _vertices[i];
+		PackedVertex packed;
+		for (int k = 0; k < 3; k++)
+			packed.position[k] = quantize_unorm16(v.position[k] - _bounds.min[k], positionExtent[k]);
+		packed.position[3] = 0;
+
+		const glm::vec2 normal = octahedral_encode(v.normal);
+		packed.normal[0] = quantize_snorm16(normal.x);
+		packed.normal[1] = quantize_snorm16(normal.y);
+		packed.uv[0] = quantize_unorm16(v.uv.x - uvMin.x, uvExtent.x);
+		packed.uv[1] = quantize_unorm16(v.uv.y - uvMin.y, uvExtent.y);
+
+		uint8_t* dst = outData.data() + i * stride;
+		memcpy(dst, &packed, sizeof(PackedVertex));
+		if (_vertexFormat == VertexFormat::PackedColor)
+		{
+			const uint8_t color[4] = { quantize_unorm8(v.color.r), quantize_unorm8(v.color.g), quantize_unorm8(v.color.b), 255 };
+			memcpy(dst + sizeof(PackedVertex), color, sizeof(color));
+		}
+	}
+}
+
+void Mesh::unpack_vertices(const uint8_t* data, size_t vertexCount)
+{
+	const uint32_t stride = vertex_stride(_vertexFormat);
+	_vertices.resize(vertexCount);
+	if (_vertexFormat == VertexFormat::Full)
+	{
+		memcpy(_vertices.data(), data, vertexCount * stride);
+		return;
+	}
+
+	const glm::vec3 positionOffset{ _quantization.positionOffset };
+	const glm::vec3 positionScale{ _quantization.positionScale };
+	const glm::vec2 uvOffset{ _quantization.uvOffsetScale.x, _quantization.uvOffsetScale.y };
+	const glm::vec2 uvScale{ _quantization.uvOffsetScale.z, _quantization.uvOffsetScale.w };
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const uint8_t* src = data + i * stride;
+		PackedVertex packed;
+		memcpy(&packed, src, sizeof(PackedVertex));
+
+		Vertex& v = _vertices[i];
+		v = Vertex{};
+		for (int k = 0; k < 3; k++)
+			v.position[k] = positionOffset[k] + packed.position[k] / 65535.f * positionScale[k];
+		v.normal = octahedral_decode(glm::vec2{ std::max(packed.normal[0] / 32767.f, -1.f), std::max(packed.normal[1] / 32767.f, -1.f) });
+		v.uv.x = uvOffset.x + packed.uv[0] / 65535.f * uvScale.x;
+		v.uv.y = uvOffset.y + packed.uv[1] / 65535.f * uvScale.y;
+
+		if (_vertexFormat == VertexFormat::PackedColor)
+		{
+			const uint8_t* color = src + sizeof(PackedVertex);
+			v.color = glm::vec3{ color[0], color[1], color[2] } / 255.f;
+		}
+	}
+}
@@ -1,9 +1,12 @@
 #pragma once
 #include "vk_types.h"
+#include "vk_geometry_buffer.h"
 
+#include <cstdint>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 struct VertexInputDescription
 {
@@ -21,10 +24,105 @@ struct Vertex
 	static VertexInputDescription get_vertex_description();
 };
 
+enum class VertexFormat : uint32_t
+{
+	Full = 0,        //Vertex, 44 bytes
+	Packed = 1,      //PackedVertex, 16 bytes
+	PackedColor = 2, //PackedVertex followed by an rgba8 color, 20 bytes
+};
+
+uint32_t vertex_stride(VertexFormat format);
+
+//quantized vertex, position and uv are relative to the ranges in VertexQuantization, the normal is octahedral encoded
+struct PackedVertex
+{
+	uint16_t position[4]; //unorm16, w unused
+	int16_t normal[2];    //snorm16
+	uint16_t uv[2];       //unorm16
+	static VertexInputDescription get_vertex_description(bool withColor);
+};
+
+//push constants the packed vertex shaders dequantize with, value = offset + unorm * scale
+struct VertexQuantization
+{
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
+	glm::vec4 uvOffsetScale; //xy offset, zw scale
+};
+
+struct MeshBounds
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 origin;
+	float radius;
+};
+
+//cluster of triangles, contiguous in the index buffer starting at firstIndex
+struct Meshlet
+{
+	glm::vec3 center; //bounding sphere
+	float radius;
+	glm::vec3 coneApex; //backfacing cone, every triangle faces away from a viewer inside it
+	float coneCutoff; //sin of the cone half angle, above 1 when the normals are too spread to ever cull
+	glm::vec3 coneAxis;
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+	uint32_t vertexCount;
+};
+
+//level of detail, a range of the index buffer over the shared vertex buffer
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; //geometric deviation from the full mesh, in mesh space units
+};
+
 struct Mesh
 {
 	std::vector<Vertex> _vertices;
+	std::vector<uint32_t> _indices;
+	MeshBounds _bounds{};
+
+	//gpu side counts, valid even when the cpu arrays were never filled (cooked meshes)
+	uint32_t _vertexCount{ 0 };
+	uint32_t _indexCount{ 0 };
+	//the shared geometry buffers unless they were full, draws add _vertexOffset and _firstIndex to the mesh relative
+	//vertex and index numbers
 	AllocatedBuffer _vertexBuffer;
+	AllocatedBuffer _indexBuffer;
+	VkIndexType _indexType{ VK_INDEX_TYPE_UINT32 };
+	int32_t _vertexOffset{ 0 };
+	uint32_t _firstIndex{ 0 };
+	//zero sized when the mesh owns its buffers
+	vkn::GeometryAllocation _geometry{};
+	//the buffers are only drawn once the upload manager reports this ticket complete
+	uint64_t _uploadTicket{ 0 };
+	//layout of the gpu vertex buffer, _vertices always stays full precision
+	VertexFormat _vertexFormat{ VertexFormat::Full };
+	VertexQuantization _quantization{};
+	//empty unless built by build_meshlets or loaded from a cooked file
+	std::vector<Meshlet> _meshlets;
+	//empty unless built by generate_lods or loaded from a cooked file, lod 0 is the full mesh and the meshlets only cover it
+	std::vector<MeshLod> _lods;
 
 	bool load_from_obj(const char* filename);
+	//same result as load_from_obj, parsed on all cores, falls back to the serial path for files it does not handle
+	bool load_from_obj_parallel(const char* filename);
+	void compute_bounds();
+
+	//collapses bitwise identical vertices and rebuilds _indices to reference the unique ones
+	void weld_vertices();
+	//16 bit indices when every vertex is addressable with them, 32 bit otherwise
+	VkIndexType select_index_type() const;
+
+	//gpu layout of _vertices in _vertexFormat, packed formats also fill _quantization from the bounds
+	void pack_vertices(std::vector<uint8_t>& outData);
+	//inverse of pack_vertices, rebuilds _vertices from gpu data in _vertexFormat
+	void unpack_vertices(const uint8_t* data, size_t vertexCount);
+
+private:
+	//welds the expanded corners of a freshly parsed obj and derives everything else from them
+	void finish_obj_load(const char* filename);
 };
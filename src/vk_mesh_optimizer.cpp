@@ -0,0 +1,327 @@
+#include "vk_mesh_optimizer.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+
+namespace
+{
+	constexpr uint32_t INVALID_VERTEX = UINT32_MAX;
+
+	//fifo cache emulated with timestamps, a vertex is resident while less than cacheSize misses happened since it was loaded
+	struct FifoCache
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t cacheSize;
+		uint32_t time;
+
+		FifoCache(size_t vertexCount, uint32_t size)
+			: timestamps(vertexCount, 0), cacheSize(size), time(size + 1)
+		{
+		}
+
+		bool access(uint32_t vertex)
+		{
+			if (time - timestamps[vertex] > cacheSize)
+			{
+				timestamps[vertex] = time++;
+				return true;
+			}
+			return false;
+		}
+
+		uint32_t triangle_misses(const uint32_t* triangle)
+		{
+			return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+		}
+
+		void flush()
+		{
+			time += cacheSize + 1;
+		}
+	};
+
+	//ends a cluster whenever a triangle misses on all three vertices, this is where tipsify jumped to a disjoint part
+	//of the mesh so splitting there costs nothing
+	std::vector<size_t> hard_cluster_boundaries(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<size_t> boundaries;
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			if (cache.triangle_misses(&indices[t * 3]) == 3 || t == 0)
+				boundaries.push_back(t);
+		}
+		return boundaries;
+	}
+
+	//splits the hard clusters further, each piece starts with a cold cache and is cut as soon as its own ACMR
+	//reaches threshold times the ACMR of the whole hard cluster
+	std::vector<size_t> soft_cluster_boundaries(const std::vector<uint32_t>& indices, size_t vertexCount, const std::vector<size_t>& hardBoundaries, float threshold, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<size_t> boundaries;
+
+		for (size_t c = 0; c < hardBoundaries.size(); c++)
+		{
+			const size_t begin = hardBoundaries[c];
+			const size_t end = c + 1 < hardBoundaries.size() ? hardBoundaries[c + 1] : triangleCount;
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (size_t t = begin; t < end; t++)
+				clusterMisses += cache.triangle_misses(&indices[t * 3]);
+			const float clusterThreshold = threshold * clusterMisses / float(end - begin);
+
+			boundaries.push_back(begin);
+			cache.flush();
+			uint32_t runningMisses = 0;
+			uint32_t runningTriangles = 0;
+			for (size_t t = begin; t < end; t++)
+			{
+				runningMisses += cache.triangle_misses(&indices[t * 3]);
+				runningTriangles++;
+				if (runningMisses <= clusterThreshold * runningTriangles && t + 1 < end)
+				{
+					boundaries.push_back(t + 1);
+					cache.flush();
+					runningMisses = 0;
+					runningTriangles = 0;
+				}
+			}
+		}
+		return boundaries;
+	}
+}
+
+namespace vkn
+{
+	TriangleAdjacency::TriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+		: offsets(vertexCount + 1, 0), triangles(indices.size())
+	{
+		for (uint32_t index : indices)
+			offsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats stats = {};
+		if (indices.empty())
+			return stats;
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> referenced(vertexCount, false);
+		size_t misses = 0;
+		size_t uniqueVertices = 0;
+		for (uint32_t index : indices)
+		{
+			misses += cache.access(index);
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				uniqueVertices++;
+			}
+		}
+
+		stats.acmr = float(misses) / float(indices.size() / 3);
+		stats.atvr = float(misses) / float(uniqueVertices);
+		return stats;
+	}
+
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		if (indices.empty())
+			return;
+
+		const TriangleAdjacency adjacency(indices, vertexCount);
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		std::vector<bool> emitted(indices.size() / 3, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		uint32_t cursor = 0;
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		//most recently used vertex that still has triangles left, else the next one in index order
+		auto skip_dead_end = [&]() -> uint32_t
+		{
+			while (!deadEnds.empty())
+			{
+				const uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+					return vertex;
+			}
+			for (; cursor < vertexCount; cursor++)
+			{
+				if (liveTriangles[cursor] > 0)
+					return cursor;
+			}
+			return INVALID_VERTEX;
+		};
+
+		uint32_t fanning = skip_dead_end();
+		while (fanning != INVALID_VERTEX)
+		{
+			//emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++)
+			{
+				const uint32_t triangle = adjacency.triangles[a];
+				if (emitted[triangle])
+					continue;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + k];
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+					if (time - cacheTime[vertex] > cacheSize)
+						cacheTime[vertex] = time++;
+				}
+				emitted[triangle] = true;
+			}
+
+			//next fan around the oldest candidate that is still going to be in the cache once its own fan is emitted
+			uint32_t best = INVALID_VERTEX;
+			int bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0)
+					continue;
+
+				int priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+					priority = static_cast<int>(time - cacheTime[vertex]);
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					best = vertex;
+				}
+			}
+
+			fanning = best != INVALID_VERTEX ? best : skip_dead_end();
+		}
+
+		indices = std::move(result);
+	}
+
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		const std::vector<size_t> hardBoundaries = hard_cluster_boundaries(indices, vertices.size(), cacheSize);
+		const std::vector<size_t> clusters = soft_cluster_boundaries(indices, vertices.size(), hardBoundaries, threshold, cacheSize);
+
+		glm::vec3 meshCentroid{ 0.f };
+		for (uint32_t index : indices)
+			meshCentroid += vertices[index].position;
+		meshCentroid /= float(indices.size());
+
+		//clusters facing away from the mesh center tend to occlude the rest, so they go first
+		std::vector<float> sortKeys(clusters.size());
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const size_t begin = clusters[c];
+			const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			glm::vec3 centroid{ 0.f };
+			glm::vec3 normal{ 0.f };
+			float area = 0.f;
+			for (size_t t = begin; t < end; t++)
+			{
+				const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+				const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				const float triangleArea = glm::length(n);
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normal += n;
+				area += triangleArea;
+			}
+
+			if (area > 0.f)
+				centroid /= area;
+			const float normalLength = glm::length(normal);
+			if (normalLength > 0.f)
+				normal /= normalLength;
+
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+		}
+
+		std::vector<size_t> order(clusters.size());
+		for (size_t c = 0; c < order.size(); c++)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+		{
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (size_t c : order)
+		{
+			const size_t begin = clusters[c];
+			const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+			result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+		}
+		indices = std::move(result);
+	}
+
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+		std::vector<Vertex> result;
+		result.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == INVALID_VERTEX)
+			{
+				remap[index] = static_cast<uint32_t>(result.size());
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		result.shrink_to_fit();
+		vertices = std::move(result);
+	}
+
+	MeshOptimizeStats optimize_mesh(Mesh& mesh)
+	{
+		if (mesh._indices.empty())
+			return {};
+
+		MeshOptimizeStats stats;
+		stats.before = analyze_vertex_cache(mesh._indices, mesh._vertices.size());
+
+		optimize_vertex_cache(mesh._indices, mesh._vertices.size());
+		optimize_overdraw(mesh._indices, mesh._vertices);
+		optimize_vertex_fetch(mesh._vertices, mesh._indices);
+
+		//unreferenced vertices are gone, which can shrink both
+		mesh.compute_bounds();
+		mesh._indexType = mesh.select_index_type();
+
+		stats.after = analyze_vertex_cache(mesh._indices, mesh._vertices.size());
+		return stats;
+	}
+}
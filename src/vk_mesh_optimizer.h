@@ -0,0 +1,47 @@
+#pragma once
+#include "vk_mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace vkn
+{
+	//fifo post transform cache size the passes optimize for and the statistics are measured with
+	constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+	struct VertexCacheStats
+	{
+		float acmr; //average cache miss ratio, transformed vertices per triangle (0.5 at best on a regular grid, 3 at worst)
+		float atvr; //average transform to vertex ratio, 1 when every vertex is transformed exactly once
+	};
+
+	//vertex -> triangles that reference it, a degenerate triangle is listed once per corner
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+
+		TriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount);
+	};
+
+	VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//tipsify triangle order (Sander et al. 2007), triangles keep their winding
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//splits a cache optimized index list into clusters and draws the outward facing ones first
+	//threshold bounds how much the clustering may raise the ACMR over the input order
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//renumbers vertices in first use order and drops the unreferenced ones
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	struct MeshOptimizeStats
+	{
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+
+	//runs the three passes in order on a loaded mesh and returns the cache statistics before and after
+	MeshOptimizeStats optimize_mesh(Mesh& mesh);
+}
@@ -0,0 +1,266 @@
+#include "vk_meshlet.h"
+#include "vk_mesh_optimizer.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr uint32_t INVALID_MESHLET = UINT32_MAX;
+	constexpr uint32_t INVALID_TRIANGLE = UINT32_MAX;
+
+	//cutoff a cone gets when it can never be culled, any dot of unit vectors stays below it
+	constexpr float DISABLED_CONE_CUTOFF = 2.f;
+
+	void compute_meshlet_bounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+	{
+		const uint32_t* triangles = &indices[meshlet.firstIndex];
+		const uint32_t cornerCount = meshlet.triangleCount * 3;
+
+		glm::vec3 min = vertices[triangles[0]].position;
+		glm::vec3 max = min;
+		for (uint32_t i = 1; i < cornerCount; i++)
+		{
+			min = glm::min(min, vertices[triangles[i]].position);
+			max = glm::max(max, vertices[triangles[i]].position);
+		}
+
+		meshlet.center = (min + max) * 0.5f;
+		float radiusSquared = 0.f;
+		for (uint32_t i = 0; i < cornerCount; i++)
+		{
+			const glm::vec3 offset = vertices[triangles[i]].position - meshlet.center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		meshlet.radius = std::sqrt(radiusSquared);
+
+		//normal cone, degenerate triangles face nowhere and are left out
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshlet.triangleCount);
+		glm::vec3 axis{ 0.f };
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[triangles[t * 3 + 0]].position;
+			const glm::vec3& p1 = vertices[triangles[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[triangles[t * 3 + 2]].position;
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(n);
+			normals.push_back(length > 0.f ? n / length : glm::vec3{ 0.f });
+			axis += normals.back();
+		}
+
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneAxis = glm::vec3{ 0.f, 0.f, 1.f };
+		meshlet.coneCutoff = DISABLED_CONE_CUTOFF;
+
+		const float axisLength = glm::length(axis);
+		if (axisLength <= 0.f)
+			return;
+		axis /= axisLength;
+
+		float minDot = 1.f;
+		for (const glm::vec3& n : normals)
+		{
+			if (n != glm::vec3{ 0.f })
+				minDot = std::min(minDot, glm::dot(n, axis));
+		}
+		//some triangle faces 90 degrees or more away from the axis, no viewpoint sees the back of all of them
+		if (minDot <= 0.f)
+			return;
+
+		//move the apex back along the axis until every triangle plane passes in front of it, a viewer in the cone
+		//past the apex is then behind all the planes
+		float apexDistance = 0.f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+		{
+			const glm::vec3& n = normals[t];
+			if (n == glm::vec3{ 0.f })
+				continue;
+			const glm::vec3& p0 = vertices[triangles[t * 3]].position;
+			apexDistance = std::max(apexDistance, glm::dot(meshlet.center - p0, n) / glm::dot(axis, n));
+		}
+
+		meshlet.coneApex = meshlet.center - axis * apexDistance;
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+	}
+}
+
+namespace vkn
+{
+	void build_meshlets(Mesh& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		mesh._meshlets.clear();
+		if (mesh._indices.empty() || mesh._vertices.empty())
+			return;
+		//meshlets have to be built before the lods, the lod ranges would not survive the reorder
+		if (!mesh._lods.empty())
+			return;
+
+		const std::vector<uint32_t>& indices = mesh._indices;
+		const size_t vertexCount = mesh._vertices.size();
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		const TriangleAdjacency adjacency(indices, vertexCount);
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+		std::vector<bool> emitted(triangleCount, false);
+		//meshlet a vertex was last added to, tells whether a triangle would bring new vertices
+		std::vector<uint32_t> vertexMeshlet(vertexCount, INVALID_MESHLET);
+		uint32_t cursor = 0;
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		Meshlet meshlet = {};
+		std::vector<uint32_t> meshletVertices;
+		meshletVertices.reserve(maxVertices);
+
+		auto new_vertices = [&](uint32_t triangle)
+		{
+			const uint32_t meshletIndex = static_cast<uint32_t>(mesh._meshlets.size());
+			const uint32_t* corners = &indices[triangle * 3];
+			uint32_t count = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				//a degenerate triangle can repeat a vertex, it only counts once
+				const bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+				count += vertexMeshlet[corners[k]] != meshletIndex && !repeated;
+			}
+			return count;
+		};
+
+		auto fits = [&](uint32_t triangle)
+		{
+			return meshlet.triangleCount < maxTriangles && meshlet.vertexCount + new_vertices(triangle) <= maxVertices;
+		};
+
+		auto add_triangle = [&](uint32_t triangle)
+		{
+			const uint32_t meshletIndex = static_cast<uint32_t>(mesh._meshlets.size());
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + k];
+				if (vertexMeshlet[vertex] != meshletIndex)
+				{
+					vertexMeshlet[vertex] = meshletIndex;
+					meshletVertices.push_back(vertex);
+					meshlet.vertexCount++;
+				}
+				liveTriangles[vertex]--;
+				result.push_back(vertex);
+			}
+			emitted[triangle] = true;
+			meshlet.triangleCount++;
+		};
+
+		auto finish_meshlet = [&]()
+		{
+			mesh._meshlets.push_back(meshlet);
+			meshlet = {};
+			meshlet.firstIndex = static_cast<uint32_t>(result.size());
+			meshletVertices.clear();
+		};
+
+		//best unemitted triangle around the given vertices, fewest new vertices first, then the one that leaves the
+		//fewest triangles hanging on its vertices so the meshlet border stays short
+		auto best_adjacent = [&](const uint32_t* vertices, size_t count)
+		{
+			uint32_t best = INVALID_TRIANGLE;
+			uint32_t bestNew = UINT32_MAX;
+			uint32_t bestLive = UINT32_MAX;
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint32_t vertex = vertices[i];
+				for (uint32_t a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; a++)
+				{
+					const uint32_t triangle = adjacency.triangles[a];
+					if (emitted[triangle])
+						continue;
+
+					const uint32_t newCount = new_vertices(triangle);
+					const uint32_t* corners = &indices[triangle * 3];
+					const uint32_t live = liveTriangles[corners[0]] + liveTriangles[corners[1]] + liveTriangles[corners[2]];
+					if (newCount < bestNew || (newCount == bestNew && live < bestLive))
+					{
+						best = triangle;
+						bestNew = newCount;
+						bestLive = live;
+					}
+				}
+			}
+			return best;
+		};
+
+		uint32_t emittedCount = 0;
+		while (emittedCount < triangleCount)
+		{
+			uint32_t next = INVALID_TRIANGLE;
+			if (meshlet.triangleCount > 0)
+			{
+				//the last triangle's neighbours keep the meshlet compact, the whole meshlet border is the fallback
+				next = best_adjacent(&result[result.size() - 3], 3);
+				if (next == INVALID_TRIANGLE)
+					next = best_adjacent(meshletVertices.data(), meshletVertices.size());
+			}
+			if (next == INVALID_TRIANGLE)
+			{
+				//connected part exhausted, continue with the next triangle in index order which the cache optimizer
+				//already left close by
+				while (emitted[cursor])
+					cursor++;
+				next = cursor;
+			}
+
+			if (meshlet.triangleCount > 0 && !fits(next))
+				finish_meshlet();
+			add_triangle(next);
+			emittedCount++;
+		}
+		finish_meshlet();
+
+		mesh._indices = std::move(result);
+		//the triangle order changed, so does the first use order of the vertices
+		optimize_vertex_fetch(mesh._vertices, mesh._indices);
+
+		for (Meshlet& m : mesh._meshlets)
+			compute_meshlet_bounds(m, mesh._indices, mesh._vertices);
+	}
+
+	bool meshlet_backfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition)
+	{
+		const glm::vec3 view = meshlet.coneApex - cameraPosition;
+		const float distance = glm::length(view);
+		return glm::dot(view, meshlet.coneAxis) > meshlet.coneCutoff * distance;
+	}
+
+	void cull_meshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces,
+		std::vector<IndexRange>& outRanges, MeshletCullStats& stats)
+	{
+		const size_t firstRange = outRanges.size();
+		for (const Meshlet& meshlet : meshlets)
+		{
+			stats.tested++;
+			if (!sphere_in_frustum(frustum, meshlet.center, meshlet.radius))
+			{
+				stats.frustumCulled++;
+				continue;
+			}
+			if (cullBackfaces && meshlet_backfacing(meshlet, cameraPosition))
+			{
+				stats.backfaceCulled++;
+				continue;
+			}
+
+			const uint32_t indexCount = meshlet.triangleCount * 3;
+			if (outRanges.size() > firstRange && outRanges.back().firstIndex + outRanges.back().indexCount == meshlet.firstIndex)
+				outRanges.back().indexCount += indexCount;
+			else
+				outRanges.push_back({ meshlet.firstIndex, indexCount });
+		}
+		stats.drawCalls += static_cast<uint32_t>(outRanges.size() - firstRange);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "vk_mesh.h"
+#include "vk_culling.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace vkn
+{
+	//limits sized for a mesh shader workgroup, 124 triangles keeps the primitive indices of a meshlet under 384 bytes
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	//splits the mesh into meshlets grown greedily over shared edges, then reorders _indices so every meshlet is a
+	//contiguous range and renumbers the vertices in the new first use order, needs the cpu side _vertices and no lods yet
+	void build_meshlets(Mesh& mesh, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+	//true when every triangle of the meshlet faces away from cameraPosition, given in mesh space
+	bool meshlet_backfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+
+	struct MeshletCullStats
+	{
+		uint32_t tested;
+		uint32_t frustumCulled;
+		uint32_t backfaceCulled;
+		uint32_t drawCalls;
+	};
+
+	struct IndexRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	//appends the index ranges of the visible meshlets to outRanges, neighbouring visible meshlets are merged into one range
+	//frustum and cameraPosition are in mesh space, see extract_frustum
+	void cull_meshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces,
+		std::vector<IndexRange>& outRanges, MeshletCullStats& stats);
+}
@@ -0,0 +1,448 @@
+#include "vk_obj_parser.h"
+#include "vk_asset.h"
+#include "vk_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	//below this per chunk the thread hand off costs more than the parse
+	constexpr size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+	enum ObjAttribute
+	{
+		OBJ_POSITION = 0,
+		OBJ_TEXCOORD = 1,
+		OBJ_NORMAL = 2,
+	};
+
+	struct ObjCorner
+	{
+		//zero based, indexed by ObjAttribute, -1 when the face does not reference that attribute
+		int32_t index[3];
+	};
+
+	//records of one line aligned slice of the file, in file order
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texcoords;
+		std::vector<ObjCorner> corners;
+		//corner * 3 + attribute for every negative index, those are relative to this chunk until the merge knows what came before it
+		std::vector<uint32_t> relativeIndices;
+		bool supported{ true };
+
+		size_t firstPosition{ 0 };
+		size_t firstNormal{ 0 };
+		size_t firstTexcoord{ 0 };
+		size_t firstCorner{ 0 };
+	};
+
+	bool is_space(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	bool is_digit(char c)
+	{
+		return static_cast<unsigned int>(c - '0') < 10u;
+	}
+
+	//same grammar and the same arithmetic as tinyobj's tryParseDouble, anything else would round differently than the serial path
+	bool parse_double(const char* s, const char* end, double* result)
+	{
+		if (s >= end)
+			return false;
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		char sign = '+';
+		char expSign = '+';
+		const char* curr = s;
+		int read = 0;
+		bool leadingDecimalDot = false;
+
+		if (*curr == '+' || *curr == '-')
+		{
+			sign = *curr;
+			curr++;
+			if (curr != end && *curr == '.')
+				leadingDecimalDot = true;
+		}
+		else if (*curr == '.')
+		{
+			leadingDecimalDot = true;
+		}
+		else if (!is_digit(*curr))
+		{
+			return false;
+		}
+
+		if (!leadingDecimalDot)
+		{
+			while (curr != end && is_digit(*curr))
+			{
+				mantissa *= 10;
+				mantissa += static_cast<int>(*curr - '0');
+				curr++;
+				read++;
+			}
+			if (read == 0)
+				return false;
+		}
+
+		if (curr != end && *curr == '.')
+		{
+			static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+			constexpr int lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+			curr++;
+			read = 1;
+			while (curr != end && is_digit(*curr))
+			{
+				mantissa += static_cast<int>(*curr - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+				read++;
+				curr++;
+			}
+		}
+
+		if (curr != end && (*curr == 'e' || *curr == 'E'))
+		{
+			curr++;
+			if (curr != end && (*curr == '+' || *curr == '-'))
+			{
+				expSign = *curr;
+				curr++;
+			}
+			else if (curr == end || !is_digit(*curr))
+			{
+				return false;
+			}
+
+			read = 0;
+			while (curr != end && is_digit(*curr))
+			{
+				exponent *= 10;
+				exponent += static_cast<int>(*curr - '0');
+				curr++;
+				read++;
+			}
+			exponent *= (expSign == '+' ? 1 : -1);
+			if (read == 0)
+				return false;
+		}
+
+		*result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+		return true;
+	}
+
+	//a token runs to the next space or tab, unparsable or missing tokens give the default like in tinyobj
+	float parse_real(const char*& p, const char* end)
+	{
+		while (p < end && is_space(*p))
+			p++;
+		const char* tokenEnd = p;
+		while (tokenEnd < end && !is_space(*tokenEnd))
+			tokenEnd++;
+
+		double value = 0.0;
+		parse_double(p, tokenEnd, &value);
+		p = tokenEnd;
+		return static_cast<float>(value);
+	}
+
+	//strict [-]digits, anything tinyobj would only accept by accident makes the chunk fall back to it
+	bool parse_index(const char*& p, const char* end, size_t count, int32_t& outIndex, bool& outRelative)
+	{
+		const bool negative = p < end && *p == '-';
+		if (negative)
+			p++;
+		if (p == end || !is_digit(*p))
+			return false;
+
+		int64_t value = 0;
+		while (p < end && is_digit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			if (value > INT32_MAX)
+				return false;
+			p++;
+		}
+
+		//0 is not a valid obj index
+		if (value == 0)
+			return false;
+
+		outRelative = negative;
+		outIndex = static_cast<int32_t>(negative ? static_cast<int64_t>(count) - value : value - 1);
+		return true;
+	}
+
+	//v, v/t, v//n or v/t/n
+	bool parse_corner(const char*& p, const char* end, const ObjChunk& chunk, ObjCorner& outCorner, uint32_t& outRelativeMask)
+	{
+		outCorner.index[OBJ_POSITION] = -1;
+		outCorner.index[OBJ_TEXCOORD] = -1;
+		outCorner.index[OBJ_NORMAL] = -1;
+		outRelativeMask = 0;
+
+		bool relative;
+		if (!parse_index(p, end, chunk.positions.size(), outCorner.index[OBJ_POSITION], relative))
+			return false;
+		outRelativeMask |= relative << OBJ_POSITION;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/')
+			{
+				if (!parse_index(p, end, chunk.texcoords.size(), outCorner.index[OBJ_TEXCOORD], relative))
+					return false;
+				outRelativeMask |= relative << OBJ_TEXCOORD;
+			}
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (!parse_index(p, end, chunk.normals.size(), outCorner.index[OBJ_NORMAL], relative))
+					return false;
+				outRelativeMask |= relative << OBJ_NORMAL;
+			}
+		}
+
+		return p == end || is_space(*p);
+	}
+
+	void parse_face(const char* p, const char* end, ObjChunk& chunk)
+	{
+		ObjCorner face[3];
+		uint32_t relativeMasks[3];
+		int cornerCount = 0;
+
+		while (p < end && is_space(*p))
+			p++;
+		while (p < end)
+		{
+			ObjCorner corner;
+			uint32_t relativeMask;
+			//polygons go through tinyobj, its ear clipping decides the triangle order
+			if (cornerCount == 3 || !parse_corner(p, end, chunk, corner, relativeMask))
+			{
+				chunk.supported = false;
+				return;
+			}
+
+			face[cornerCount] = corner;
+			relativeMasks[cornerCount] = relativeMask;
+			cornerCount++;
+
+			while (p < end && is_space(*p))
+				p++;
+		}
+
+		//tinyobj drops faces with less than 3 corners as well
+		if (cornerCount < 3)
+			return;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const uint32_t corner = static_cast<uint32_t>(chunk.corners.size());
+			chunk.corners.push_back(face[i]);
+			for (uint32_t attribute = 0; attribute < 3; attribute++)
+			{
+				if (relativeMasks[i] & (1u << attribute))
+					chunk.relativeIndices.push_back(corner * 3 + attribute);
+			}
+		}
+	}
+
+	void parse_line(const char* p, const char* end, ObjChunk& chunk)
+	{
+		while (p < end && is_space(*p))
+			p++;
+
+		const size_t length = end - p;
+		if (length < 2)
+			return;
+
+		if (p[0] == 'v' && is_space(p[1]))
+		{
+			p += 2;
+			glm::vec3 position;
+			position.x = parse_real(p, end);
+			position.y = parse_real(p, end);
+			position.z = parse_real(p, end);
+			chunk.positions.push_back(position);
+		}
+		else if (length > 2 && p[0] == 'v' && p[1] == 'n' && is_space(p[2]))
+		{
+			p += 3;
+			glm::vec3 normal;
+			normal.x = parse_real(p, end);
+			normal.y = parse_real(p, end);
+			normal.z = parse_real(p, end);
+			chunk.normals.push_back(normal);
+		}
+		else if (length > 2 && p[0] == 'v' && p[1] == 't' && is_space(p[2]))
+		{
+			p += 3;
+			glm::vec2 texcoord;
+			texcoord.x = parse_real(p, end);
+			texcoord.y = parse_real(p, end);
+			chunk.texcoords.push_back(texcoord);
+		}
+		else if (p[0] == 'f' && is_space(p[1]))
+		{
+			parse_face(p + 2, end, chunk);
+		}
+		else if ((p[0] == 'l' || p[0] == 'p') && is_space(p[1]))
+		{
+			//an invalid line or point record fails the whole serial load, let it report that
+			chunk.supported = false;
+		}
+	}
+
+	//lines end at \n, \r\n or a lone \r, matching tinyobj's safeGetline
+	void parse_chunk(ObjChunk& chunk)
+	{
+		const char* p = chunk.begin;
+		while (p < chunk.end && chunk.supported)
+		{
+			const char* newline = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+			if (!newline)
+				newline = chunk.end;
+			const char* carriage = static_cast<const char*>(memchr(p, '\r', newline - p));
+
+			if (carriage)
+			{
+				parse_line(p, carriage, chunk);
+				p = (carriage + 1 < chunk.end && carriage[1] == '\n') ? carriage + 2 : carriage + 1;
+			}
+			else
+			{
+				parse_line(p, newline, chunk);
+				p = newline + 1;
+			}
+		}
+	}
+
+	bool index_in_range(int32_t index, size_t count, bool optional)
+	{
+		return (optional && index == -1) || (index >= 0 && static_cast<size_t>(index) < count);
+	}
+}
+
+namespace vkn
+{
+	bool parse_obj_parallel(const char* filename, std::vector<Vertex>& outVertices)
+	{
+		MappedFile file;
+		if (!file.open(filename))
+			return false;
+
+		const char* data = reinterpret_cast<const char*>(file.data());
+		const char* dataEnd = data + file.size();
+
+		//more chunks than workers so a chunk heavy on faces does not leave the others idle
+		const size_t chunkCount = std::clamp<size_t>(file.size() / MIN_CHUNK_BYTES, 1, size_t(worker_count()) * 4);
+		std::vector<ObjChunk> chunks(chunkCount);
+
+		//every chunk starts right after a line feed, no record is ever split
+		const char* chunkBegin = data;
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			const char* chunkEnd = dataEnd;
+			if (i + 1 < chunkCount)
+			{
+				const char* split = std::max(chunkBegin, data + file.size() * (i + 1) / chunkCount);
+				const char* newline = static_cast<const char*>(memchr(split, '\n', dataEnd - split));
+				chunkEnd = newline ? newline + 1 : dataEnd;
+			}
+			chunks[i].begin = chunkBegin;
+			chunks[i].end = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+
+		parallel_for(chunkCount, [&](size_t i)
+		{
+			parse_chunk(chunks[i]);
+		});
+
+		//the merge only needs counts, chunks keep their file order so the result does not depend on the chunking
+		size_t positionCount = 0;
+		size_t normalCount = 0;
+		size_t texcoordCount = 0;
+		size_t cornerCount = 0;
+		for (ObjChunk& chunk : chunks)
+		{
+			if (!chunk.supported)
+				return false;
+
+			chunk.firstPosition = positionCount;
+			chunk.firstNormal = normalCount;
+			chunk.firstTexcoord = texcoordCount;
+			chunk.firstCorner = cornerCount;
+			positionCount += chunk.positions.size();
+			normalCount += chunk.normals.size();
+			texcoordCount += chunk.texcoords.size();
+			cornerCount += chunk.corners.size();
+		}
+
+		if (positionCount > INT32_MAX || normalCount > INT32_MAX || texcoordCount > INT32_MAX)
+			return false;
+
+		std::vector<glm::vec3> positions(positionCount);
+		std::vector<glm::vec3> normals(normalCount);
+		std::vector<glm::vec2> texcoords(texcoordCount);
+		parallel_for(chunkCount, [&](size_t i)
+		{
+			ObjChunk& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstPosition);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.firstNormal);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.firstTexcoord);
+
+			const int32_t first[3] = { static_cast<int32_t>(chunk.firstPosition), static_cast<int32_t>(chunk.firstTexcoord), static_cast<int32_t>(chunk.firstNormal) };
+			for (uint32_t relative : chunk.relativeIndices)
+				chunk.corners[relative / 3].index[relative % 3] += first[relative % 3];
+		});
+
+		//same vertex construction as Mesh::load_from_obj, out of range indices are left for the serial path to report
+		std::atomic<bool> valid{ true };
+		outVertices.clear();
+		outVertices.resize(cornerCount);
+		parallel_for(chunkCount, [&](size_t i)
+		{
+			const ObjChunk& chunk = chunks[i];
+			Vertex* vertices = outVertices.data() + chunk.firstCorner;
+			for (const ObjCorner& corner : chunk.corners)
+			{
+				if (!index_in_range(corner.index[OBJ_POSITION], positionCount, false) ||
+					!index_in_range(corner.index[OBJ_NORMAL], normalCount, true) ||
+					!index_in_range(corner.index[OBJ_TEXCOORD], texcoordCount, true))
+				{
+					valid = false;
+					return;
+				}
+
+				Vertex vertex{};
+				vertex.position = positions[corner.index[OBJ_POSITION]];
+				if (corner.index[OBJ_NORMAL] >= 0)
+					vertex.normal = normals[corner.index[OBJ_NORMAL]];
+				if (corner.index[OBJ_TEXCOORD] >= 0)
+				{
+					vertex.uv.x = texcoords[corner.index[OBJ_TEXCOORD]].x;
+					vertex.uv.y = 1 - texcoords[corner.index[OBJ_TEXCOORD]].y;
+				}
+				*vertices++ = vertex;
+			}
+		});
+
+		return valid;
+	}
+}
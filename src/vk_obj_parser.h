@@ -0,0 +1,13 @@
+#pragma once
+#include "vk_mesh.h"
+
+#include <vector>
+
+namespace vkn
+{
+	//multithreaded replacement for the tinyobj pass of Mesh::load_from_obj
+	//fills outVertices with one vertex per triangle corner, bit for bit what the serial path builds before welding
+	//returns false when the file needs something the fast path does not handle (polygons, lines, points, malformed
+	//or out of range indices), the caller then takes the serial path so errors and triangulation stay tinyobj's
+	bool parse_obj_parallel(const char* filename, std::vector<Vertex>& outVertices);
+}
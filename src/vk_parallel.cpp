@@ -0,0 +1,36 @@
+#include "vk_parallel.h"
+#include "vk_jobs.h"
+
+namespace vkn
+{
+	uint32_t worker_count()
+	{
+		return job_system().thread_count() + 1;
+	}
+
+	void parallel_for(size_t count, const std::function<void(size_t)>& function)
+	{
+		if (count == 0)
+			return;
+		if (count == 1)
+		{
+			function(0);
+			return;
+		}
+
+		//one job per item, the calling thread runs them too while it waits, so a parallel_for inside a job never
+		//blocks a worker and nested loops share the same threads instead of spawning more
+		JobSystem& jobs = job_system();
+		JobCounter counter;
+		for (size_t i = 0; i < count; i++)
+		{
+			Job job;
+			job.function = [](void* data, size_t index) { (*static_cast<const std::function<void(size_t)>*>(data))(index); };
+			job.data = const_cast<std::function<void(size_t)>*>(&function);
+			job.index = i;
+			job.counter = &counter;
+			jobs.submit(job);
+		}
+		jobs.wait(counter);
+	}
+}
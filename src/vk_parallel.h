@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace vkn
+{
+	//threads cpu side batch work is spread over, the calling thread included
+	uint32_t worker_count();
+
+	//runs function(i) for every i in [0, count) and returns once all of them finished
+	//items run as jobs on the job system, the function must not depend on the order they run in
+	void parallel_for(size_t count, const std::function<void(size_t)>& function);
+}
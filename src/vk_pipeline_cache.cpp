@@ -0,0 +1,175 @@
+#include "vk_pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+	constexpr uint32_t CACHE_FILE_MAGIC = 0x43504B56; //VKPC
+	constexpr uint32_t CACHE_FILE_VERSION = 1;
+
+	//fnv-1a, only there to catch a damaged file before the driver sees it
+	uint64_t hash_bytes(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+namespace vkn
+{
+	void PipelineCache::init(VkDevice newDevice, VkPhysicalDevice physicalDevice, const std::string& path)
+	{
+		_device = newDevice;
+		_path = path;
+
+		//the driver uuid changes with driver builds the version number does not tell apart
+		VkPhysicalDeviceIDProperties idProperties = {};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &idProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+		_properties = properties.properties;
+		std::memcpy(_driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+
+		_savedData = load(path);
+		_loadedBytes = _savedData.size();
+
+		VkPipelineCacheCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		info.initialDataSize = _savedData.size();
+		info.pInitialData = _savedData.empty() ? nullptr : _savedData.data();
+		if (vkCreatePipelineCache(_device, &info, nullptr, &_cache) != VK_SUCCESS && !_savedData.empty())
+		{
+			//a driver that still refuses the data gets an empty cache
+			_coldReason = "rejected by the driver";
+			_savedData.clear();
+			_loadedBytes = 0;
+			info.initialDataSize = 0;
+			info.pInitialData = nullptr;
+			vkCreatePipelineCache(_device, &info, nullptr, &_cache);
+		}
+	}
+
+	void PipelineCache::cleanup()
+	{
+		vkDestroyPipelineCache(_device, _cache, nullptr);
+		_cache = VK_NULL_HANDLE;
+	}
+
+	bool PipelineCache::save()
+	{
+		size_t size = 0;
+		if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS)
+			return false;
+		std::vector<uint8_t> data(size);
+		if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS)
+			return false;
+		data.resize(size);
+		if (data == _savedData)
+			return true;
+
+		FileHeader header = device_header();
+		header.dataSize = data.size();
+		header.dataHash = hash_bytes(data.data(), data.size());
+
+		const std::string tempPath = _path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			file.close();
+			if (!file)
+			{
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+
+		//replaces the old file in one step, readers see either the old cache or the new one
+		std::error_code error;
+		std::filesystem::rename(tempPath, _path, error);
+		if (error)
+		{
+			std::remove(tempPath.c_str());
+			return false;
+		}
+		_savedData.swap(data);
+		return true;
+	}
+
+	PipelineCache::FileHeader PipelineCache::device_header() const
+	{
+		FileHeader header = {};
+		header.magic = CACHE_FILE_MAGIC;
+		header.version = CACHE_FILE_VERSION;
+		header.vendorID = _properties.vendorID;
+		header.deviceID = _properties.deviceID;
+		header.driverVersion = _properties.driverVersion;
+		std::memcpy(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE);
+		std::memcpy(header.driverUUID, _driverUUID, VK_UUID_SIZE);
+		return header;
+	}
+
+	std::vector<uint8_t> PipelineCache::load(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			_coldReason = "no cache file";
+			return {};
+		}
+
+		const size_t fileSize = static_cast<size_t>(file.tellg());
+		FileHeader header;
+		if (fileSize < sizeof(header))
+		{
+			_coldReason = "cache file truncated";
+			return {};
+		}
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		const FileHeader expected = device_header();
+		if (header.magic != expected.magic || header.version != expected.version)
+		{
+			_coldReason = "not a cache file of this version";
+			return {};
+		}
+		if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID)
+		{
+			_coldReason = "written by another device";
+			return {};
+		}
+		if (header.driverVersion != expected.driverVersion
+			|| std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0
+			|| std::memcmp(header.driverUUID, expected.driverUUID, VK_UUID_SIZE) != 0)
+		{
+			_coldReason = "written by another driver";
+			return {};
+		}
+		if (header.dataSize != fileSize - sizeof(header))
+		{
+			_coldReason = "cache file truncated";
+			return {};
+		}
+
+		std::vector<uint8_t> data(static_cast<size_t>(header.dataSize));
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!file || hash_bytes(data.data(), data.size()) != header.dataHash)
+		{
+			_coldReason = "cache file damaged";
+			return {};
+		}
+		return data;
+	}
+}
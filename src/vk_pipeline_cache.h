@@ -0,0 +1,57 @@
+#pragma once
+#include "vk_types.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkn
+{
+	//a VkPipelineCache kept in a file between runs, the file only counts when the same device and driver wrote it
+	class PipelineCache
+	{
+	public:
+		//starts from the file at path when it matches the device, empty otherwise
+		void init(VkDevice newDevice, VkPhysicalDevice physicalDevice, const std::string& path);
+		//does not save, call save first to keep what was compiled
+		void cleanup();
+
+		//writes next to the file and renames over it, so a crash never leaves half a cache behind
+		//skipped when the data did not change since it was loaded or last saved
+		bool save();
+
+		VkPipelineCache cache() const { return _cache; }
+		//the cache started out with what a previous run compiled
+		bool warm() const { return _loadedBytes > 0; }
+		size_t loaded_bytes() const { return _loadedBytes; }
+		//why the file was not used, empty when it was
+		const std::string& cold_reason() const { return _coldReason; }
+
+	private:
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint8_t driverUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		FileHeader device_header() const;
+		std::vector<uint8_t> load(const std::string& path);
+
+		VkDevice _device;
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
+		std::string _path;
+		VkPhysicalDeviceProperties _properties;
+		uint8_t _driverUUID[VK_UUID_SIZE];
+		size_t _loadedBytes{ 0 };
+		std::string _coldReason;
+		//what the file holds now, a save with the same data is skipped
+		std::vector<uint8_t> _savedData;
+	};
+}
@@ -0,0 +1,198 @@
+#include "vk_render_scene.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace vkn
+{
+	RenderHandle RenderScene::add(Mesh* mesh, Material* material, const glm::mat4& transform, uint32_t flags)
+	{
+		const uint32_t index = static_cast<uint32_t>(_transforms.size());
+		uint32_t slot;
+		if (_freeSlots.empty())
+		{
+			slot = static_cast<uint32_t>(_slots.size());
+			_slots.push_back({ index, 0 });
+		}
+		else
+		{
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+			_slots[slot].index = index;
+		}
+
+		_transforms.push_back(transform);
+		_bounds.resize(index + 1);
+		_meshIds.push_back(mesh_id(mesh));
+		_materialIds.push_back(material_id(material));
+		_flags.push_back(flags);
+		_slotOf.push_back(slot);
+		_dirty.push_back(0);
+		update_bounds(index);
+		mark_dirty(index);
+		return { slot, _slots[slot].generation };
+	}
+
+	bool RenderScene::remove(RenderHandle handle)
+	{
+		if (!valid(handle))
+			return false;
+		remove_at(_slots[handle.slot].index);
+		return true;
+	}
+
+	size_t RenderScene::remove_mesh(const Mesh* mesh)
+	{
+		auto it = _meshIdOf.find(mesh);
+		if (it == _meshIdOf.end())
+			return 0;
+
+		//from the back, so what moves into a gap has already been looked at
+		const uint32_t id = it->second;
+		size_t removed = 0;
+		for (size_t i = _meshIds.size(); i-- > 0;)
+		{
+			if (_meshIds[i] == id)
+			{
+				remove_at(static_cast<uint32_t>(i));
+				removed++;
+			}
+		}
+		_meshTable[id] = nullptr;
+		_meshIdOf.erase(it);
+		return removed;
+	}
+
+	bool RenderScene::valid(RenderHandle handle) const
+	{
+		//freeing a slot bumps its generation, so only the handle it was last handed out with matches
+		return handle.slot < _slots.size() && _slots[handle.slot].generation == handle.generation;
+	}
+
+	RenderHandle RenderScene::handle_at(uint32_t index) const
+	{
+		const uint32_t slot = _slotOf[index];
+		return { slot, _slots[slot].generation };
+	}
+
+	void RenderScene::set_transform(RenderHandle handle, const glm::mat4& transform)
+	{
+		const uint32_t index = _slots[handle.slot].index;
+		_transforms[index] = transform;
+		update_bounds(index);
+		mark_dirty(index);
+	}
+
+	void RenderScene::set_flags(RenderHandle handle, uint32_t flags)
+	{
+		const uint32_t index = _slots[handle.slot].index;
+		_flags[index] = flags;
+		update_bounds(index);
+	}
+
+	void RenderScene::take_dirty_ranges(uint32_t maxGap, std::vector<ObjectRange>& outRanges)
+	{
+		outRanges.clear();
+		auto append = [&](uint32_t index)
+		{
+			_dirty[index] = 0;
+			ObjectRange* last = outRanges.empty() ? nullptr : &outRanges.back();
+			if (last && index <= last->first + last->count + maxGap)
+				last->count = index + 1 - last->first;
+			else
+				outRanges.push_back({ index, 1 });
+		};
+
+		//a few moved objects are sorted, once a good share of the scene moved one pass over the flags is cheaper
+		const uint32_t count = static_cast<uint32_t>(_transforms.size());
+		if (_dirtyList.size() * 16 > count)
+		{
+			for (uint32_t index = 0; index < count; index++)
+			{
+				if (_dirty[index])
+					append(index);
+			}
+		}
+		else
+		{
+			std::sort(_dirtyList.begin(), _dirtyList.end());
+			for (uint32_t index : _dirtyList)
+			{
+				//sorted, so everything from here on was left behind by removals
+				if (index >= count)
+					break;
+				append(index);
+			}
+		}
+		_dirtyList.clear();
+	}
+
+	uint32_t RenderScene::mesh_id(Mesh* mesh)
+	{
+		auto inserted = _meshIdOf.insert({ mesh, static_cast<uint32_t>(_meshTable.size()) });
+		if (inserted.second)
+			_meshTable.push_back(mesh);
+		return inserted.first->second;
+	}
+
+	uint32_t RenderScene::material_id(Material* material)
+	{
+		auto inserted = _materialIdOf.insert({ material, static_cast<uint32_t>(_materialTable.size()) });
+		if (inserted.second)
+			_materialTable.push_back(material);
+		return inserted.first->second;
+	}
+
+	void RenderScene::update_bounds(uint32_t index)
+	{
+		if (_flags[index] & RENDER_FLAG_HIDDEN)
+		{
+			//no plane distance is ever below minus infinity, so the sphere is always outside
+			_bounds.set(index, glm::vec3(0.f), -std::numeric_limits<float>::infinity());
+			return;
+		}
+
+		//the largest axis scale keeps the sphere conservative under non uniform scaling, as in the culling shader
+		const glm::mat4& model = _transforms[index];
+		const MeshBounds& meshBounds = _meshTable[_meshIds[index]]->_bounds;
+		const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		_bounds.set(index, glm::vec3(model * glm::vec4(meshBounds.origin, 1.f)), meshBounds.radius * scale);
+	}
+
+	void RenderScene::remove_at(uint32_t index)
+	{
+		const uint32_t last = static_cast<uint32_t>(_transforms.size() - 1);
+		const uint32_t slot = _slotOf[index];
+		if (index != last)
+		{
+			_transforms[index] = _transforms[last];
+			_bounds.set(index, glm::vec3(_bounds.x[last], _bounds.y[last], _bounds.z[last]), _bounds.radius[last]);
+			_meshIds[index] = _meshIds[last];
+			_materialIds[index] = _materialIds[last];
+			_flags[index] = _flags[last];
+			_slotOf[index] = _slotOf[last];
+			_slots[_slotOf[index]].index = index;
+			mark_dirty(index);
+		}
+
+		_transforms.pop_back();
+		_bounds.resize(last);
+		_meshIds.pop_back();
+		_materialIds.pop_back();
+		_flags.pop_back();
+		_slotOf.pop_back();
+		_dirty.pop_back();
+
+		_slots[slot].generation++;
+		_freeSlots.push_back(slot);
+	}
+
+	void RenderScene::mark_dirty(uint32_t index)
+	{
+		if (_dirty[index])
+			return;
+		_dirty[index] = 1;
+		_dirtyList.push_back(index);
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "vk_mesh.h"
+#include "vk_culling.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+struct Material;
+
+namespace vkn
+{
+	//stays valid until its object is removed, a handle to a removed object never resolves to one added later
+	struct RenderHandle
+	{
+		uint32_t slot;
+		uint32_t generation;
+	};
+
+	//a run of dense indices
+	struct ObjectRange
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	enum RenderFlags : uint32_t
+	{
+		//kept in the scene but never drawn, its bounds fail every frustum test
+		RENDER_FLAG_HIDDEN = 1 << 0,
+	};
+
+	//the objects of a scene as dense arrays, one per attribute, so culling only walks the bounds, upload only the
+	//transforms and drawing only the ids, a removal moves the last object into the gap
+	//meshes and materials are referenced by small ids into tables of their own
+	class RenderScene
+	{
+	public:
+		RenderHandle add(Mesh* mesh, Material* material, const glm::mat4& transform, uint32_t flags = 0);
+		//false when the handle is stale
+		bool remove(RenderHandle handle);
+		//removes every object drawing the mesh and forgets its id, returns how many objects went
+		size_t remove_mesh(const Mesh* mesh);
+
+		bool valid(RenderHandle handle) const;
+		//dense index of a live handle, it changes whenever another object is removed
+		uint32_t index_of(RenderHandle handle) const { return _slots[handle.slot].index; }
+		RenderHandle handle_at(uint32_t index) const;
+
+		//the handle has to be valid
+		void set_transform(RenderHandle handle, const glm::mat4& transform);
+		void set_flags(RenderHandle handle, uint32_t flags);
+
+		//the dense arrays, all indexed the same way
+		size_t size() const { return _transforms.size(); }
+		const std::vector<glm::mat4>& transforms() const { return _transforms; }
+		//world space, kept up to date on every add and transform change
+		const SphereArrays& bounds() const { return _bounds; }
+		const std::vector<uint32_t>& mesh_ids() const { return _meshIds; }
+		const std::vector<uint32_t>& material_ids() const { return _materialIds; }
+		const std::vector<uint32_t>& flags() const { return _flags; }
+
+		//objects whose transform changed since the last call as sorted ranges, added objects and objects a removal moved
+		//included, runs less than maxGap objects apart are merged since copying a few clean ones beats another range
+		void take_dirty_ranges(uint32_t maxGap, std::vector<ObjectRange>& outRanges);
+
+		//ids run from 0 to the counts, mesh ids of removed meshes stay taken and resolve to null
+		Mesh* mesh(uint32_t id) const { return _meshTable[id]; }
+		Material* material(uint32_t id) const { return _materialTable[id]; }
+		uint32_t mesh_count() const { return static_cast<uint32_t>(_meshTable.size()); }
+		uint32_t material_count() const { return static_cast<uint32_t>(_materialTable.size()); }
+
+	private:
+		struct Slot
+		{
+			uint32_t index; //into the dense arrays, meaningless while the slot is free
+			uint32_t generation;
+		};
+
+		uint32_t mesh_id(Mesh* mesh);
+		uint32_t material_id(Material* material);
+		void update_bounds(uint32_t index);
+		void remove_at(uint32_t index);
+		void mark_dirty(uint32_t index);
+
+		std::vector<glm::mat4> _transforms;
+		SphereArrays _bounds;
+		std::vector<uint32_t> _meshIds;
+		std::vector<uint32_t> _materialIds;
+		std::vector<uint32_t> _flags;
+		//dense index to the slot its handle points at, moved along with the object
+		std::vector<uint32_t> _slotOf;
+		//set while an index is in the dirty list, the list may also hold indices a removal left behind
+		std::vector<uint8_t> _dirty;
+		std::vector<uint32_t> _dirtyList;
+
+		std::vector<Slot> _slots;
+		std::vector<uint32_t> _freeSlots;
+
+		std::vector<Mesh*> _meshTable;
+		std::unordered_map<const Mesh*, uint32_t> _meshIdOf;
+		std::vector<Material*> _materialTable;
+		std::unordered_map<const Material*, uint32_t> _materialIdOf;
+	};
+}
@@ -0,0 +1,165 @@
+#include "vk_retire.h"
+
+#include <utility>
+
+namespace vkn
+{
+	void RetireQueue::init(VkDevice newDevice, VmaAllocator newAllocator)
+	{
+		_device = newDevice;
+		_allocator = newAllocator;
+	}
+
+	void RetireQueue::cleanup()
+	{
+		release(UINT64_MAX);
+		_spare.clear();
+	}
+
+	void RetireQueue::retire_buffer(uint64_t value, const AllocatedBuffer& buffer)
+	{
+		Record record;
+		record.type = Type::Buffer;
+		record.buffer = buffer._buffer;
+		record.allocation = buffer._allocation;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_image(uint64_t value, const AllocatedImage& image)
+	{
+		Record record;
+		record.type = Type::Image;
+		record.image = image._image;
+		record.allocation = image._allocation;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_image_view(uint64_t value, VkImageView view)
+	{
+		Record record;
+		record.type = Type::ImageView;
+		record.imageView = view;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_sampler(uint64_t value, VkSampler sampler)
+	{
+		Record record;
+		record.type = Type::Sampler;
+		record.sampler = sampler;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_pipeline(uint64_t value, VkPipeline pipeline)
+	{
+		Record record;
+		record.type = Type::Pipeline;
+		record.pipeline = pipeline;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_pipeline_layout(uint64_t value, VkPipelineLayout layout)
+	{
+		Record record;
+		record.type = Type::PipelineLayout;
+		record.pipelineLayout = layout;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_descriptor_pool(uint64_t value, VkDescriptorPool pool)
+	{
+		Record record;
+		record.type = Type::DescriptorPool;
+		record.descriptorPool = pool;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	void RetireQueue::retire_geometry(uint64_t value, GeometryBuffer& geometry, const GeometryAllocation& allocation)
+	{
+		Record record;
+		record.type = Type::Geometry;
+		record.geometry.buffer = &geometry;
+		record.geometry.allocation = allocation;
+		record.allocation = VK_NULL_HANDLE;
+		push(value, record);
+	}
+
+	size_t RetireQueue::release(uint64_t completedValue)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		size_t released = 0;
+		while (!_buckets.empty() && _buckets.front().value <= completedValue)
+		{
+			Bucket& bucket = _buckets.front();
+			for (const Record& record : bucket.records)
+				destroy(record);
+			released += bucket.records.size();
+
+			bucket.records.clear();
+			_spare.push_back(std::move(bucket.records));
+			_buckets.pop_front();
+		}
+		_pending -= released;
+		return released;
+	}
+
+	size_t RetireQueue::pending() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _pending;
+	}
+
+	void RetireQueue::push(uint64_t value, const Record& record)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_buckets.empty() || _buckets.back().value < value)
+		{
+			Bucket bucket;
+			bucket.value = value;
+			if (!_spare.empty())
+			{
+				bucket.records = std::move(_spare.back());
+				_spare.pop_back();
+			}
+			_buckets.push_back(std::move(bucket));
+		}
+		_buckets.back().records.push_back(record);
+		_pending++;
+	}
+
+	void RetireQueue::destroy(const Record& record)
+	{
+		switch (record.type)
+		{
+		case Type::Buffer:
+			vmaDestroyBuffer(_allocator, record.buffer, record.allocation);
+			break;
+		case Type::Image:
+			vmaDestroyImage(_allocator, record.image, record.allocation);
+			break;
+		case Type::ImageView:
+			vkDestroyImageView(_device, record.imageView, nullptr);
+			break;
+		case Type::Sampler:
+			vkDestroySampler(_device, record.sampler, nullptr);
+			break;
+		case Type::Pipeline:
+			vkDestroyPipeline(_device, record.pipeline, nullptr);
+			break;
+		case Type::PipelineLayout:
+			vkDestroyPipelineLayout(_device, record.pipelineLayout, nullptr);
+			break;
+		case Type::DescriptorPool:
+			vkDestroyDescriptorPool(_device, record.descriptorPool, nullptr);
+			break;
+		case Type::Geometry:
+			record.geometry.buffer->free(record.geometry.allocation);
+			break;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "vk_types.h"
+#include "vk_geometry_buffer.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace vkn
+{
+	//handles and geometry ranges the gpu may still be using, released in bulk once a timeline reaches the value they
+	//were retired with
+	//records are plain handles kept in per value buckets whose storage is reused, so retiring allocates nothing once
+	//the buckets have grown, and any thread may retire
+	class RetireQueue
+	{
+	public:
+		void init(VkDevice newDevice, VmaAllocator newAllocator);
+		//destroys everything still queued, only once the device is idle
+		void cleanup();
+
+		void retire_buffer(uint64_t value, const AllocatedBuffer& buffer);
+		void retire_image(uint64_t value, const AllocatedImage& image);
+		void retire_image_view(uint64_t value, VkImageView view);
+		void retire_sampler(uint64_t value, VkSampler sampler);
+		void retire_pipeline(uint64_t value, VkPipeline pipeline);
+		void retire_pipeline_layout(uint64_t value, VkPipelineLayout layout);
+		void retire_descriptor_pool(uint64_t value, VkDescriptorPool pool);
+		//the ranges go back to geometry on the thread that calls release, the one that allocates from it
+		void retire_geometry(uint64_t value, GeometryBuffer& geometry, const GeometryAllocation& allocation);
+
+		//destroys every bucket up to and including completedValue, returns how many handles went
+		size_t release(uint64_t completedValue);
+		size_t pending() const;
+
+	private:
+		enum class Type : uint8_t
+		{
+			Buffer,
+			Image,
+			ImageView,
+			Sampler,
+			Pipeline,
+			PipelineLayout,
+			DescriptorPool,
+			Geometry,
+		};
+
+		struct GeometryRange
+		{
+			GeometryBuffer* buffer;
+			GeometryAllocation allocation;
+		};
+
+		struct Record
+		{
+			Type type;
+			union
+			{
+				VkBuffer buffer;
+				VkImage image;
+				VkImageView imageView;
+				VkSampler sampler;
+				VkPipeline pipeline;
+				VkPipelineLayout pipelineLayout;
+				VkDescriptorPool descriptorPool;
+				GeometryRange geometry;
+			};
+			VmaAllocation allocation; //buffers and images only
+		};
+
+		struct Bucket
+		{
+			uint64_t value;
+			std::vector<Record> records;
+		};
+
+		void push(uint64_t value, const Record& record);
+		void destroy(const Record& record);
+
+		VkDevice _device;
+		VmaAllocator _allocator;
+		mutable std::mutex _mutex;
+		//in value order, a value lower than the newest bucket's joins that bucket and only goes a little later
+		std::deque<Bucket> _buckets;
+		//record storage of released buckets, reused by the next ones
+		std::vector<std::vector<Record>> _spare;
+		size_t _pending{ 0 };
+	};
+}
@@ -0,0 +1,58 @@
+#include "vk_sort.h"
+
+#include <algorithm>
+
+namespace vkn
+{
+	uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		constexpr uint64_t depthMax = (1ull << DRAW_KEY_DEPTH_BITS) - 1;
+		const uint64_t quantizedDepth = static_cast<uint64_t>(std::min(std::max(depth, 0.f), 1.f) * depthMax);
+
+		uint64_t key = pass & ((1u << DRAW_KEY_PASS_BITS) - 1);
+		key = (key << DRAW_KEY_PIPELINE_BITS) | (pipeline & ((1u << DRAW_KEY_PIPELINE_BITS) - 1));
+		key = (key << DRAW_KEY_MATERIAL_BITS) | (material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1));
+		key = (key << DRAW_KEY_MESH_BITS) | (mesh & ((1u << DRAW_KEY_MESH_BITS) - 1));
+		return (key << DRAW_KEY_DEPTH_BITS) | quantizedDepth;
+	}
+
+	void radix_sort(std::vector<KeyedIndex>& items, std::vector<KeyedIndex>& scratch)
+	{
+		const size_t count = items.size();
+		if (count < 2)
+			return;
+		scratch.resize(count);
+
+		//every byte's histogram in one read of the keys
+		uint32_t histograms[8][256] = {};
+		for (const KeyedIndex& item : items)
+		{
+			for (int pass = 0; pass < 8; pass++)
+				histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+		}
+
+		KeyedIndex* source = items.data();
+		KeyedIndex* destination = scratch.data();
+		for (int pass = 0; pass < 8; pass++)
+		{
+			uint32_t* histogram = histograms[pass];
+			const uint32_t shift = pass * 8;
+			if (histogram[(source[0].key >> shift) & 0xff] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (int digit = 0; digit < 256; digit++)
+			{
+				const uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			for (size_t i = 0; i < count; i++)
+				destination[histogram[(source[i].key >> shift) & 0xff]++] = source[i];
+			std::swap(source, destination);
+		}
+
+		if (source != items.data())
+			items.swap(scratch);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace vkn
+{
+	//widths of the draw key fields, most significant first, together 64 bits
+	constexpr uint32_t DRAW_KEY_PASS_BITS = 4;
+	constexpr uint32_t DRAW_KEY_PIPELINE_BITS = 10;
+	constexpr uint32_t DRAW_KEY_MATERIAL_BITS = 14;
+	constexpr uint32_t DRAW_KEY_MESH_BITS = 16;
+	constexpr uint32_t DRAW_KEY_DEPTH_BITS = 20;
+
+	//draws sorted by this key change the pipeline least often, then the descriptor sets, then the mesh, and draw front to
+	//back within a mesh, fields wider than their bits wrap, which only costs binds and never correctness
+	//depth is 0 at the camera and 1 at the far plane
+	uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	struct KeyedIndex
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	//stable lsd radix sort by key, a byte per pass, skipping the passes where every key has the same byte
+	//scratch is only working memory, both vectors keep their capacity between calls
+	void radix_sort(std::vector<KeyedIndex>& items, std::vector<KeyedIndex>& scratch);
+}
@@ -1,85 +1,98 @@
 #include "vk_textures.h"
 #include "vk_initializers.h"
+#include "vk_asset.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <algorithm>
 #include <iostream>
+#include <string>
 
-bool vkn::load_image_from_file(Vulkaneer& engine, const char* file, AllocatedImage& outImage)
+bool vkn::load_image_from_file(Vulkaneer& engine, const char* file, AllocatedImage& outImage, VkFormat& outFormat)
 {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (!pixels)
+	//a .vktex next to the source holds the mip chain already block compressed, so it goes straight to the gpu
+	std::string cookedPath = file;
+	cookedPath = cookedPath.substr(0, cookedPath.find_last_of('.')) + ".vktex";
+	MappedFile cooked;
+	if (cooked.open(cookedPath.c_str()))
+	{
+		TextureFileHeader header;
+		const uint8_t* data;
+		if (read_texture_file(cooked, header, data))
+		{
+			upload_image(engine, header.format, header.width, header.height, header.mipLevels, data, outImage);
+			outFormat = texture_vk_format(header.format);
+			std::cout << "Texture loaded succesfully " << cookedPath << " (cooked)" << std::endl;
+			return true;
+		}
+		std::cout << "Ignoring invalid cooked texture " << cookedPath << std::endl;
+	}
+
+	ImageData image;
+	if (!load_image(file, image))
 	{
 		std::cout << "Failed to load texture file " << file << std::endl;
 		return false;
 	}
 
-	void* pixel_ptr = pixels;
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-	VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
+	if (GENERATE_TEXTURE_MIPS)
+		generate_mips(image);
+	upload_image(engine, image, outImage);
+	outFormat = texture_vk_format(image.format);
+	std::cout << "Texture loaded succesfully " << file << std::endl;
+	return true;
+}
+
+VkFormat vkn::texture_vk_format(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::Bc1:
+		return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	case TextureFormat::Bc3:
+		return VK_FORMAT_BC3_SRGB_BLOCK;
+	case TextureFormat::Bc7:
+		return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	}
+}
+
+void vkn::upload_image(Vulkaneer& engine, const ImageData& image, AllocatedImage& outImage)
+{
+	upload_image(engine, image.format, image.width, image.height, image.mipLevels, image.pixels.data(), outImage);
+}
 
-	AllocatedBuffer stagingBuffer = engine.create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-	void* data;
-	vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
-	memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-	vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
-	
-	stbi_image_free(pixels);
+void vkn::upload_image(Vulkaneer& engine, TextureFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const uint8_t* pixels, AllocatedImage& outImage)
+{
+	VkDeviceSize imageSize = mip_level_offset(format, width, height, mipLevels);
+	VkFormat image_format = texture_vk_format(format);
 
 	VkExtent3D imageExtent;
-	imageExtent.width = static_cast<uint32_t>(texWidth);
-	imageExtent.height = static_cast<uint32_t>(texHeight);
+	imageExtent.width = width;
+	imageExtent.height = height;
 	imageExtent.depth = 1;
 
 	AllocatedImage newImage;
-	VkImageCreateInfo dimg_info = vkn::image_create_info(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+	VkImageCreateInfo dimg_info = vkn::image_create_info(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, mipLevels);
 	VmaAllocationCreateInfo dimg_allocinfo = {};
 	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 	vmaCreateImage(engine._allocator, &dimg_info, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
 
-	engine.immediate_submit([&](VkCommandBuffer cmd)
+	//the whole chain goes out as one upload, one region per level
+	std::vector<VkBufferImageCopy> copyRegions(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; level++)
 	{
-		VkImageMemoryBarrier imageBarrier_toTransfer = {};
-		imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toTransfer.image = newImage._image;
-		imageBarrier_toTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageBarrier_toTransfer.subresourceRange.baseMipLevel = 0;
-		imageBarrier_toTransfer.subresourceRange.levelCount = 1;
-		imageBarrier_toTransfer.subresourceRange.baseArrayLayer = 0;
-		imageBarrier_toTransfer.subresourceRange.layerCount = 1;
-		imageBarrier_toTransfer.srcAccessMask = 0;
-		imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
-
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset = 0;
+		VkBufferImageCopy& copyRegion = copyRegions[level];
+		copyRegion = {};
+		copyRegion.bufferOffset = mip_level_offset(format, width, height, level);
 		copyRegion.bufferRowLength = 0;
 		copyRegion.bufferImageHeight = 0;
 		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageSubresource.mipLevel = level;
 		copyRegion.imageSubresource.baseArrayLayer = 0;
 		copyRegion.imageSubresource.layerCount = 1;
-		copyRegion.imageExtent = imageExtent;
-		vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, newImage._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-		VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-		imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
-	});
-
-	engine._mainDeletionQueue.push_function([=]()
-	{
-		vmaDestroyImage(engine._allocator, newImage._image, newImage._allocation);
-	});
-	vmaDestroyBuffer(engine._allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+		copyRegion.imageExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+	}
+	engine._uploader.upload_image(newImage._image, mipLevels, pixels, imageSize, std::move(copyRegions));
 
-	std::cout << "Texture loaded succesfully " << file << std::endl;
 	outImage = newImage;
-	return true;
 }
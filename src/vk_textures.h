@@ -1,8 +1,15 @@
 #pragma once
 #include "vk_types.h"
 #include "vulkaneer.h"
+#include "vk_image.h"
 
 namespace vkn
 {
-	bool load_image_from_file(Vulkaneer& engine, const char* file, AllocatedImage& outImage);
+	//prefers the cooked .vktex next to the file, outFormat is what the image views of the result have to use
+	bool load_image_from_file(Vulkaneer& engine, const char* file, AllocatedImage& outImage, VkFormat& outFormat);
+	//creates a sampled srgb image from decoded or block compressed pixels and every mip level they carry, the caller owns it
+	void upload_image(Vulkaneer& engine, const ImageData& image, AllocatedImage& outImage);
+	//same for a mip chain the caller keeps, like a mapped .vktex
+	void upload_image(Vulkaneer& engine, TextureFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const uint8_t* pixels, AllocatedImage& outImage);
+	VkFormat texture_vk_format(TextureFormat format);
 }
@@ -0,0 +1,90 @@
+#include "vk_timeline.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vkn
+{
+	void Timeline::init(VkDevice newDevice)
+	{
+		_device = newDevice;
+		_submitted = 0;
+		_completed = 0;
+
+		VkSemaphoreTypeCreateInfo typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		info.pNext = &typeInfo;
+		vkCreateSemaphore(_device, &info, nullptr, &_semaphore);
+	}
+
+	void Timeline::cleanup()
+	{
+		vkDestroySemaphore(_device, _semaphore, nullptr);
+		_semaphore = VK_NULL_HANDLE;
+	}
+
+	VkResult Timeline::submit(VkQueue queue, const VkSubmitInfo& submit, uint64_t& outValue, const uint64_t* waitValues)
+	{
+		//the queue wants a value for every semaphore, binary ones ignore theirs
+		constexpr uint32_t MAX_SEMAPHORES = 8;
+		assert(submit.waitSemaphoreCount <= MAX_SEMAPHORES && submit.signalSemaphoreCount < MAX_SEMAPHORES);
+		uint64_t semaphoreWaitValues[MAX_SEMAPHORES] = {};
+		if (waitValues)
+			std::copy(waitValues, waitValues + submit.waitSemaphoreCount, semaphoreWaitValues);
+		uint64_t signalValues[MAX_SEMAPHORES] = {};
+		VkSemaphore signalSemaphores[MAX_SEMAPHORES];
+		std::copy(submit.pSignalSemaphores, submit.pSignalSemaphores + submit.signalSemaphoreCount, signalSemaphores);
+
+		const uint64_t value = _submitted + 1;
+		signalSemaphores[submit.signalSemaphoreCount] = _semaphore;
+		signalValues[submit.signalSemaphoreCount] = value;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = submit.waitSemaphoreCount;
+		timelineInfo.pWaitSemaphoreValues = semaphoreWaitValues;
+		timelineInfo.signalSemaphoreValueCount = submit.signalSemaphoreCount + 1;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo timelineSubmit = submit;
+		timelineSubmit.pNext = &timelineInfo;
+		timelineSubmit.signalSemaphoreCount = submit.signalSemaphoreCount + 1;
+		timelineSubmit.pSignalSemaphores = signalSemaphores;
+		const VkResult result = vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE);
+		if (result == VK_SUCCESS)
+		{
+			_submitted = value;
+			outValue = value;
+		}
+		return result;
+	}
+
+	uint64_t Timeline::completed()
+	{
+		uint64_t value = 0;
+		vkGetSemaphoreCounterValue(_device, _semaphore, &value);
+		_completed = std::max(_completed, value);
+		return _completed;
+	}
+
+	VkResult Timeline::wait(uint64_t value, uint64_t timeout)
+	{
+		if (value <= _completed)
+			return VK_SUCCESS;
+
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &_semaphore;
+		waitInfo.pValues = &value;
+		const VkResult result = vkWaitSemaphores(_device, &waitInfo, timeout);
+		if (result == VK_SUCCESS)
+			_completed = std::max(_completed, value);
+		return result;
+	}
+}
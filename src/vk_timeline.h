@@ -0,0 +1,39 @@
+#pragma once
+#include "vk_types.h"
+
+#include <cstdint>
+
+namespace vkn
+{
+	//a timeline semaphore for the work of one queue, every submission signals the next value and the host can wait
+	//for any value handed out so far, values have to be signaled in submission order so a timeline belongs to one queue
+	class Timeline
+	{
+	public:
+		void init(VkDevice newDevice);
+		void cleanup();
+
+		//submits to the timeline's queue, signaling the next value after whatever binary semaphores submit signals
+		//outValue is only handed out when the submit went through, waitValues holds one value per wait semaphore when
+		//any of them is a timeline, binary ones ignore theirs
+		VkResult submit(VkQueue queue, const VkSubmitInfo& submit, uint64_t& outValue, const uint64_t* waitValues = nullptr);
+		//the value of the last submission, 0 before the first
+		uint64_t submitted() const { return _submitted; }
+		//the value the next submission will signal, anything recorded before it has finished once this is reached
+		uint64_t next() const { return _submitted + 1; }
+
+		//asks the gpu how far it got
+		uint64_t completed();
+		//only asks the gpu when the last answer was not far enough yet
+		bool reached(uint64_t value) { return value <= _completed || value <= completed(); }
+		VkResult wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+		VkSemaphore semaphore() const { return _semaphore; }
+
+	private:
+		VkDevice _device;
+		VkSemaphore _semaphore{ VK_NULL_HANDLE };
+		uint64_t _submitted{ 0 };
+		uint64_t _completed{ 0 };
+	};
+}
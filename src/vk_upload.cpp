@@ -0,0 +1,444 @@
+#include "vk_upload.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+	//buffer to image copies want offsets aligned to the texel block size, 16 covers every format the engine uploads
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+namespace vkn
+{
+	void UploadManager::init(VkDevice newDevice, VmaAllocator newAllocator, VkQueue transferQueue, uint32_t transferQueueFamily,
+		VkQueue graphicsQueue, uint32_t graphicsQueueFamily, Timeline* graphicsTimeline, VkDeviceSize ringSize)
+	{
+		_device = newDevice;
+		_allocator = newAllocator;
+		_queue = transferQueue;
+		_queueFamily = transferQueueFamily;
+		_graphicsQueue = graphicsQueue;
+		_graphicsQueueFamily = graphicsQueueFamily;
+		_graphicsTimeline = graphicsTimeline;
+		_ownershipTransfer = transferQueueFamily != graphicsQueueFamily;
+		_ringSize = ringSize;
+
+		VkCommandPoolCreateInfo poolInfo = vkn::command_pool_create_info(transferQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool);
+		if (_ownershipTransfer)
+		{
+			VkCommandPoolCreateInfo acquirePoolInfo = vkn::command_pool_create_info(graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			vkCreateCommandPool(_device, &acquirePoolInfo, nullptr, &_acquirePool);
+			_transferTimeline.init(_device);
+		}
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = ringSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		VmaAllocationInfo mapped;
+		vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_ring._buffer, &_ring._allocation, &mapped);
+		_ringData = static_cast<uint8_t*>(mapped.pMappedData);
+	}
+
+	void UploadManager::cleanup()
+	{
+		while (!_inFlight.empty())
+			retire_oldest(true);
+
+		_freeBatches.clear();
+		for (Request& request : _pending)
+		{
+			if (request.dedicatedStaging._buffer != VK_NULL_HANDLE)
+				vmaDestroyBuffer(_allocator, request.dedicatedStaging._buffer, request.dedicatedStaging._allocation);
+		}
+		_pending.clear();
+		_unstaged = 0;
+
+		vkDestroyCommandPool(_device, _commandPool, nullptr);
+		if (_acquirePool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(_device, _acquirePool, nullptr);
+			_transferTimeline.cleanup();
+		}
+		vmaDestroyBuffer(_allocator, _ring._buffer, _ring._allocation);
+	}
+
+	UploadTicket UploadManager::upload_buffers(std::vector<uint8_t>&& data, const std::vector<BufferUpload>& copies, bool concurrent)
+	{
+		Request request = {};
+		request.size = data.size();
+		request.data = std::move(data);
+		request.bufferCopies = copies;
+		request.concurrent = concurrent;
+		return enqueue(std::move(request), nullptr);
+	}
+
+	UploadTicket UploadManager::upload_buffer(VkBuffer buffer, std::vector<uint8_t>&& data, bool concurrent)
+	{
+		const VkDeviceSize size = data.size();
+		return upload_buffers(std::move(data), { { buffer, 0, 0, size } }, concurrent);
+	}
+
+	UploadTicket UploadManager::upload_buffers(const void* data, VkDeviceSize size, const std::vector<BufferUpload>& copies, bool concurrent)
+	{
+		Request request = {};
+		request.size = size;
+		request.bufferCopies = copies;
+		request.concurrent = concurrent;
+		return enqueue(std::move(request), data);
+	}
+
+	UploadTicket UploadManager::upload_buffer(VkBuffer buffer, const void* data, VkDeviceSize size, bool concurrent)
+	{
+		return upload_buffers(data, size, { { buffer, 0, 0, size } }, concurrent);
+	}
+
+	UploadTicket UploadManager::upload_image(VkImage image, uint32_t mipLevels, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy>&& regions)
+	{
+		Request request = {};
+		request.size = size;
+		request.image = image;
+		request.mipLevels = mipLevels;
+		request.imageRegions = std::move(regions);
+		return enqueue(std::move(request), data);
+	}
+
+	UploadTicket UploadManager::enqueue(Request&& request, const void* data)
+	{
+		//the ring is freed oldest first, so a request only takes ring space ahead of flush while every earlier one has
+		//its space already, a staging buffer of its own can be made any time
+		if (data)
+		{
+			const bool inOrder = request.size > _ringSize || _unstaged == 0;
+			if (!inOrder || !stage(request, data))
+				request.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + request.size);
+		}
+		if (!request.staged)
+			_unstaged++;
+
+		request.ticket = _nextTicket++;
+		_pending.push_back(std::move(request));
+		return _pending.back().ticket;
+	}
+
+	bool UploadManager::stage(Request& request, const void* data)
+	{
+		if (request.size > _ringSize)
+		{
+			//too big for the ring, gets a staging buffer of its own that lives as long as the batch
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = request.size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			VmaAllocationCreateInfo allocInfo = {};
+			allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+			allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			VmaAllocationInfo mapped;
+			vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &request.dedicatedStaging._buffer, &request.dedicatedStaging._allocation, &mapped);
+			memcpy(mapped.pMappedData, data, request.size);
+			request.staging = request.dedicatedStaging._buffer;
+			request.stagingOffset = 0;
+			request.ringBytes = 0;
+		}
+		else
+		{
+			VkDeviceSize offset;
+			VkDeviceSize consumed;
+			if (!ring_allocate(request.size, offset, consumed))
+				return false;
+			memcpy(_ringData + offset, data, request.size);
+			request.staging = _ring._buffer;
+			request.stagingOffset = offset;
+			request.ringBytes = consumed;
+		}
+		request.staged = true;
+		return true;
+	}
+
+	void UploadManager::flush(VkDeviceSize byteBudget)
+	{
+		while (!_inFlight.empty() && retire_oldest(false))
+		{
+		}
+		if (_pending.empty())
+			return;
+
+		Batch batch = acquire_batch();
+		VkDeviceSize recordedBytes = 0;
+		while (!_pending.empty())
+		{
+			Request& request = _pending.front();
+			const VkDeviceSize size = request.size;
+			if (recordedBytes > 0 && recordedBytes + size > byteBudget)
+				break;
+
+			if (!request.staged)
+			{
+				//the ring is full of batches the gpu has not finished, the rest waits for the next flush
+				if (!stage(request, request.data.data()))
+					break;
+				_unstaged--;
+			}
+			batch.ringBytes += request.ringBytes;
+			if (request.dedicatedStaging._buffer != VK_NULL_HANDLE)
+				batch.dedicatedStaging.push_back(request.dedicatedStaging);
+
+			record(batch, request, request.staging, request.stagingOffset);
+			recordedBytes += size;
+			batch.lastTicket = request.ticket;
+			_pending.pop_front();
+		}
+
+		if (batch.lastTicket == 0)
+		{
+			_freeBatches.push_back(std::move(batch));
+			return;
+		}
+		_uploadedBytes += recordedBytes;
+		submit(std::move(batch));
+	}
+
+	void UploadManager::wait(UploadTicket ticket)
+	{
+		while (!is_complete(ticket))
+		{
+			if (!_pending.empty() && _pending.front().ticket <= ticket)
+			{
+				const uint32_t submitted = _submittedBatches;
+				flush(UINT64_MAX);
+				if (_submittedBatches != submitted)
+					continue;
+			}
+
+			//either everything up to the ticket is submitted or the ring is full, both need the oldest batch done
+			retire_oldest(true);
+		}
+	}
+
+	UploadStats UploadManager::stats() const
+	{
+		UploadStats stats;
+		stats.bytes = _uploadedBytes;
+		stats.batches = _submittedBatches;
+		stats.pending = static_cast<uint32_t>(_pending.size());
+		stats.inFlight = static_cast<uint32_t>(_inFlight.size());
+		return stats;
+	}
+
+	bool UploadManager::ring_allocate(VkDeviceSize size, VkDeviceSize& outOffset, VkDeviceSize& outConsumed)
+	{
+		if (_ringUsed == 0)
+			_ringHead = 0;
+
+		VkDeviceSize offset = align_up(_ringHead, STAGING_ALIGNMENT);
+		if (offset + size > _ringSize)
+			offset = 0;
+
+		//what gets skipped to reach the offset, alignment padding or the whole end of the ring on a wrap
+		const VkDeviceSize skipped = offset >= _ringHead ? offset - _ringHead : _ringSize - _ringHead;
+		if (_ringUsed + skipped + size > _ringSize)
+			return false;
+
+		outOffset = offset;
+		outConsumed = skipped + size;
+		_ringUsed += outConsumed;
+		_ringHead = offset + size;
+		return true;
+	}
+
+	void UploadManager::record(Batch& batch, const Request& request, VkBuffer staging, VkDeviceSize stagingOffset)
+	{
+		for (const BufferUpload& copy : request.bufferCopies)
+		{
+			VkBufferCopy region;
+			region.srcOffset = stagingOffset + copy.srcOffset;
+			region.dstOffset = copy.dstOffset;
+			region.size = copy.size;
+			vkCmdCopyBuffer(batch.cmd, staging, copy.buffer, 1, &region);
+
+			if (_ownershipTransfer && !request.concurrent)
+			{
+				VkBufferMemoryBarrier ownership = {};
+				ownership.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				ownership.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				ownership.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+				ownership.srcQueueFamilyIndex = _queueFamily;
+				ownership.dstQueueFamilyIndex = _graphicsQueueFamily;
+				ownership.buffer = copy.buffer;
+				ownership.offset = copy.dstOffset;
+				ownership.size = copy.size;
+				batch.bufferOwnership.push_back(ownership);
+			}
+		}
+
+		if (request.image == VK_NULL_HANDLE)
+			return;
+
+		VkImageMemoryBarrier toTransfer = vkn::image_barrier(request.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		toTransfer.subresourceRange.levelCount = request.mipLevels;
+		vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+		std::vector<VkBufferImageCopy> regions = request.imageRegions;
+		for (VkBufferImageCopy& region : regions)
+			region.bufferOffset += stagingOffset;
+		vkCmdCopyBufferToImage(batch.cmd, staging, request.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		VkImageMemoryBarrier toReadable = toTransfer;
+		toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		if (_ownershipTransfer)
+		{
+			//the layout change happens as part of the release and acquire pair
+			toReadable.srcQueueFamilyIndex = _queueFamily;
+			toReadable.dstQueueFamilyIndex = _graphicsQueueFamily;
+			batch.imageOwnership.push_back(toReadable);
+			return;
+		}
+		vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toReadable);
+	}
+
+	UploadManager::Batch UploadManager::acquire_batch()
+	{
+		Batch batch;
+		if (!_freeBatches.empty())
+		{
+			batch = std::move(_freeBatches.back());
+			_freeBatches.pop_back();
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo cmdAllocInfo = vkn::command_buffer_allocate_info(_commandPool, 1);
+			vkAllocateCommandBuffers(_device, &cmdAllocInfo, &batch.cmd);
+			batch.acquireCmd = VK_NULL_HANDLE;
+			if (_ownershipTransfer)
+			{
+				VkCommandBufferAllocateInfo acquireAllocInfo = vkn::command_buffer_allocate_info(_acquirePool, 1);
+				vkAllocateCommandBuffers(_device, &acquireAllocInfo, &batch.acquireCmd);
+			}
+		}
+		batch.acquiring = false;
+		batch.value = 0;
+		batch.ringBytes = 0;
+		batch.lastTicket = 0;
+		batch.bufferOwnership.clear();
+		batch.imageOwnership.clear();
+
+		VkCommandBufferBeginInfo beginInfo = vkn::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		vkResetCommandBuffer(batch.cmd, 0);
+		vkBeginCommandBuffer(batch.cmd, &beginInfo);
+		return batch;
+	}
+
+	void UploadManager::submit(Batch&& batch)
+	{
+		if (_ownershipTransfer)
+		{
+			vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+				static_cast<uint32_t>(batch.bufferOwnership.size()), batch.bufferOwnership.data(),
+				static_cast<uint32_t>(batch.imageOwnership.size()), batch.imageOwnership.data());
+			vkEndCommandBuffer(batch.cmd);
+
+			VkSubmitInfo submitInfo = vkn::submit_info(&batch.cmd);
+			_transferTimeline.submit(_queue, submitInfo, batch.value);
+			_submittedBatches++;
+			_inFlight.push_back(std::move(batch));
+			return;
+		}
+
+		//buffer copies become visible to everything that reads meshes and other gpu data
+		VkMemoryBarrier visible = {};
+		visible.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		visible.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		visible.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &visible, 0, nullptr, 0, nullptr);
+		vkEndCommandBuffer(batch.cmd);
+
+		VkSubmitInfo submitInfo = vkn::submit_info(&batch.cmd);
+		_graphicsTimeline->submit(_queue, submitInfo, batch.value);
+		_submittedBatches++;
+		_inFlight.push_back(std::move(batch));
+	}
+
+	bool UploadManager::retire_oldest(bool block)
+	{
+		Batch& batch = _inFlight.front();
+		Timeline& timeline = batch.acquiring ? *_graphicsTimeline : copy_timeline();
+		if (block)
+			timeline.wait(batch.value);
+		else if (!timeline.reached(batch.value))
+			return false;
+
+		if (!batch.acquiring)
+		{
+			for (AllocatedBuffer& dedicated : batch.dedicatedStaging)
+				vmaDestroyBuffer(_allocator, dedicated._buffer, dedicated._allocation);
+			batch.dedicatedStaging.clear();
+
+			//batches finish in submission order, so what they held is always the oldest part of the ring
+			_ringUsed -= batch.ringBytes;
+			batch.ringBytes = 0;
+
+			if (_ownershipTransfer)
+			{
+				submit_acquire(batch);
+				return true;
+			}
+		}
+
+		_completedTicket = std::max(_completedTicket, batch.lastTicket);
+		_freeBatches.push_back(std::move(batch));
+		_inFlight.pop_front();
+		return true;
+	}
+
+	void UploadManager::submit_acquire(Batch& batch)
+	{
+		const VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		const bool ownership = !batch.bufferOwnership.empty() || !batch.imageOwnership.empty();
+		if (ownership)
+		{
+			VkCommandBufferBeginInfo beginInfo = vkn::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+			vkResetCommandBuffer(batch.acquireCmd, 0);
+			vkBeginCommandBuffer(batch.acquireCmd, &beginInfo);
+			vkCmdPipelineBarrier(batch.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, readStages, 0, 0, nullptr,
+				static_cast<uint32_t>(batch.bufferOwnership.size()), batch.bufferOwnership.data(),
+				static_cast<uint32_t>(batch.imageOwnership.size()), batch.imageOwnership.data());
+			vkEndCommandBuffer(batch.acquireCmd);
+		}
+
+		//the wait is what makes the copies into concurrent buffers visible to graphics, the copies already finished on
+		//the host's watch, so it is satisfied right away and never holds up the frames submitted after it
+		VkSemaphore copies = _transferTimeline.semaphore();
+		const uint64_t copiesValue = batch.value;
+		VkSubmitInfo submitInfo = vkn::submit_info(&batch.acquireCmd);
+		submitInfo.commandBufferCount = ownership ? 1 : 0;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &copies;
+		submitInfo.pWaitDstStageMask = &readStages;
+		_graphicsTimeline->submit(_graphicsQueue, submitInfo, batch.value, &copiesValue);
+		batch.acquiring = true;
+
+		//graphics work submitted from here on is ordered after the acquire, its value only tells when the batch can be reused
+		_completedTicket = batch.lastTicket;
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "vk_types.h"
+#include "vk_timeline.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace vkn
+{
+	//handed out in queue order, an upload is complete once every ticket up to and including its own is
+	using UploadTicket = uint64_t;
+
+	//a range of an upload's data that goes into a buffer
+	struct BufferUpload
+	{
+		VkBuffer buffer;
+		VkDeviceSize dstOffset;
+		VkDeviceSize srcOffset;
+		VkDeviceSize size;
+	};
+
+	struct UploadStats
+	{
+		uint64_t bytes; //copied through staging since init
+		uint32_t batches; //submissions since init
+		uint32_t pending; //uploads queued but not recorded yet
+		uint32_t inFlight; //batches submitted but not finished
+	};
+
+	//streams data to device local buffers and images through a persistently mapped staging ring
+	//uploads are queued, recorded into shared command buffers up to a byte budget and submitted as one batch, and
+	//each batch frees its part of the ring once the timeline it signaled reached its value
+	//copies run on the transfer queue, when that belongs to another family than graphics each batch ends by releasing
+	//its exclusive buffers and images, and once it finished a small batch on the graphics queue waits for the copies
+	//and acquires them, buffers shared concurrently with graphics only need the wait
+	//either way an upload is complete once graphics work submitted from then on can read it, vertex input, shaders
+	//and compute included
+	class UploadManager
+	{
+	public:
+		//pass the graphics queue as the transfer queue too when the device has no separate one, work on the graphics
+		//queue signals graphicsTimeline, which has to outlive the manager, a transfer queue of its own gets its own
+		void init(VkDevice newDevice, VmaAllocator newAllocator, VkQueue transferQueue, uint32_t transferQueueFamily,
+			VkQueue graphicsQueue, uint32_t graphicsQueueFamily, Timeline* graphicsTimeline, VkDeviceSize ringSize);
+		void cleanup();
+
+		//queues copies of data into one or more buffers, srcOffset of each copy is relative to the data
+		//concurrent buffers are shared by the transfer and graphics families whenever those differ, they skip the
+		//ownership transfer
+		UploadTicket upload_buffers(std::vector<uint8_t>&& data, const std::vector<BufferUpload>& copies, bool concurrent = false);
+		UploadTicket upload_buffer(VkBuffer buffer, std::vector<uint8_t>&& data, bool concurrent = false);
+		//same for data the caller keeps, like a mapped file, it is done with the data on return
+		//it goes straight into staging unless earlier uploads still wait for ring space, then it is copied once more
+		UploadTicket upload_buffers(const void* data, VkDeviceSize size, const std::vector<BufferUpload>& copies, bool concurrent = false);
+		UploadTicket upload_buffer(VkBuffer buffer, const void* data, VkDeviceSize size, bool concurrent = false);
+		//queues copies into mipLevels levels of a color image, bufferOffset of each region is relative to the data
+		//the image starts out undefined and ends up shader read only, the data is taken like upload_buffers takes it
+		UploadTicket upload_image(VkImage image, uint32_t mipLevels, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy>&& regions);
+
+		//retires finished batches, then records queued uploads until byteBudget is spent and submits them
+		//the first queued upload is always recorded, so one larger than the budget still goes through
+		void flush(VkDeviceSize byteBudget);
+		//does not touch the gpu, completion only advances in flush and wait
+		bool is_complete(UploadTicket ticket) const { return ticket <= _completedTicket; }
+		//submits everything queued up to the ticket and blocks until the gpu finished it
+		void wait(UploadTicket ticket);
+		void wait_all() { wait(_nextTicket - 1); }
+		UploadTicket last_ticket() const { return _nextTicket - 1; }
+
+		UploadStats stats() const;
+
+	private:
+		struct Request
+		{
+			UploadTicket ticket;
+			VkDeviceSize size;
+			//only until the request is staged
+			std::vector<uint8_t> data;
+			std::vector<BufferUpload> bufferCopies;
+			bool concurrent;
+			VkImage image;
+			uint32_t mipLevels;
+			std::vector<VkBufferImageCopy> imageRegions;
+			//where the data sits once staged, in the ring or a staging buffer of its own
+			bool staged;
+			VkBuffer staging;
+			VkDeviceSize stagingOffset;
+			VkDeviceSize ringBytes;
+			AllocatedBuffer dedicatedStaging;
+		};
+
+		struct Batch
+		{
+			VkCommandBuffer cmd;
+			VkCommandBuffer acquireCmd; //graphics family, only with an ownership transfer
+			uint64_t value; //signaled by the copies first, then on the graphics timeline by the acquire
+			bool acquiring;
+			VkDeviceSize ringBytes; //ring space this batch holds, padding and the wasted end of a wrap included
+			UploadTicket lastTicket;
+			std::vector<AllocatedBuffer> dedicatedStaging; //for uploads that do not fit in the ring at all
+			//recorded as the release on the transfer queue and again as the acquire on the graphics queue, exclusive
+			//resources only
+			std::vector<VkBufferMemoryBarrier> bufferOwnership;
+			std::vector<VkImageMemoryBarrier> imageOwnership;
+		};
+
+		//data is copied in when the request does not hold it already
+		UploadTicket enqueue(Request&& request, const void* data);
+		//false when the ring has no room for it right now
+		bool stage(Request& request, const void* data);
+		bool ring_allocate(VkDeviceSize size, VkDeviceSize& outOffset, VkDeviceSize& outConsumed);
+		void record(Batch& batch, const Request& request, VkBuffer staging, VkDeviceSize stagingOffset);
+		Batch acquire_batch();
+		void submit(Batch&& batch);
+		//true when the oldest batch made progress, its copies finished or its acquire did, block waits for that
+		bool retire_oldest(bool block);
+		Timeline& copy_timeline() { return _ownershipTransfer ? _transferTimeline : *_graphicsTimeline; }
+		void submit_acquire(Batch& batch);
+
+		VkDevice _device;
+		VmaAllocator _allocator;
+		VkQueue _queue;
+		VkQueue _graphicsQueue;
+		uint32_t _queueFamily;
+		uint32_t _graphicsQueueFamily;
+		bool _ownershipTransfer;
+		VkCommandPool _commandPool;
+		VkCommandPool _acquirePool{ VK_NULL_HANDLE };
+		Timeline* _graphicsTimeline;
+		Timeline _transferTimeline; //only with an ownership transfer
+
+		AllocatedBuffer _ring;
+		uint8_t* _ringData;
+		VkDeviceSize _ringSize;
+		VkDeviceSize _ringHead{ 0 };
+		VkDeviceSize _ringUsed{ 0 };
+
+		std::deque<Request> _pending;
+		//pending requests not staged yet, staging at enqueue only keeps the ring in queue order while this is 0
+		uint32_t _unstaged{ 0 };
+		std::deque<Batch> _inFlight;
+		std::vector<Batch> _freeBatches;
+
+		UploadTicket _nextTicket{ 1 };
+		UploadTicket _completedTicket{ 0 };
+		uint64_t _uploadedBytes{ 0 };
+		uint32_t _submittedBatches{ 0 };
+	};
+}
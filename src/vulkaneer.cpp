@@ -2,6 +2,12 @@
 #include "vk_types.h"
 #include "vk_initializers.h"
 #include "vk_textures.h"
+#include "vk_asset.h"
+#include "vk_mesh_optimizer.h"
+#include "vk_lod.h"
+#include "vk_gltf.h"
+#include "vk_parallel.h"
+#include "vk_jobs.h"
 
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
@@ -11,7 +17,12 @@
 #include <SDL_vulkan.h>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
 
 using namespace std;
 #define VK_CHECK(x)														\
@@ -29,6 +40,9 @@ using namespace std;
 
 void Vulkaneer::init()
 {
+	//started before anything spreads work over it, the calling thread is the one worker it does not start
+	vkn::start_job_system(std::max(1u, std::thread::hardware_concurrency()) - 1, PIN_JOB_THREADS);
+
 	// initialize SDL
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
@@ -49,11 +63,27 @@ void Vulkaneer::init()
 	init_sync_structures();
 	init_descriptors();
 	init_pipelines();
+	init_gpu_culling();
+	if (_pipelineCache.warm())
+		std::cout << "Built " << _pipelinesBuilt << " pipelines in " << _pipelineBuildMs << " ms with a warm pipeline cache, "
+			<< _pipelineCache.loaded_bytes() / 1024.f << " KB loaded from " << PIPELINE_CACHE_PATH << std::endl;
+	else
+		std::cout << "Built " << _pipelinesBuilt << " pipelines in " << _pipelineBuildMs << " ms with a cold pipeline cache, "
+			<< _pipelineCache.cold_reason() << std::endl;
 
 	load_images();
 	load_meshes();
 	init_scene();
 
+	//startup assets were only queued, they go out in as few submissions as the staging ring allows
+	auto uploadStart = std::chrono::high_resolution_clock::now();
+	_uploader.wait_all();
+	auto uploadEnd = std::chrono::high_resolution_clock::now();
+	vkn::UploadStats uploadStats = _uploader.stats();
+	std::cout << "Uploaded " << _uploader.last_ticket() << " assets, " << uploadStats.bytes / (1024.f * 1024.f) << " MB in "
+		<< uploadStats.batches << " submissions, waited " << std::chrono::duration_cast<std::chrono::microseconds>(uploadEnd - uploadStart).count() / 1000.f << " ms" << std::endl;
+	print_geometry_stats();
+
 	//everything went fine
 	_isInitialized = true;
 }
@@ -79,17 +109,48 @@ void Vulkaneer::cleanup()
 
 void Vulkaneer::draw()
 {
-	VK_CHECK(vkWaitForFences(_device, 1, &get_current_frame()._renderFence, true, 1000000000));
-	VK_CHECK(vkResetFences(_device, 1, &get_current_frame()._renderFence));
+	//the frame FRAME_OVERLAP back ran in this slot
+	VK_CHECK(_timeline.wait(get_current_frame().submitValue, 1000000000));
+	get_current_frame().transient.reset();
+
+	//whatever was released ahead of a submission that finished by now is no longer read by anything in flight
+	_retired.release(_timeline.completed());
+
+	//what the culling shader kept when this frame slot last ran, only for the stats
+	if (get_current_frame().culledOnGpu)
+	{
+		vmaInvalidateAllocation(_allocator, get_current_frame().drawCounts._allocation, 0, VK_WHOLE_SIZE);
+		_gpuVisibleObjects = 0;
+		for (size_t i = 0; i < _indirectBatches.size(); i++)
+			_gpuVisibleObjects += get_current_frame().drawCountData[i];
+		get_current_frame().culledOnGpu = false;
+	}
+
+	if (_gpuDriven && _gpuSceneDirty)
+		build_gpu_scene();
+	const bool gpuDriven = _gpuDriven && !_gpuSceneDirty && _uploader.is_complete(_gpuSceneTicket);
+
+	//streamed uploads go out ahead of the frame on the same queue, a budget's worth at a time
+	_uploader.flush(UPLOAD_BUDGET_PER_FRAME);
 
 	uint32_t swapchainImageIndex;
 	VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, get_current_frame()._presentSemaphore, nullptr, &swapchainImageIndex));
 	VK_CHECK(vkResetCommandBuffer(get_current_frame()._mainCommandBuffer, 0));
+	for (VkCommandPool pool : get_current_frame().recordPools)
+		VK_CHECK(vkResetCommandPool(_device, pool, 0));
 
+	const auto recordStart = std::chrono::high_resolution_clock::now();
 	VkCommandBuffer cmd = get_current_frame()._mainCommandBuffer;
 	VkCommandBufferBeginInfo cmdBeginInfo = vkn::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
+	upload_object_transforms(cmd);
+	if (gpuDriven)
+		cull_objects_gpu(cmd);
+	else
+		prepare_draws();
+	update_frame_descriptors(get_current_frame(), !gpuDriven);
+
 	VkClearValue clearValue;
 	clearValue.color = { { 0.05f, 0.05f, 0.05f, 1.0f } };
 	VkClearValue depthClear;
@@ -99,12 +160,17 @@ void Vulkaneer::draw()
 	VkRenderPassBeginInfo rpInfo = vkn::renderpass_begin_info(_renderPass, _windowExtent, _framebuffers[swapchainImageIndex]);
 	rpInfo.clearValueCount = 2;
 	rpInfo.pClearValues = &clearValues[0];
-	vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+	const bool secondaries = !gpuDriven && parallel_recording();
+	vkCmdBeginRenderPass(cmd, &rpInfo, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 	{
-		draw_objects(cmd, _renderables.data(), static_cast<int>(_renderables.size()));
+		if (gpuDriven)
+			draw_objects_indirect(cmd);
+		else
+			draw_objects(cmd, _framebuffers[swapchainImageIndex]);
 	}
 	vkCmdEndRenderPass(cmd);
 	VK_CHECK(vkEndCommandBuffer(cmd));
+	_recordMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
 
 	//Submit
 	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -114,7 +180,7 @@ void Vulkaneer::draw()
 	submit.pWaitSemaphores = &get_current_frame()._presentSemaphore;
 	submit.signalSemaphoreCount = 1;
 	submit.pSignalSemaphores = &get_current_frame()._renderSemaphore;
-	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, get_current_frame()._renderFence));
+	VK_CHECK(_timeline.submit(_graphicsQueue, submit, get_current_frame().submitValue));
 
 	//Present
 	VkPresentInfoKHR presentInfo = vkn::present_info();
@@ -133,14 +199,113 @@ void Vulkaneer::run()
 	SDL_Event e;
 	bool bQuit = false;
 
+	//frame time since the last toggle, reported together with the triangle count
+	auto statsStart = std::chrono::high_resolution_clock::now();
+	int statsFrames = 0;
+	//individual frame times since the last streaming toggle, the spikes matter more than the average there
+	std::vector<float> frameTimes;
+	auto lastFrame = statsStart;
+	auto lastCacheSave = statsStart;
+
 	//main loop
 	while (!bQuit)
 	{
 		while (SDL_PollEvent(&e) != 0)
 		{
 			if (e.type == SDL_QUIT) bQuit = true;
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_c)
+			{
+				_meshletCulling = !_meshletCulling;
+				std::cout << "Meshlet culling " << (_meshletCulling ? "on" : "off") << ", last frame " << _meshletStats.tested << " meshlets tested, "
+					<< _meshletStats.frustumCulled << " frustum culled, " << _meshletStats.backfaceCulled << " backface culled, "
+					<< _meshletStats.drawCalls << " draws" << std::endl;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_l)
+			{
+				const auto now = std::chrono::high_resolution_clock::now();
+				const float frameMs = std::chrono::duration<float, std::milli>(now - statsStart).count() / std::max(statsFrames, 1);
+				std::cout << "LOD selection " << (_lodSelection ? "was on" : "was off") << ", last frame " << _renderedTriangles << " triangles, "
+					<< frameMs << " ms per frame over " << statsFrames << " frames, " << _renderedTriangles / (frameMs * 1000.f) << " Mtri/s" << std::endl;
+				_lodSelection = !_lodSelection;
+				statsStart = now;
+				statsFrames = 0;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f)
+			{
+				std::cout << "Frustum culling " << (_frustumCulling ? "was on" : "was off") << ", " << _visibleObjects.size() << " of "
+					<< _renderScene.size() << " objects kept in " << _cullMs << " ms, " << _recordMs << " ms recording the last frame, "
+					<< _frames[(_frameNumber + FRAME_OVERLAP - 1) % FRAME_OVERLAP].transient.used() / 1024.f << " KB of frame data, "
+					<< _objectUploadBytes / 1024.f << " KB of transforms in " << _objectUploadCopies << " copies" << std::endl;
+				_frustumCulling = !_frustumCulling;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_i)
+			{
+				std::cout << "Instancing " << (_instancing ? "was on" : "was off") << ", last frame " << _drawList.size() << " objects in "
+					<< _meshletStats.drawCalls << " draws, " << _instancedObjects << " of them instanced, " << _recordMs << " ms recording" << std::endl;
+				_instancing = !_instancing;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_p)
+			{
+				std::cout << "Parallel recording " << (_parallelRecording ? "was on" : "was off") << ", last frame " << _drawList.size() << " objects in "
+					<< _meshletStats.drawCalls << " draws over " << _recordSlices << " command buffers, " << _recordMs << " ms recording" << std::endl;
+				_parallelRecording = !_parallelRecording;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_k)
+			{
+				std::cout << "Draw sorting " << (_drawSorting ? "was on" : "was off") << ", last frame " << _drawList.size() << " objects in "
+					<< _sortMs << " ms, " << _meshletStats.drawCalls << " draws, " << _bindStats.pipelines << " pipeline binds, "
+					<< _bindStats.descriptorSets << " descriptor set binds, " << _bindStats.vertexBuffers << " vertex buffer binds, "
+					<< _bindStats.indexBuffers << " index buffer binds" << std::endl;
+				_drawSorting = !_drawSorting;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_g && _cullPipeline != VK_NULL_HANDLE)
+			{
+				std::cout << "GPU driven rendering " << (_gpuDriven ? "was on" : "was off") << ", " << _renderScene.size() << " objects, "
+					<< _recordMs << " ms recording the last frame, " << _meshletStats.drawCalls << " draws";
+				if (_gpuDriven)
+					std::cout << ", " << _gpuVisibleObjects << " objects visible";
+				std::cout << std::endl;
+				_gpuDriven = !_gpuDriven;
+			}
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_s)
+			{
+				std::sort(frameTimes.begin(), frameTimes.end());
+				float total = 0.f;
+				for (float ms : frameTimes)
+					total += ms;
+				const size_t count = std::max<size_t>(frameTimes.size(), 1);
+				const vkn::UploadStats uploadStats = _uploader.stats();
+				std::cout << "Streaming " << (_streamTest ? "was on" : "was off") << ", " << frameTimes.size() << " frames, "
+					<< total / count << " ms average, " << (frameTimes.empty() ? 0.f : frameTimes[frameTimes.size() * 99 / 100]) << " ms 99th percentile, "
+					<< (frameTimes.empty() ? 0.f : frameTimes.back()) << " ms worst, " << uploadStats.bytes / (1024.f * 1024.f) << " MB uploaded in "
+					<< uploadStats.batches << " submissions so far" << std::endl;
+				_streamTest = !_streamTest;
+				frameTimes.clear();
+			}
 		}
+
+		if (_streamTest && _uploader.stats().pending < STREAM_TEST_QUEUED_CHUNKS)
+		{
+			if (_streamTestBuffer._buffer == VK_NULL_HANDLE)
+			{
+				_streamTestBuffer = create_buffer(STREAM_TEST_CHUNK_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+			}
+			_uploader.upload_buffer(_streamTestBuffer._buffer, std::vector<uint8_t>(STREAM_TEST_CHUNK_SIZE));
+		}
+
 		draw();
+		statsFrames++;
+
+		const auto frameEnd = std::chrono::high_resolution_clock::now();
+		frameTimes.push_back(std::chrono::duration<float, std::milli>(frameEnd - lastFrame).count());
+		lastFrame = frameEnd;
+
+		//a save with nothing new compiled since the last one does not touch the file
+		if (PIPELINE_CACHE_SAVE_SECONDS > 0.f && std::chrono::duration<float>(frameEnd - lastCacheSave).count() >= PIPELINE_CACHE_SAVE_SECONDS)
+		{
+			_pipelineCache.save();
+			lastCacheSave = frameEnd;
+		}
 	}
 }
 
@@ -166,6 +331,7 @@ void Vulkaneer::init_vulkan()
 	feats.drawIndirectFirstInstance = true;
 	feats.samplerAnisotropy = true;
 	feats.fillModeNonSolid = true;
+	feats.textureCompressionBC = true;
 	selector.set_required_features(feats);
 
 	vkb::PhysicalDevice physicalDevice = selector
@@ -175,13 +341,54 @@ void Vulkaneer::init_vulkan()
 		.select()
 		.value();
 
+	VkPhysicalDeviceVulkan12Features supported12 = {};
+	supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supported = {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supported.pNext = &supported12;
+	vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &supported);
+
+	//optional, without it the gpu driven path draws every command slot of a batch and the culled ones have no instances
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.drawIndirectCount = supported12.drawIndirectCount;
+	//core in 1.2 and required of every 1.2 device, frames and uploads are tracked on a timeline
+	features12.timelineSemaphore = VK_TRUE;
+	_drawIndirectCount = supported12.drawIndirectCount == VK_TRUE;
+
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
-	vkb::Device vkbDevice = deviceBuilder.build().value();
+	vkb::Device vkbDevice = deviceBuilder
+		.add_pNext(&features12)
+		.build()
+		.value();
 	_device = vkbDevice.device;
 	_chosenGPU = physicalDevice.physical_device;
 	_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	//uploads prefer a transfer only family, then any family apart from graphics, and share the graphics queue without one
+	auto transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+	auto transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+	if (!transferQueue || !transferQueueFamily)
+	{
+		transferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+		transferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer);
+	}
+	if (transferQueue && transferQueueFamily)
+	{
+		_transferQueue = transferQueue.value();
+		_transferQueueFamily = transferQueueFamily.value();
+	}
+	else
+	{
+		_transferQueue = _graphicsQueue;
+		_transferQueueFamily = _graphicsQueueFamily;
+	}
+	if (_transferQueueFamily != _graphicsQueueFamily)
+		std::cout << "Uploads run on queue family " << _transferQueueFamily << ", graphics on " << _graphicsQueueFamily << std::endl;
+	else
+		std::cout << "No separate transfer queue, uploads share the graphics queue" << std::endl;
+
 	vkGetPhysicalDeviceProperties(_chosenGPU, &_gpuProperties);
 	std::cout << "The GPU has a minimum buffer alignment of " << _gpuProperties.limits.minUniformBufferOffsetAlignment << std::endl;
 
@@ -190,6 +397,47 @@ void Vulkaneer::init_vulkan()
 	allocatorInfo.device = _device;
 	allocatorInfo.instance = _instance;
 	VK_CHECK(vmaCreateAllocator(&allocatorInfo, &_allocator));
+
+	_geometry.init(_allocator, GEOMETRY_VERTEX_CAPACITY, GEOMETRY_INDEX_CAPACITY, upload_queue_families());
+	_mainDeletionQueue.push_function([=]() {
+		_geometry.cleanup();
+	});
+
+	//saved once every pipeline is gone, what the driver compiled this run is what the next one starts from
+	_pipelineCache.init(_device, _chosenGPU, PIPELINE_CACHE_PATH);
+	_mainDeletionQueue.push_function([=]() {
+		if (!_pipelineCache.save())
+			std::cout << "Could not save the pipeline cache to " << PIPELINE_CACHE_PATH << std::endl;
+		_pipelineCache.cleanup();
+	});
+
+	//flushed late, whatever is still retired at shutdown goes right before the allocator
+	_retired.init(_device, _allocator);
+	_mainDeletionQueue.push_function([=]() {
+		_retired.cleanup();
+	});
+
+	//assets loaded at runtime belong to the tables they live in, at shutdown they are retired like unloaded ones
+	_mainDeletionQueue.push_function([=]() {
+		const uint64_t value = _timeline.next();
+		for (auto& it : _meshes)
+		{
+			if (it.second._geometry.vertexBytes == 0)
+			{
+				_retired.retire_buffer(value, it.second._vertexBuffer);
+				_retired.retire_buffer(value, it.second._indexBuffer);
+			}
+		}
+		for (auto& it : _loadedTextures)
+		{
+			_retired.retire_image_view(value, it.second.imageView);
+			_retired.retire_image(value, it.second.image);
+		}
+		if (_gltfSampler != VK_NULL_HANDLE)
+			_retired.retire_sampler(value, _gltfSampler);
+		if (_streamTestBuffer._buffer != VK_NULL_HANDLE)
+			_retired.retire_buffer(value, _streamTestBuffer);
+	});
 }
 
 void Vulkaneer::init_swapchain()
@@ -249,12 +497,32 @@ void Vulkaneer::init_commands()
 		{
 			vkDestroyCommandPool(_device, _frames[i]._commandPool, nullptr);
 		});
+
+		//a pool per recording thread, reset as a whole at the start of the frame
+		VkCommandPoolCreateInfo recordPoolInfo = vkn::command_pool_create_info(_graphicsQueueFamily);
+		_frames[i].recordPools.resize(vkn::worker_count());
+		_frames[i].recordBuffers.resize(vkn::worker_count());
+		for (uint32_t t = 0; t < vkn::worker_count(); t++)
+		{
+			VK_CHECK(vkCreateCommandPool(_device, &recordPoolInfo, nullptr, &_frames[i].recordPools[t]));
+			VkCommandBufferAllocateInfo recordAllocInfo = vkn::command_buffer_allocate_info(_frames[i].recordPools[t], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			VK_CHECK(vkAllocateCommandBuffers(_device, &recordAllocInfo, &_frames[i].recordBuffers[t]));
+		}
+		_mainDeletionQueue.push_function([=]()
+		{
+			for (VkCommandPool pool : _frames[i].recordPools)
+				vkDestroyCommandPool(_device, pool, nullptr);
+		});
 	}
 
-	VkCommandPoolCreateInfo uploadCommandPoolInfo = vkn::command_pool_create_info(_graphicsQueueFamily);
-	VK_CHECK(vkCreateCommandPool(_device, &uploadCommandPoolInfo, nullptr, &_uploadContext._commandPool));
+	//the uploader waits on the timeline until its last batch retired, so the timeline goes after it
+	_timeline.init(_device);
+	_mainDeletionQueue.push_function([=]() {
+		_timeline.cleanup();
+	});
+	_uploader.init(_device, _allocator, _transferQueue, _transferQueueFamily, _graphicsQueue, _graphicsQueueFamily, &_timeline, STAGING_RING_SIZE);
 	_mainDeletionQueue.push_function([=]() {
-		vkDestroyCommandPool(_device, _uploadContext._commandPool, nullptr);
+		_uploader.cleanup();
 	});
 }
 
@@ -337,12 +605,10 @@ void Vulkaneer::init_framebuffers()
 
 void Vulkaneer::init_sync_structures()
 {
-	VkFenceCreateInfo fenceCreateInfo = vkn::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vkn::semaphore_create_info();
 
 	for (int i = 0; i < FRAME_OVERLAP; ++i)
 	{
-		VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
 		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._presentSemaphore));
 		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
 
@@ -350,16 +616,8 @@ void Vulkaneer::init_sync_structures()
 		{
 			vkDestroySemaphore(_device, _frames[i]._presentSemaphore, nullptr);
 			vkDestroySemaphore(_device, _frames[i]._renderSemaphore, nullptr);
-			vkDestroyFence(_device, _frames[i]._renderFence, nullptr);
 		});
 	}
-
-	VkFenceCreateInfo uploadFenceCreateInfo = vkn::fence_create_info();
-	VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_uploadContext._uploadFence));
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyFence(_device, _uploadContext._uploadFence, nullptr);
-	});
-
 }
 
 void Vulkaneer::init_descriptors()
@@ -368,19 +626,20 @@ void Vulkaneer::init_descriptors()
 	{
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
-		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
-		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURE_SETS }
 	};
 
 	VkDescriptorPoolCreateInfo pool_info = {};
 	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	pool_info.flags = 0;
-	pool_info.maxSets = 10;
+	pool_info.maxSets = 16 + MAX_TEXTURE_SETS;
 	pool_info.poolSizeCount = (uint32_t)sizes.size();
 	pool_info.pPoolSizes = sizes.data();
 	vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptorPool);
 
-	VkDescriptorSetLayoutBinding cameraBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	//both live in the frame's transient buffer, wherever its allocator put them this frame
+	VkDescriptorSetLayoutBinding cameraBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
 	VkDescriptorSetLayoutBinding sceneBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 	VkDescriptorSetLayoutBinding bindings[] = { cameraBind , sceneBind };
 
@@ -392,13 +651,17 @@ void Vulkaneer::init_descriptors()
 	setinfo.pBindings = bindings;
 	vkCreateDescriptorSetLayout(_device, &setinfo, nullptr, &_globalSetLayout);
 
+	//the object buffer, and the object index of every instance drawn, in draw order on the cpu path and in draw
+	//object order on the gpu driven one
 	VkDescriptorSetLayoutBinding objectBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	VkDescriptorSetLayoutBinding instanceBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1);
+	VkDescriptorSetLayoutBinding objectBindings[] = { objectBind, instanceBind };
 	VkDescriptorSetLayoutCreateInfo set2info = {};
-	set2info.bindingCount = 1;
+	set2info.bindingCount = 2;
 	set2info.flags = 0;
 	set2info.pNext = nullptr;
 	set2info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	set2info.pBindings = &objectBind;
+	set2info.pBindings = objectBindings;
 	vkCreateDescriptorSetLayout(_device, &set2info, nullptr, &_objectSetLayout);
 
 	VkDescriptorSetLayoutBinding textureBind = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
@@ -410,15 +673,9 @@ void Vulkaneer::init_descriptors()
 	set3info.pBindings = &textureBind;
 	vkCreateDescriptorSetLayout(_device, &set3info, nullptr, &_singleTextureSetLayout);
 
-	const size_t sceneParamBufferSize = FRAME_OVERLAP * pad_uniform_buffer_size(sizeof(GPUSceneData));
-	_sceneParameterBuffer = create_buffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
 	for (int i = 0; i < FRAME_OVERLAP; i++)
 	{
-		_frames[i].cameraBuffer = create_buffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-		const int MAX_OBJECTS = 10000;
-		_frames[i].objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		_frames[i].transient.init(_allocator, FRAME_ALLOCATOR_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &_retired, &_timeline);
 
 		VkDescriptorSetAllocateInfo allocInfo = {};
 		allocInfo.pNext = nullptr;
@@ -436,82 +693,56 @@ void Vulkaneer::init_descriptors()
 		objectSetAlloc.pSetLayouts = &_objectSetLayout;
 		vkAllocateDescriptorSets(_device, &objectSetAlloc, &_frames[i].objectDescriptor);
 
-		VkDescriptorBufferInfo cameraInfo;
-		cameraInfo.buffer = _frames[i].cameraBuffer._buffer;
-		cameraInfo.offset = 0;
-		cameraInfo.range = sizeof(GPUCameraData);
-
-		VkDescriptorBufferInfo sceneInfo;
-		sceneInfo.buffer = _sceneParameterBuffer._buffer;
-		sceneInfo.offset = 0;
-		sceneInfo.range = sizeof(GPUSceneData);
-
-		VkDescriptorBufferInfo objectBufferInfo;
-		objectBufferInfo.buffer = _frames[i].objectBuffer._buffer;
-		objectBufferInfo.offset = 0;
-		objectBufferInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
-
-		VkWriteDescriptorSet cameraWrite = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[i].globalDescriptor, &cameraInfo, 0);
-		VkWriteDescriptorSet sceneWrite = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i].globalDescriptor, &sceneInfo, 1);
-		VkWriteDescriptorSet objectWrite = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].objectDescriptor, &objectBufferInfo, 0);
-		VkWriteDescriptorSet setWrites[] = { cameraWrite, sceneWrite, objectWrite };
-		vkUpdateDescriptorSets(_device, 3, setWrites, 0, nullptr);
+		//written for real by update_frame_descriptors
+		_frames[i].globalGeneration = ~0u;
+		_frames[i].objectGeneration = ~0u;
+		_frames[i].instanceOffset = 0;
+		_frames[i].instanceRange = 0;
 	}
 
 	_mainDeletionQueue.push_function([=]()
 	{
-		vmaDestroyBuffer(_allocator, _sceneParameterBuffer._buffer, _sceneParameterBuffer._allocation);
 		vkDestroyDescriptorSetLayout(_device, _singleTextureSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
 		vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
 
 		for (int i = 0; i < FRAME_OVERLAP; i++)
-		{
-			vmaDestroyBuffer(_allocator, _frames[i].cameraBuffer._buffer, _frames[i].cameraBuffer._allocation);
-			vmaDestroyBuffer(_allocator, _frames[i].objectBuffer._buffer, _frames[i].objectBuffer._allocation);
-		}
+			_frames[i].transient.cleanup();
+		if (_objectBuffer._buffer != VK_NULL_HANDLE)
+			vmaDestroyBuffer(_allocator, _objectBuffer._buffer, _objectBuffer._allocation);
 	});
 }
 
 void Vulkaneer::init_pipelines()
 {
-	VkShaderModule meshVertShader;
 	VkShaderModule meshFragShader;
-	if (!load_shader_module("../../shaders/tri_mesh.vert.spv", &meshVertShader))
-		std::cout << "Error when building the triangle vertex shader module" << std::endl;
-	else
-		std::cout << "Triangle vertex shader succesfully loaded" << std::endl;
-	
 	if (!load_shader_module("../../shaders/tri_mesh.frag.spv", &meshFragShader))
 		std::cout << "Error when building the triangle fragment shader module" << std::endl;
 	else
 		std::cout << "Triangle fragment shader succesfully loaded" << std::endl;
 
-	//VkPushConstantRange push_constant;
-	//push_constant.offset = 0;
-	//push_constant.size = sizeof(MeshPushConstants);
-	//push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	//the packed vertex shaders read their dequantization ranges from push constants
+	VkPushConstantRange push_constant;
+	push_constant.offset = 0;
+	push_constant.size = sizeof(VertexQuantization);
+	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	VkPipelineLayout meshPipelineLayout;
 	VkDescriptorSetLayout setLayouts[] = { _globalSetLayout, _objectSetLayout, _singleTextureSetLayout };
 	VkPipelineLayoutCreateInfo mesh_pipeline_layout_info = vkn::pipeline_layout_create_info();
-	//mesh_pipeline_layout_info.pPushConstantRanges = &push_constant;
-	//mesh_pipeline_layout_info.pushConstantRangeCount = 1;
+	mesh_pipeline_layout_info.pPushConstantRanges = &push_constant;
+	mesh_pipeline_layout_info.pushConstantRangeCount = 1;
 	mesh_pipeline_layout_info.setLayoutCount = 3;
 	mesh_pipeline_layout_info.pSetLayouts = setLayouts;
 	VK_CHECK(vkCreatePipelineLayout(_device, &mesh_pipeline_layout_info, nullptr, &meshPipelineLayout));
 
-	VertexInputDescription vertexDescription = Vertex::get_vertex_description();
+	_mainDeletionQueue.push_function([=]()
+	{
+		vkDestroyPipelineLayout(_device, meshPipelineLayout, nullptr);
+	});
 
 	PipelineBuilder pipelineBuilder;
-	pipelineBuilder._shaderStages.push_back(vkn::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertShader));
-	pipelineBuilder._shaderStages.push_back(vkn::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, meshFragShader));
-	pipelineBuilder._vertexInputInfo = vkn::vertex_input_state_create_info();
-	pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
-	pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexDescription.attributes.size());
-	pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = vertexDescription.bindings.data();
-	pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexDescription.bindings.size());
 	pipelineBuilder._inputAssembly = vkn::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 	pipelineBuilder._viewport.x = 0.0f;
 	pipelineBuilder._viewport.y = 0.0f;
@@ -522,59 +753,113 @@ void Vulkaneer::init_pipelines()
 	pipelineBuilder._scissor.offset = { 0, 0 };
 	pipelineBuilder._scissor.extent = _windowExtent;
 	pipelineBuilder._rasterizer = vkn::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+	if (CULL_BACKFACES)
+		pipelineBuilder._rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
 	pipelineBuilder._multisampling = vkn::multisampling_state_create_info();
 	pipelineBuilder._colorBlendAttachment = vkn::color_blend_attachment_state();
 	pipelineBuilder._depthStencil = vkn::depth_stencil_create_info(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
 	pipelineBuilder._pipelineLayout = meshPipelineLayout;
 
-	VkPipeline meshPipeline;
-	meshPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+	//one mesh pipeline per vertex format, see get_mesh_material
+	struct MeshPipelineInfo
+	{
+		const char* vertexShader;
+		const char* material;
+		VertexInputDescription vertexDescription;
+	};
+	MeshPipelineInfo meshPipelines[] =
+	{
+		{ "../../shaders/tri_mesh.vert.spv", "defaultmesh", Vertex::get_vertex_description() },
+		{ "../../shaders/tri_mesh_packed.vert.spv", "packedmesh", PackedVertex::get_vertex_description(false) },
+		{ "../../shaders/tri_mesh_packed_color.vert.spv", "packedcolormesh", PackedVertex::get_vertex_description(true) },
+	};
 
-	create_material(meshPipeline, meshPipelineLayout, "defaultmesh");
+	for (MeshPipelineInfo& info : meshPipelines)
+	{
+		VkShaderModule meshVertShader;
+		if (!load_shader_module(info.vertexShader, &meshVertShader))
+		{
+			std::cout << "Error when building the " << info.vertexShader << " vertex shader module" << std::endl;
+			continue;
+		}
+		std::cout << info.vertexShader << " vertex shader succesfully loaded" << std::endl;
+
+		pipelineBuilder._shaderStages.clear();
+		pipelineBuilder._shaderStages.push_back(vkn::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertShader));
+		pipelineBuilder._shaderStages.push_back(vkn::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, meshFragShader));
+		pipelineBuilder._vertexInputInfo = vkn::vertex_input_state_create_info();
+		pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = info.vertexDescription.attributes.data();
+		pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(info.vertexDescription.attributes.size());
+		pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = info.vertexDescription.bindings.data();
+		pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(info.vertexDescription.bindings.size());
+
+		const auto buildStart = std::chrono::high_resolution_clock::now();
+		VkPipeline meshPipeline = pipelineBuilder.build_pipeline(_device, _renderPass, _pipelineCache.cache());
+		_pipelineBuildMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+		_pipelinesBuilt++;
+		create_material(meshPipeline, meshPipelineLayout, info.material);
+		vkDestroyShaderModule(_device, meshVertShader, nullptr);
 
-	vkDestroyShaderModule(_device, meshFragShader, nullptr);
-	vkDestroyShaderModule(_device, meshVertShader, nullptr);
+		_mainDeletionQueue.push_function([=]()
+		{
+			vkDestroyPipeline(_device, meshPipeline, nullptr);
+		});
+	}
 
-	_mainDeletionQueue.push_function([=]()
-	{
-		vkDestroyPipeline(_device, meshPipeline, nullptr);
-		vkDestroyPipelineLayout(_device, meshPipelineLayout, nullptr);
-	});
+	vkDestroyShaderModule(_device, meshFragShader, nullptr);
 }
 
 void Vulkaneer::init_scene()
 {
-	/*RenderObject monkey;
-	monkey.mesh = get_mesh("monkey");
-	monkey.material = get_material("defaultmesh");
-	monkey.transformMatrix = glm::mat4{ 1.0f };
-	_renderables.push_back(monkey);
+	/*_renderScene.add(get_mesh("monkey"), get_material("defaultmesh"), glm::mat4{ 1.0f });
 
 	for (int x = -20; x <= 20; x++)
 	{
 		for (int y = -20; y <= 20; y++)
 		{
-			RenderObject tri;
-			tri.mesh = get_mesh("triangle");
-			tri.material = get_material("defaultmesh");
 			glm::mat4 translation = glm::translate(glm::mat4{ 1.0 }, glm::vec3(x, 0, y));
 			glm::mat4 scale = glm::scale(glm::mat4{ 1.0 }, glm::vec3(0.2, 0.2, 0.2));
-			tri.transformMatrix = translation * scale;
-			_renderables.push_back(tri);
+			_renderScene.add(get_mesh("triangle"), get_material("defaultmesh"), translation * scale);
 		}
 	}*/
 
-	RenderObject map;
-	map.mesh = get_mesh("empire");
-	map.material = get_material("defaultmesh");
-	map.transformMatrix = glm::translate(glm::vec3{ 5,-10,0 });
-	_renderables.push_back(map);
+	//meshes that failed to load are missing, whatever uses them is left out
+	Mesh* monkey = get_mesh("monkey");
+	if (LOD_BENCHMARK_SCENE && monkey)
+	{
+		//rows from right in front of the camera out to the far plane, most of them only need a coarse lod
+		for (int z = 0; z < 40; z++)
+		{
+			for (int x = -10; x <= 10; x++)
+			{
+				_renderScene.add(monkey, get_mesh_material(*monkey), glm::translate(glm::vec3{ x * 3.f, 4.f, -z * 5.f }));
+			}
+		}
+	}
+
+	if (CULLING_BENCHMARK_OBJECTS > 0 && monkey)
+	{
+		//a cube around the camera that grows with the count so the density stays the same, most of it outside the frustum
+		std::mt19937 rng(7);
+		const float extent = 4.f * std::cbrt(static_cast<float>(CULLING_BENCHMARK_OBJECTS));
+		std::uniform_real_distribution<float> position(-extent, extent);
+		for (unsigned int i = 0; i < CULLING_BENCHMARK_OBJECTS; i++)
+			_renderScene.add(monkey, get_mesh_material(*monkey), glm::translate(glm::vec3{ position(rng), position(rng), position(rng) }));
+	}
+
+	if (GLTF_SCENE_PATH[0] != '\0')
+		load_gltf_scene(GLTF_SCENE_PATH, glm::mat4{ 1.f });
+
+	Mesh* map = get_mesh("empire");
+	if (!map)
+		return;
+	Material* texturedMat = get_mesh_material(*map);
+	_renderScene.add(map, texturedMat, glm::translate(glm::vec3{ 5,-10,0 }));
 
 	VkSamplerCreateInfo samplerInfo = vkn::sampler_create_info(VK_FILTER_NEAREST);
 	VkSampler blockySampler;
 	vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler);
 
-	Material* texturedMat = get_material("defaultmesh");
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.pNext = nullptr;
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -629,15 +914,52 @@ bool Vulkaneer::load_shader_module(const char* filePath, VkShaderModule* outShad
 void Vulkaneer::load_images()
 {
 	Texture lostEmpire;
-	vkn::load_image_from_file(*this, "../../assets/lost_empire-RGBA.png", lostEmpire.image);
-	VkImageViewCreateInfo imageinfo = vkn::imageview_create_info(VK_FORMAT_R8G8B8A8_SRGB, lostEmpire.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VkFormat lostEmpireFormat;
+	vkn::load_image_from_file(*this, "../../assets/lost_empire-RGBA.png", lostEmpire.image, lostEmpireFormat);
+	VkImageViewCreateInfo imageinfo = vkn::imageview_create_info(lostEmpireFormat, lostEmpire.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
 	vkCreateImageView(_device, &imageinfo, nullptr, &lostEmpire.imageView);
 	_loadedTextures["empire_diffuse"] = lostEmpire;
+}
 
-	_mainDeletionQueue.push_function([=]()
+namespace
+{
+	//indices are narrowed to 16 bit where they fit, data gets the packed vertices followed by the indices
+	void pack_mesh(Mesh& mesh, std::vector<uint8_t>& outData, size_t& outVertexBytes, size_t& outIndexBytes)
 	{
-		vkDestroyImageView(_device, lostEmpire.imageView, nullptr);
-	});
+		if (mesh._indices.empty())
+		{
+			mesh._indices.resize(mesh._vertices.size());
+			for (size_t i = 0; i < mesh._indices.size(); i++)
+				mesh._indices[i] = static_cast<uint32_t>(i);
+		}
+		mesh._indexType = mesh.select_index_type();
+		mesh._vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+		mesh._indexCount = static_cast<uint32_t>(mesh._indices.size());
+
+		//vertices and indices share one upload, the index buffer data follows the packed vertices
+		std::vector<uint8_t> data;
+		mesh.pack_vertices(data);
+
+		const size_t vertexBufferSize = data.size();
+		const size_t indexSize = mesh._indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		const size_t indexBufferSize = mesh._indices.size() * indexSize;
+
+		data.resize(vertexBufferSize + indexBufferSize);
+		if (mesh._indexType == VK_INDEX_TYPE_UINT16)
+		{
+			uint16_t* indexData = (uint16_t*)(data.data() + vertexBufferSize);
+			for (size_t i = 0; i < mesh._indices.size(); i++)
+				indexData[i] = static_cast<uint16_t>(mesh._indices[i]);
+		}
+		else
+		{
+			memcpy(data.data() + vertexBufferSize, mesh._indices.data(), indexBufferSize);
+		}
+
+		outData = std::move(data);
+		outVertexBytes = vertexBufferSize;
+		outIndexBytes = indexBufferSize;
+	}
 }
 
 void Vulkaneer::load_meshes()
@@ -650,69 +972,306 @@ void Vulkaneer::load_meshes()
 	triangleMesh._vertices[0].color = { 0.f, 1.f, 0.0f };
 	triangleMesh._vertices[1].color = { 0.f, 1.f, 0.0f };
 	triangleMesh._vertices[2].color = { 0.f, 1.f, 0.0f };
+	triangleMesh._indices = { 0, 1, 2 };
+	triangleMesh.compute_bounds();
 	upload_mesh(triangleMesh);
 	_meshes["triangle"] = triangleMesh;
 
-	Mesh monkeyMesh;
-	monkeyMesh.load_from_obj("../../assets/monkey_smooth.obj");
-	upload_mesh(monkeyMesh);
-	_meshes["monkey"] = monkeyMesh;
+	//parsing and cooking dominate startup, every mesh loads as a job of its own and their inner loops share the same
+	//workers, only the buffer creation touches the geometry buffer and uploader so it stays on this thread
+	const char* paths[] = { "../../assets/monkey_smooth.obj", "../../assets/lost_empire.obj" };
+	const char* names[] = { "monkey", "empire" };
+	constexpr size_t meshCount = sizeof(paths) / sizeof(paths[0]);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<MeshLoad> loads(meshCount);
+	std::vector<char> loaded(meshCount);
+	vkn::parallel_for(meshCount, [&](size_t i)
+	{
+		loaded[i] = read_mesh(paths[i], loads[i]);
+	});
+	//a mesh that failed to load is left out, the scene skips what it cannot find
+	for (size_t i = 0; i < meshCount; i++)
+	{
+		if (!loaded[i])
+			continue;
+		create_mesh_buffers(loads[i].mesh, loads[i].source, loads[i].vertexBytes, loads[i].indexOffset, loads[i].indexBytes);
+		_meshes[names[i]] = std::move(loads[i].mesh);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Meshes loaded in " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f
+		<< " ms on " << vkn::worker_count() << " threads" << std::endl;
+}
+
+bool Vulkaneer::read_mesh(const char* objPath, MeshLoad& load)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//prefer the cooked version written by vkcook next to the source asset
+	std::string cookedPath = objPath;
+	cookedPath = cookedPath.substr(0, cookedPath.find_last_of('.')) + ".vkmesh";
+	const bool cooked = read_cooked_mesh(cookedPath.c_str(), load);
+	bool loaded = cooked;
+	vkn::MeshOptimizeStats optimized{};
+	if (!cooked)
+	{
+		Mesh& mesh = load.mesh;
+		loaded = mesh.load_from_obj_parallel(objPath);
+		if (loaded)
+		{
+			if (OPTIMIZE_OBJ_MESHES)
+				optimized = vkn::optimize_mesh(mesh);
+			if (BUILD_OBJ_MESHLETS)
+				vkn::build_meshlets(mesh);
+			if (GENERATE_OBJ_LODS)
+				vkn::generate_lods(mesh);
+			mesh._vertexFormat = OBJ_VERTEX_FORMAT;
+			pack_mesh(mesh, load.data, load.vertexBytes, load.indexBytes);
+			load.source = load.data.data();
+			load.indexOffset = load.vertexBytes;
+		}
+	}
 
-	Mesh lostEmpire{};
-	lostEmpire.load_from_obj("../../assets/lost_empire.obj");
-	upload_mesh(lostEmpire);
-	_meshes["empire"] = lostEmpire;
+	auto end = std::chrono::high_resolution_clock::now();
+	auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+	//one line per mesh, the passes themselves stay quiet since they also run on the loader's worker threads
+	std::ostringstream summary;
+	summary << "Mesh " << (loaded ? "loaded " : "failed to load ") << objPath << (cooked ? " (cooked)" : " (obj)")
+		<< " in " << diff.count() / 1000.f << " ms";
+	if (loaded && !cooked)
+	{
+		if (OPTIMIZE_OBJ_MESHES)
+			summary << ", ACMR " << optimized.before.acmr << " -> " << optimized.after.acmr;
+		summary << ", " << load.mesh._meshlets.size() << " meshlets, " << load.mesh._lods.size() << " lods";
+	}
+	std::cout << summary.str() << std::endl;
+	return loaded;
 }
 
-void Vulkaneer::upload_mesh(Mesh& mesh)
+bool Vulkaneer::read_cooked_mesh(const char* path, MeshLoad& load)
 {
-	const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
+	std::unique_ptr<vkn::MappedFile> file = std::make_unique<vkn::MappedFile>();
+	if (!file->open(path))
+		return false;
 
-	VkBufferCreateInfo stagingBufferInfo = {};
-	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingBufferInfo.pNext = nullptr;
-	stagingBufferInfo.size = bufferSize;
-	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	vkn::MeshFileHeader header;
+	vkn::MeshFileBlobs blobs;
+	if (!vkn::read_mesh_file(*file, header, blobs))
+	{
+		std::cout << "Ignoring invalid cooked mesh " << path << std::endl;
+		return false;
+	}
+	vkn::apply_mesh_file_header(header, blobs, load.mesh);
+
+	//the blobs already have the gpu layout and the index blob follows the vertex blob, so both go from the mapping
+	//straight into staging, padding between them included
+	load.source = blobs.vertices;
+	load.vertexBytes = header.vertexBytes;
+	load.indexOffset = header.indexOffset - header.vertexOffset;
+	load.indexBytes = header.indexBytes;
+	load.file = std::move(file);
+	return true;
+}
 
-	AllocatedBuffer stagingBuffer;
-	VmaAllocationCreateInfo vmaallocInfo = {};
-	vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-	VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaallocInfo,
-		&stagingBuffer._buffer,
-		&stagingBuffer._allocation,
-		nullptr));
+bool Vulkaneer::load_gltf_scene(const char* path, const glm::mat4& transform)
+{
+	//the same passes obj meshes get, run on the loader's worker threads
+	vkn::GltfScene scene;
+	const bool loaded = vkn::load_gltf(path, scene, [](Mesh& mesh)
+	{
+		if (OPTIMIZE_OBJ_MESHES)
+			vkn::optimize_mesh(mesh);
+		if (BUILD_OBJ_MESHLETS)
+			vkn::build_meshlets(mesh);
+		if (GENERATE_OBJ_LODS)
+			vkn::generate_lods(mesh);
+		mesh._vertexFormat = OBJ_VERTEX_FORMAT;
+	});
+	if (!loaded)
+		return false;
+
+	const std::string prefix = std::string(path) + "#";
 
-	void* data;
-	vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-	memcpy(data, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex));
-	vmaUnmapMemory(_allocator, stagingBuffer._allocation);
+	if (_gltfSampler == VK_NULL_HANDLE)
+	{
+		VkSamplerCreateInfo samplerInfo = vkn::sampler_create_info(VK_FILTER_LINEAR);
+		vkCreateSampler(_device, &samplerInfo, nullptr, &_gltfSampler);
+	}
+
+	auto create_texture = [&](const vkn::ImageData& image, const std::string& name)
+	{
+		Texture texture;
+		vkn::upload_image(*this, image, texture.image);
+		VkImageViewCreateInfo viewInfo = vkn::imageview_create_info(vkn::texture_vk_format(image.format), texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCreateImageView(_device, &viewInfo, nullptr, &texture.imageView);
+		_loadedTextures[name] = texture;
+		return texture.imageView;
+	};
+
+	std::vector<VkImageView> imageViews(scene.images.size(), VK_NULL_HANDLE);
+	for (size_t i = 0; i < scene.images.size(); i++)
+	{
+		if (scene.images[i].pixels.empty())
+			continue;
+		if (GENERATE_TEXTURE_MIPS)
+			vkn::generate_mips(scene.images[i]);
+		imageViews[i] = create_texture(scene.images[i], prefix + "image" + std::to_string(i));
+	}
+
+	//untextured materials and images that failed to decode sample plain white
+	VkImageView whiteView = VK_NULL_HANDLE;
+	auto base_color_view = [&](int image)
+	{
+		if (image >= 0 && size_t(image) < imageViews.size() && imageViews[image] != VK_NULL_HANDLE)
+			return imageViews[image];
+		if (whiteView == VK_NULL_HANDLE)
+		{
+			vkn::ImageData white;
+			white.width = 1;
+			white.height = 1;
+			white.pixels = { 255, 255, 255, 255 };
+			whiteView = create_texture(white, prefix + "white");
+		}
+		return whiteView;
+	};
+
+	//one engine material per gltf material, created on first use since the pipeline follows the vertex format of the mesh
+	std::unordered_map<int, Material*> materials;
+	auto get_scene_material = [&](int index, const Mesh& mesh)
+	{
+		auto it = materials.find(index);
+		if (it != materials.end())
+			return it->second;
+
+		const Material* pipelineMaterial = get_mesh_material(mesh);
+		Material* material = create_material(pipelineMaterial->pipeline, pipelineMaterial->pipelineLayout, prefix + "material" + std::to_string(index));
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.pNext = nullptr;
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_singleTextureSetLayout;
+		if (vkAllocateDescriptorSets(_device, &allocInfo, &material->textureSet) != VK_SUCCESS)
+		{
+			std::cout << "Out of texture descriptor sets, raise MAX_TEXTURE_SETS" << std::endl;
+			material->textureSet = VK_NULL_HANDLE;
+		}
+		else
+		{
+			const int image = index >= 0 && size_t(index) < scene.materials.size() ? scene.materials[index].baseColorImage : -1;
+			VkDescriptorImageInfo imageBufferInfo;
+			imageBufferInfo.sampler = _gltfSampler;
+			imageBufferInfo.imageView = base_color_view(image);
+			imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			VkWriteDescriptorSet write = vkn::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, material->textureSet, &imageBufferInfo, 0);
+			vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+		}
+
+		materials[index] = material;
+		return material;
+	};
+
+	//every primitive is uploaded once, all the nodes that use its mesh point at the same buffers
+	std::vector<Mesh*> meshes(scene.primitives.size(), nullptr);
+	size_t uploaded = 0;
+	size_t meshletCount = 0;
+	size_t lodCount = 0;
+	for (size_t p = 0; p < scene.primitives.size(); p++)
+	{
+		Mesh& mesh = scene.primitives[p].mesh;
+		if (mesh._vertices.empty())
+			continue;
+		meshletCount += mesh._meshlets.size();
+		lodCount += mesh._lods.size();
+		upload_mesh(mesh);
+		const std::string name = prefix + "primitive" + std::to_string(p);
+		_meshes[name] = std::move(mesh);
+		meshes[p] = &_meshes[name];
+		uploaded++;
+	}
+
+	size_t added = 0;
+	for (const vkn::GltfInstance& instance : scene.instances)
+	{
+		const vkn::GltfMesh& gltfMesh = scene.meshes[instance.mesh];
+		for (uint32_t p = gltfMesh.firstPrimitive; p < gltfMesh.firstPrimitive + gltfMesh.primitiveCount; p++)
+		{
+			if (!meshes[p])
+				continue;
+
+			_renderScene.add(meshes[p], get_scene_material(scene.primitives[p].material, *meshes[p]), transform * instance.transform);
+			added++;
+		}
+	}
+
+	std::cout << "glTF scene " << path << " added " << added << " renderables sharing " << uploaded << " meshes, "
+		<< meshletCount << " meshlets and " << lodCount << " lods" << std::endl;
+	_gpuSceneDirty = true;
+	return true;
+}
+
+void Vulkaneer::upload_mesh(Mesh& mesh)
+{
+	std::vector<uint8_t> data;
+	size_t vertexBufferSize;
+	size_t indexBufferSize;
+	pack_mesh(mesh, data, vertexBufferSize, indexBufferSize);
+	create_mesh_buffers(mesh, data.data(), vertexBufferSize, vertexBufferSize, indexBufferSize);
+}
+
+void Vulkaneer::create_mesh_buffers(Mesh& mesh, const uint8_t* data, size_t vertexBufferSize, size_t indexOffset, size_t indexBufferSize)
+{
+	const size_t dataSize = indexOffset + indexBufferSize;
+	const uint32_t vertexStride = vertex_stride(mesh._vertexFormat);
+	const uint32_t indexSize = mesh._indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	vkn::GeometryAllocation allocation;
+	if (_geometry.allocate(vertexBufferSize, vertexStride, indexBufferSize, indexSize, allocation))
+	{
+		mesh._geometry = allocation;
+		mesh._vertexBuffer = _geometry.vertex_buffer();
+		mesh._indexBuffer = _geometry.index_buffer();
+		mesh._vertexOffset = static_cast<int32_t>(allocation.vertexOffset / vertexStride);
+		mesh._firstIndex = static_cast<uint32_t>(allocation.indexOffset / indexSize);
+		//the geometry buffer is concurrent over both families, no ownership transfer
+		mesh._uploadTicket = _uploader.upload_buffers(data, dataSize, {
+			{ mesh._vertexBuffer._buffer, allocation.vertexOffset, 0, vertexBufferSize },
+			{ mesh._indexBuffer._buffer, allocation.indexOffset, indexOffset, indexBufferSize },
+		}, true);
+		return;
+	}
+
+	//still drawable, it just costs a buffer rebind every time it is drawn
+	std::cout << "Geometry buffer full, a mesh of " << vertexBufferSize + indexBufferSize << " bytes gets buffers of its own" << std::endl;
+	mesh._vertexOffset = 0;
+	mesh._firstIndex = 0;
 
 	VkBufferCreateInfo vertexBufferInfo = {};
 	vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	vertexBufferInfo.pNext = nullptr;
-	vertexBufferInfo.size = bufferSize;
+	vertexBufferInfo.size = vertexBufferSize;
 	vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
+	VmaAllocationCreateInfo vmaallocInfo = {};
 	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 	VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
 		&mesh._vertexBuffer._buffer,
 		&mesh._vertexBuffer._allocation,
 		nullptr));
 
-	immediate_submit([=](VkCommandBuffer cmd)
-	{
-		VkBufferCopy copy;
-		copy.dstOffset = 0;
-		copy.srcOffset = 0;
-		copy.size = bufferSize;
-		vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
-	});
+	VkBufferCreateInfo indexBufferInfo = vertexBufferInfo;
+	indexBufferInfo.size = indexBufferSize;
+	indexBufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VK_CHECK(vmaCreateBuffer(_allocator, &indexBufferInfo, &vmaallocInfo,
+		&mesh._indexBuffer._buffer,
+		&mesh._indexBuffer._allocation,
+		nullptr));
 
-	_mainDeletionQueue.push_function([=]()
-	{
-		vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+	//the mesh owns them, unload_mesh retires them
+	mesh._uploadTicket = _uploader.upload_buffers(data, dataSize, {
+		{ mesh._vertexBuffer._buffer, 0, 0, vertexBufferSize },
+		{ mesh._indexBuffer._buffer, 0, indexOffset, indexBufferSize },
 	});
-	vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
 }
 
 Material* Vulkaneer::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
@@ -733,6 +1292,19 @@ Material* Vulkaneer::get_material(const std::string& name)
 		return &(*it).second;
 }
 
+Material* Vulkaneer::get_mesh_material(const Mesh& mesh)
+{
+	switch (mesh._vertexFormat)
+	{
+	case VertexFormat::Packed:
+		return get_material("packedmesh");
+	case VertexFormat::PackedColor:
+		return get_material("packedcolormesh");
+	default:
+		return get_material("defaultmesh");
+	}
+}
+
 Mesh* Vulkaneer::get_mesh(const std::string& name)
 {
 	auto it = _meshes.find(name);
@@ -742,7 +1314,45 @@ Mesh* Vulkaneer::get_mesh(const std::string& name)
 		return &(*it).second;
 }
 
-void Vulkaneer::draw_objects(VkCommandBuffer cmd, RenderObject* first, int count)
+bool Vulkaneer::unload_mesh(const std::string& name)
+{
+	auto it = _meshes.find(name);
+	if (it == _meshes.end())
+		return false;
+
+	Mesh* mesh = &it->second;
+	_renderScene.remove_mesh(mesh);
+
+	//frames in flight may still draw it, its ranges or its own buffers go once they finished
+	if (mesh->_geometry.vertexBytes > 0)
+	{
+		_retired.retire_geometry(_timeline.next(), _geometry, mesh->_geometry);
+	}
+	else
+	{
+		_retired.retire_buffer(_timeline.next(), mesh->_vertexBuffer);
+		_retired.retire_buffer(_timeline.next(), mesh->_indexBuffer);
+	}
+	_meshes.erase(it);
+	_gpuSceneDirty = true;
+	return true;
+}
+
+void Vulkaneer::print_geometry_stats()
+{
+	const vkn::RangeStats vertexStats = _geometry.vertex_stats();
+	const vkn::RangeStats indexStats = _geometry.index_stats();
+	auto print = [](const char* name, const vkn::RangeStats& stats)
+	{
+		std::cout << "Geometry " << name << " buffer: " << stats.allocations << " meshes, " << stats.used / (1024.f * 1024.f) << " of "
+			<< stats.capacity / (1024.f * 1024.f) << " MB used, " << stats.freeRanges << " free ranges, largest "
+			<< stats.largestFree / (1024.f * 1024.f) << " MB, " << stats.fragmentation * 100.f << "% fragmented" << std::endl;
+	};
+	print("vertex", vertexStats);
+	print("index", indexStats);
+}
+
+GPUCameraData Vulkaneer::upload_frame_globals(glm::vec3& outCameraPosition)
 {
 	glm::vec3 camPos = { 0.f,-6.f,-10.f };
 	glm::mat4 view = glm::translate(glm::mat4(1.f), camPos);
@@ -754,61 +1364,732 @@ void Vulkaneer::draw_objects(VkCommandBuffer cmd, RenderObject* first, int count
 	camData.view = view;
 	camData.viewproj = projection * view;
 
-	void* data;
-	vmaMapMemory(_allocator, get_current_frame().cameraBuffer._allocation, &data);
-	memcpy(data, &camData, sizeof(GPUCameraData));
-	vmaUnmapMemory(_allocator, get_current_frame().cameraBuffer._allocation);
+	vkn::FrameAllocator& transient = get_current_frame().transient;
+	const VkDeviceSize uniformAlignment = std::max<VkDeviceSize>(_gpuProperties.limits.minUniformBufferOffsetAlignment, 16);
+	vkn::FrameAllocation camera = transient.allocate(sizeof(GPUCameraData), uniformAlignment);
+	vkn::stream_copy(camera.data, &camData, sizeof(GPUCameraData));
 
 	float framed = (_frameNumber / 120.f);
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
 	_sceneParameters.ambientColor = { sin(framed),0,cos(framed),1 };
 
-	char* sceneData;
-	vmaMapMemory(_allocator, _sceneParameterBuffer._allocation, (void**)&sceneData);
-	sceneData += pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
-	memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
-	vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
+	vkn::FrameAllocation scene = transient.allocate(sizeof(GPUSceneData), uniformAlignment);
+	vkn::stream_copy(scene.data, &_sceneParameters, sizeof(GPUSceneData));
+
+	_globalOffsets[0] = static_cast<uint32_t>(camera.offset);
+	_globalOffsets[1] = static_cast<uint32_t>(scene.offset);
+
+	outCameraPosition = -camPos;
+	return camData;
+}
+
+void Vulkaneer::upload_object_transforms(VkCommandBuffer cmd)
+{
+	FrameData& frame = get_current_frame();
+	const uint32_t count = static_cast<uint32_t>(_renderScene.size());
+	_renderScene.take_dirty_ranges(OBJECT_UPLOAD_MAX_GAP, _dirtyObjects);
+	_objectUploadBytes = 0;
+	_objectUploadCopies = 0;
+
+	if (count > _objectCapacity)
+	{
+		//frames in flight still read the old buffer, the new one starts out empty so everything goes in again
+		if (_objectBuffer._buffer != VK_NULL_HANDLE)
+			_retired.retire_buffer(_timeline.next(), _objectBuffer);
+		_objectCapacity = std::max(count, _objectCapacity * 2);
+		_objectBuffer = create_buffer(sizeof(GPUObjectData) * _objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		_objectBufferGeneration++;
+		_dirtyObjects.assign(1, { 0, count });
+	}
+	if (_objectBuffer._buffer == VK_NULL_HANDLE)
+		return;
+
+	//nothing has bound this frame's sets yet and its last submission finished
+	if (frame.objectGeneration != _objectBufferGeneration)
+	{
+		VkDescriptorBufferInfo objectInfo = { _objectBuffer._buffer, 0, VK_WHOLE_SIZE };
+		VkWriteDescriptorSet objectWrites[] =
+		{
+			vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.objectDescriptor, &objectInfo, 0),
+			vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &objectInfo, 0),
+		};
+		vkUpdateDescriptorSets(_device, 2, objectWrites, 0, nullptr);
+		frame.objectGeneration = _objectBufferGeneration;
+	}
+	if (_dirtyObjects.empty())
+		return;
+
+	//the dirty transforms go into the transient buffer back to back and from there in one copy per range
+	uint32_t dirtyCount = 0;
+	for (const vkn::ObjectRange& range : _dirtyObjects)
+		dirtyCount += range.count;
+	vkn::FrameAllocation staging = frame.transient.allocate(sizeof(GPUObjectData) * dirtyCount, 16);
+
+	const std::vector<glm::mat4>& transforms = _renderScene.transforms();
+	std::vector<VkBufferCopy> copies;
+	copies.reserve(_dirtyObjects.size());
+	uint8_t* data = static_cast<uint8_t*>(staging.data);
+	VkDeviceSize srcOffset = staging.offset;
+	for (const vkn::ObjectRange& range : _dirtyObjects)
+	{
+		const VkDeviceSize bytes = sizeof(GPUObjectData) * range.count;
+		vkn::stream_copy(data, &transforms[range.first], bytes);
+		copies.push_back({ srcOffset, sizeof(GPUObjectData) * range.first, bytes });
+		data += bytes;
+		srcOffset += bytes;
+	}
+
+	//earlier frames may still be reading the ranges about to be overwritten
+	VkMemoryBarrier reads = {};
+	reads.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reads.srcAccessMask = 0;
+	reads.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &reads, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(cmd, staging.buffer, _objectBuffer._buffer, static_cast<uint32_t>(copies.size()), copies.data());
+
+	VkMemoryBarrier written = {};
+	written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	written.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	written.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &written, 0, nullptr, 0, nullptr);
+
+	_objectUploadBytes = sizeof(GPUObjectData) * dirtyCount;
+	_objectUploadCopies = static_cast<uint32_t>(copies.size());
+}
+
+void Vulkaneer::update_frame_descriptors(FrameData& frame, bool cpuObjects)
+{
+	frame.transient.flush();
+
+	//the sets of this frame are not bound by anything in flight, its submission retired and recording has not bound them yet
+	VkWriteDescriptorSet writes[3];
+	uint32_t writeCount = 0;
+	VkDescriptorBufferInfo cameraInfo = { frame.transient.buffer(), 0, sizeof(GPUCameraData) };
+	VkDescriptorBufferInfo sceneInfo = { frame.transient.buffer(), 0, sizeof(GPUSceneData) };
+	if (frame.globalGeneration != frame.transient.generation())
+	{
+		writes[writeCount++] = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.globalDescriptor, &cameraInfo, 0);
+		writes[writeCount++] = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.globalDescriptor, &sceneInfo, 1);
+		frame.globalGeneration = frame.transient.generation();
+	}
+	VkDescriptorBufferInfo instanceInfo = { frame.transient.buffer(), frame.instanceOffset, frame.instanceRange };
+	if (!cpuObjects)
+		instanceInfo = { _gpuInstanceBuffer._buffer, 0, VK_WHOLE_SIZE };
+	if (instanceInfo.buffer != VK_NULL_HANDLE)
+		writes[writeCount++] = vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.objectDescriptor, &instanceInfo, 1);
+	if (writeCount > 0)
+		vkUpdateDescriptorSets(_device, writeCount, writes, 0, nullptr);
+}
+
+void Vulkaneer::bind_material(VkCommandBuffer cmd, const Material& material, VkDescriptorSet objectDescriptor)
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 0, 1, &get_current_frame().globalDescriptor, 2, _globalOffsets);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 1, 1, &objectDescriptor, 0, nullptr);
+
+	if (material.textureSet != VK_NULL_HANDLE)
+	{
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 2, 1, &material.textureSet, 0, nullptr);
+	}
+}
 
-	void* objectData;
-	vmaMapMemory(_allocator, get_current_frame().objectBuffer._allocation, &objectData);
-	GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
+void Vulkaneer::prepare_draws()
+{
+	_frameCamera = upload_frame_globals(_cameraPosition);
+
+	const auto cullStart = std::chrono::high_resolution_clock::now();
+	if (_frustumCulling)
+	{
+		vkn::cull_spheres(vkn::extract_frustum(_frameCamera.viewproj), _renderScene.bounds(), _visibleObjects);
+	}
+	else
+	{
+		_visibleObjects.clear();
+		for (uint32_t i = 0; i < _renderScene.size(); i++)
+		{
+			if (!(_renderScene.flags()[i] & vkn::RENDER_FLAG_HIDDEN))
+				_visibleObjects.push_back(i);
+		}
+	}
+	_cullMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+
+	const int count = static_cast<int>(_visibleObjects.size());
+	const std::vector<uint32_t>& meshIds = _renderScene.mesh_ids();
+	const std::vector<uint32_t>& materialIds = _renderScene.material_ids();
+
+	const auto sortStart = std::chrono::high_resolution_clock::now();
+	_drawList.resize(count);
+	if (_drawSorting)
+	{
+		//pipelines numbered in the order their materials were first seen, there are only a handful of either
+		std::unordered_map<VkPipeline, uint32_t> pipelineIds;
+		_materialPipelineIds.resize(_renderScene.material_count());
+		for (uint32_t id = 0; id < _renderScene.material_count(); id++)
+		{
+			const Material* material = _renderScene.material(id);
+			_materialPipelineIds[id] = pipelineIds.insert({ material->pipeline, static_cast<uint32_t>(pipelineIds.size()) }).first->second;
+		}
+
+		//one pass, opaque, front to back up to the far plane of upload_frame_globals
+		//keys are built as jobs in chunks, the radix sort over all of them stays one pass on this thread
+		constexpr int keyChunk = 16384;
+		const vkn::SphereArrays& bounds = _renderScene.bounds();
+		vkn::parallel_for((count + keyChunk - 1) / keyChunk, [&](size_t chunk)
+		{
+			const int end = std::min(count, static_cast<int>(chunk + 1) * keyChunk);
+			for (int i = static_cast<int>(chunk) * keyChunk; i < end; i++)
+			{
+				const uint32_t index = _visibleObjects[i];
+				const float depth = glm::length(glm::vec3(bounds.x[index], bounds.y[index], bounds.z[index]) - _cameraPosition) / 200.f;
+				_drawList[i] = { vkn::make_draw_key(0, _materialPipelineIds[materialIds[index]], materialIds[index], meshIds[index], depth), index };
+			}
+		});
+		vkn::radix_sort(_drawList, _drawListScratch);
+	}
+	else
+	{
+		for (int i = 0; i < count; i++)
+			_drawList[i] = { 0, _visibleObjects[i] };
+	}
+	_sortMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+
+	//instances only carry their object's index, the transforms are already in the object buffer, the descriptor range
+	//cannot be empty so there is always room for one
+	FrameData& frame = get_current_frame();
+	const VkDeviceSize storageAlignment = std::max<VkDeviceSize>(_gpuProperties.limits.minStorageBufferOffsetAlignment, 16);
+	const VkDeviceSize instanceBytes = sizeof(uint32_t) * std::max(count, 1);
+	vkn::FrameAllocation instances = frame.transient.allocate(instanceBytes, storageAlignment);
+	frame.instanceOffset = instances.offset;
+	frame.instanceRange = instanceBytes;
+
+	uint32_t* instanceIndices = static_cast<uint32_t*>(instances.data);
 	for (int i = 0; i < count; i++)
+		instanceIndices[i] = _drawList[i].index;
+}
+
+bool Vulkaneer::parallel_recording() const
+{
+	return _parallelRecording && vkn::worker_count() > 1 && _drawList.size() >= 2 * PARALLEL_RECORD_MIN_DRAWS;
+}
+
+void Vulkaneer::draw_objects(VkCommandBuffer cmd, VkFramebuffer framebuffer)
+{
+	const uint32_t count = static_cast<uint32_t>(_drawList.size());
+	std::vector<DrawStats> sliceStats;
+	if (!parallel_recording())
 	{
-		RenderObject& object = first[i];
-		objectSSBO[i].modelMatrix = object.transformMatrix;
+		sliceStats.resize(1);
+		record_draws(cmd, 0, count, sliceStats[0], _visibleRanges);
+		_recordSlices = 1;
+	}
+	else
+	{
+		//slices only end where a run of one mesh and material ends, so they instance exactly like a single thread would
+		FrameData& frame = get_current_frame();
+		const std::vector<uint32_t>& meshIds = _renderScene.mesh_ids();
+		const std::vector<uint32_t>& materialIds = _renderScene.material_ids();
+		const uint32_t sliceCount = std::min(static_cast<uint32_t>(frame.recordBuffers.size()), count / PARALLEL_RECORD_MIN_DRAWS);
+		std::vector<uint32_t> sliceStarts(sliceCount + 1, count);
+		sliceStarts[0] = 0;
+		for (uint32_t slice = 1; slice < sliceCount; slice++)
+		{
+			uint32_t start = std::max(sliceStarts[slice - 1], static_cast<uint32_t>(uint64_t(count) * slice / sliceCount));
+			while (start > 0 && start < count && meshIds[_drawList[start].index] == meshIds[_drawList[start - 1].index]
+				&& materialIds[_drawList[start].index] == materialIds[_drawList[start - 1].index])
+				start++;
+			sliceStarts[slice] = start;
+		}
+
+		VkCommandBufferInheritanceInfo inheritance = {};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = _renderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = framebuffer;
+
+		//every slice records into the buffer of its own pool, so no two threads ever touch the same pool
+		sliceStats.resize(sliceCount);
+		vkn::parallel_for(sliceCount, [&](size_t slice)
+		{
+			VkCommandBuffer secondary = frame.recordBuffers[slice];
+			VkCommandBufferBeginInfo beginInfo = vkn::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+			beginInfo.pInheritanceInfo = &inheritance;
+			VK_CHECK(vkBeginCommandBuffer(secondary, &beginInfo));
+			std::vector<vkn::IndexRange> ranges;
+			record_draws(secondary, sliceStarts[slice], sliceStarts[slice + 1], sliceStats[slice], ranges);
+			VK_CHECK(vkEndCommandBuffer(secondary));
+		});
+		vkCmdExecuteCommands(cmd, sliceCount, frame.recordBuffers.data());
+		_recordSlices = sliceCount;
 	}
-	vmaUnmapMemory(_allocator, get_current_frame().objectBuffer._allocation);
+
+	_meshletStats = {};
+	_bindStats = {};
+	_renderedTriangles = 0;
+	_instancedObjects = 0;
+	for (const DrawStats& stats : sliceStats)
+	{
+		_meshletStats.tested += stats.meshlets.tested;
+		_meshletStats.frustumCulled += stats.meshlets.frustumCulled;
+		_meshletStats.backfaceCulled += stats.meshlets.backfaceCulled;
+		_meshletStats.drawCalls += stats.meshlets.drawCalls;
+		_bindStats.pipelines += stats.binds.pipelines;
+		_bindStats.descriptorSets += stats.binds.descriptorSets;
+		_bindStats.vertexBuffers += stats.binds.vertexBuffers;
+		_bindStats.indexBuffers += stats.binds.indexBuffers;
+		_renderedTriangles += stats.triangles;
+		_instancedObjects += stats.instancedObjects;
+	}
+}
+
+void Vulkaneer::record_draws(VkCommandBuffer cmd, uint32_t begin, uint32_t end, DrawStats& stats, std::vector<vkn::IndexRange>& ranges)
+{
+	const std::vector<uint32_t>& meshIds = _renderScene.mesh_ids();
+	const std::vector<uint32_t>& materialIds = _renderScene.material_ids();
+	const std::vector<glm::mat4>& transforms = _renderScene.transforms();
+	const glm::vec3 cameraPosition = _cameraPosition;
+
+	//lod errors are measured where the camera is, pixels per world unit at distance 1
+	const float projectionScale = _windowExtent.height / (2.f * tan(glm::radians(70.f) * 0.5f));
 
 	Mesh* lastMesh = nullptr;
 	Material* lastMaterial = nullptr;
-	for (int i = 0; i < count; i++)
+	//materials sharing a pipeline, layout or texture set only rebind what differs, sets 0 and 1 are the same for every
+	//material so they only follow layout changes
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+	VkDescriptorSet boundTextureSet = VK_NULL_HANDLE;
+	//meshes share the geometry buffers, so these only change for meshes that did not fit or another index type
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	for (uint32_t i = begin; i < end;)
 	{
-		RenderObject& object = first[i];
+		const uint32_t index = _drawList[i].index;
+		Mesh* mesh = _renderScene.mesh(meshIds[index]);
+		Material* material = _renderScene.material(materialIds[index]);
+
+		//the draws sharing this mesh and material, which the sort put next to each other and whose transforms sit next
+		//to each other in the object buffer, so one instanced draw covers each lod among them
+		uint32_t runEnd = i + 1;
+		while (_instancing && runEnd < end && meshIds[_drawList[runEnd].index] == meshIds[index] && materialIds[_drawList[runEnd].index] == materialIds[index])
+			runEnd++;
+		const uint32_t first = i;
+		i = runEnd;
+		if (!_uploader.is_complete(mesh->_uploadTicket))
+			continue;
+
+		if (material != lastMaterial)
+		{
+			if (material->pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+				boundPipeline = material->pipeline;
+				stats.binds.pipelines++;
+			}
+			if (material->pipelineLayout != boundLayout)
+			{
+				const VkDescriptorSet sets[] = { get_current_frame().globalDescriptor, get_current_frame().objectDescriptor };
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 0, 2, sets, 2, _globalOffsets);
+				boundLayout = material->pipelineLayout;
+				boundTextureSet = VK_NULL_HANDLE;
+				stats.binds.descriptorSets++;
+				//push constants of another layout may not carry over, the mesh below pushes them again
+				lastMesh = nullptr;
+			}
+			if (material->textureSet != VK_NULL_HANDLE && material->textureSet != boundTextureSet)
+			{
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &material->textureSet, 0, nullptr);
+				boundTextureSet = material->textureSet;
+				stats.binds.descriptorSets++;
+			}
+			lastMaterial = material;
+		}
 
-		if (object.material != lastMaterial)
+		if (mesh != lastMesh)
 		{
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-			lastMaterial = object.material;
-			uint32_t uniform_offset = static_cast<uint32_t>(pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex);
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1, &get_current_frame().globalDescriptor, 1, &uniform_offset);
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &get_current_frame().objectDescriptor, 0, nullptr);
+			if (mesh->_vertexBuffer._buffer != boundVertexBuffer)
+			{
+				VkDeviceSize offset = 0;
+				vkCmdBindVertexBuffers(cmd, 0, 1, &mesh->_vertexBuffer._buffer, &offset);
+				boundVertexBuffer = mesh->_vertexBuffer._buffer;
+				stats.binds.vertexBuffers++;
+			}
+			if (mesh->_indexBuffer._buffer != boundIndexBuffer || mesh->_indexType != boundIndexType)
+			{
+				vkCmdBindIndexBuffer(cmd, mesh->_indexBuffer._buffer, 0, mesh->_indexType);
+				boundIndexBuffer = mesh->_indexBuffer._buffer;
+				boundIndexType = mesh->_indexType;
+				stats.binds.indexBuffers++;
+			}
+			if (mesh->_vertexFormat != VertexFormat::Full)
+				vkCmdPushConstants(cmd, material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexQuantization), &mesh->_quantization);
+			lastMesh = mesh;
+		}
+		auto select_lod = [&](uint32_t draw)
+		{
+			return _lodSelection ? vkn::select_lod(*mesh, transforms[_drawList[draw].index], cameraPosition, projectionScale, LOD_PIXEL_ERROR) : 0;
+		};
+
+		//meshlets only cover lod 0, and only objects drawn on their own are culled per meshlet, for a run of them one
+		//draw saves more than culling inside each instance would
+		if (runEnd - first == 1 && _meshletCulling && !mesh->_meshlets.empty() && select_lod(first) == 0)
+		{
+			//meshlet bounds are in mesh space, so the frustum and camera are brought there instead
+			const glm::mat4& model = transforms[index];
+			const vkn::Frustum frustum = vkn::extract_frustum(_frameCamera.viewproj * model);
+			const glm::vec3 meshCamera = glm::inverse(model) * glm::vec4(cameraPosition, 1.f);
+			ranges.clear();
+			vkn::cull_meshlets(mesh->_meshlets, frustum, meshCamera, CULL_BACKFACES, ranges, stats.meshlets);
+			for (const vkn::IndexRange& range : ranges)
+			{
+				vkCmdDrawIndexed(cmd, range.indexCount, 1, mesh->_firstIndex + range.firstIndex, mesh->_vertexOffset, first);
+				stats.triangles += range.indexCount / 3;
+			}
+			continue;
+		}
+
+		//the run is front to back, so objects with the same lod mostly follow each other
+		uint32_t lod = select_lod(first);
+		uint32_t instanceStart = first;
+		for (uint32_t draw = first + 1; draw <= runEnd; draw++)
+		{
+			const uint32_t nextLod = draw < runEnd ? select_lod(draw) : UINT32_MAX;
+			if (nextLod == lod)
+				continue;
+
+			const MeshLod range = mesh->_lods.empty() ? MeshLod{ 0, mesh->_indexCount, 0.f } : mesh->_lods[lod];
+			const uint32_t instanceCount = draw - instanceStart;
+			vkCmdDrawIndexed(cmd, range.indexCount, instanceCount, mesh->_firstIndex + range.firstIndex, mesh->_vertexOffset, instanceStart);
+			stats.meshlets.drawCalls++;
+			stats.instancedObjects += instanceCount > 1 ? instanceCount : 0;
+			stats.triangles += uint64_t(range.indexCount / 3) * instanceCount;
+			instanceStart = draw;
+			lod = nextLod;
+		}
+	}
+}
+
+void Vulkaneer::init_gpu_culling()
+{
+	VkDescriptorSetLayoutBinding cullBindings[5];
+	for (uint32_t i = 0; i < 5; i++)
+		cullBindings[i] = vkn::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+	VkDescriptorSetLayoutCreateInfo cullSetInfo = {};
+	cullSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullSetInfo.bindingCount = 5;
+	cullSetInfo.pBindings = cullBindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &cullSetInfo, nullptr, &_cullSetLayout));
+
+	VkPushConstantRange push_constant;
+	push_constant.offset = 0;
+	push_constant.size = sizeof(GPUCullConstants);
+	push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo cull_pipeline_layout_info = vkn::pipeline_layout_create_info();
+	cull_pipeline_layout_info.pPushConstantRanges = &push_constant;
+	cull_pipeline_layout_info.pushConstantRangeCount = 1;
+	cull_pipeline_layout_info.setLayoutCount = 1;
+	cull_pipeline_layout_info.pSetLayouts = &_cullSetLayout;
+	VK_CHECK(vkCreatePipelineLayout(_device, &cull_pipeline_layout_info, nullptr, &_cullPipelineLayout));
+
+	VkShaderModule cullShader;
+	if (!load_shader_module("../../shaders/cull_objects.comp.spv", &cullShader))
+	{
+		std::cout << "Error when building the culling compute shader module, gpu driven rendering is off" << std::endl;
+		_gpuDriven = false;
+	}
+	else
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = vkn::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+		pipelineInfo.layout = _cullPipelineLayout;
+		const auto buildStart = std::chrono::high_resolution_clock::now();
+		VK_CHECK(vkCreateComputePipelines(_device, _pipelineCache.cache(), 1, &pipelineInfo, nullptr, &_cullPipeline));
+		_pipelineBuildMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+		_pipelinesBuilt++;
+		vkDestroyShaderModule(_device, cullShader, nullptr);
+	}
+
+	for (int i = 0; i < FRAME_OVERLAP; i++)
+	{
+		VkDescriptorSetAllocateInfo cullSetAlloc = {};
+		cullSetAlloc.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		cullSetAlloc.descriptorPool = _descriptorPool;
+		cullSetAlloc.descriptorSetCount = 1;
+		cullSetAlloc.pSetLayouts = &_cullSetLayout;
+		vkAllocateDescriptorSets(_device, &cullSetAlloc, &_frames[i].cullDescriptor);
+		//written for real by update_cull_descriptor
+		_frames[i].cullGeneration = ~0u;
+	}
 
-			if (object.material->textureSet != VK_NULL_HANDLE)
+	std::cout << "GPU driven rendering " << (_drawIndirectCount ? "uses draw indirect count" : "draws every command slot, no draw indirect count") << std::endl;
+
+	_mainDeletionQueue.push_function([=]()
+	{
+		//the tables are replaced on every rebuild, so whatever they are at shutdown goes
+		auto destroy = [=](const AllocatedBuffer& buffer)
+		{
+			if (buffer._buffer != VK_NULL_HANDLE)
+				vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+		};
+		destroy(_gpuInstanceBuffer);
+		destroy(_gpuDrawObjectBuffer);
+		destroy(_gpuMeshBuffer);
+		for (int i = 0; i < FRAME_OVERLAP; i++)
+		{
+			destroy(_frames[i].indirectCommands);
+			destroy(_frames[i].drawCounts);
+		}
+		if (_cullPipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(_device, _cullPipeline, nullptr);
+		vkDestroyPipelineLayout(_device, _cullPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _cullSetLayout, nullptr);
+	});
+}
+
+bool Vulkaneer::build_gpu_scene()
+{
+	const std::vector<uint32_t>& meshIds = _renderScene.mesh_ids();
+	const std::vector<uint32_t>& materialIds = _renderScene.material_ids();
+	const std::vector<uint32_t>& flags = _renderScene.flags();
+	for (uint32_t meshId : meshIds)
+	{
+		if (!_uploader.is_complete(_renderScene.mesh(meshId)->_uploadTicket))
+			return false;
+	}
+
+	//batches are material and mesh pairs, ordered so the ones sharing a material follow each other, hidden objects
+	//are left out of every table
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> batchIndices;
+	for (size_t i = 0; i < _renderScene.size(); i++)
+	{
+		if (!(flags[i] & vkn::RENDER_FLAG_HIDDEN))
+			batchIndices[{ materialIds[i], meshIds[i] }]++;
+	}
+
+	_indirectBatches.clear();
+	uint32_t commandCount = 0;
+	for (auto& batch : batchIndices)
+	{
+		const uint32_t objects = batch.second;
+		batch.second = static_cast<uint32_t>(_indirectBatches.size());
+		_indirectBatches.push_back({ _renderScene.mesh(batch.first.second), _renderScene.material(batch.first.first), commandCount, objects });
+		commandCount += objects;
+	}
+
+	std::unordered_map<uint32_t, uint32_t> meshIndices;
+	std::vector<GPUMeshInfo> meshes;
+	std::vector<uint32_t> instances;
+	std::vector<GPUDrawObject> drawObjects;
+	instances.reserve(commandCount);
+	drawObjects.reserve(commandCount);
+	for (size_t i = 0; i < _renderScene.size(); i++)
+	{
+		if (flags[i] & vkn::RENDER_FLAG_HIDDEN)
+			continue;
+
+		auto inserted = meshIndices.insert({ meshIds[i], static_cast<uint32_t>(meshes.size()) });
+		if (inserted.second)
+		{
+			const Mesh& mesh = *_renderScene.mesh(meshIds[i]);
+			GPUMeshInfo info = {};
+			info.sphere = glm::vec4(mesh._bounds.origin, mesh._bounds.radius);
+			info.vertexOffset = mesh._vertexOffset;
+			info.firstIndex = mesh._firstIndex;
+			if (mesh._lods.empty())
+			{
+				info.lodCount = 1;
+				info.lods[0] = glm::uvec4(0, mesh._indexCount, 0, 0);
+			}
+			else
 			{
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
+				info.lodCount = std::min(static_cast<uint32_t>(mesh._lods.size()), vkn::MAX_MESH_LODS);
+				for (uint32_t lod = 0; lod < info.lodCount; lod++)
+					info.lods[lod] = glm::uvec4(mesh._lods[lod].firstIndex, mesh._lods[lod].indexCount, glm::floatBitsToUint(mesh._lods[lod].error), 0);
 			}
+			meshes.push_back(info);
 		}
 
-		glm::mat4 model = object.transformMatrix;
-		glm::mat4 mesh_matrix = model;
+		const uint32_t batchIndex = batchIndices[{ materialIds[i], meshIds[i] }];
+		//the transforms themselves live in the object buffer, kept up to date by upload_object_transforms
+		instances.push_back(static_cast<uint32_t>(i));
+		drawObjects.push_back({ inserted.first->second, batchIndex, _indirectBatches[batchIndex].firstCommand, static_cast<uint32_t>(i) });
+	}
+
+	//the stats of earlier layouts would be read back against the new batches
+	for (FrameData& frame : _frames)
+		frame.culledOnGpu = false;
 
-		if (object.mesh != lastMesh)
+	//frames in flight still read the old tables, so every rebuild uploads into new ones and the old ones go once
+	//those frames finished, each frame slot picks the new ones up in update_cull_descriptor
+	const uint32_t objectCount = static_cast<uint32_t>(drawObjects.size());
+	const uint32_t meshCount = static_cast<uint32_t>(meshes.size());
+	const uint32_t batchCount = static_cast<uint32_t>(_indirectBatches.size());
+	auto replaceTable = [=](AllocatedBuffer& buffer, size_t size)
+	{
+		if (buffer._buffer != VK_NULL_HANDLE)
+			_retired.retire_buffer(_timeline.next(), buffer);
+		buffer = create_upload_target(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	};
+	replaceTable(_gpuInstanceBuffer, sizeof(uint32_t) * std::max(objectCount, 1u));
+	replaceTable(_gpuDrawObjectBuffer, sizeof(GPUDrawObject) * std::max(objectCount, 1u));
+	replaceTable(_gpuMeshBuffer, sizeof(GPUMeshInfo) * std::max(meshCount, 1u));
+	_gpuSceneGeneration++;
+
+	auto upload = [&](const AllocatedBuffer& buffer, const void* data, size_t size)
+	{
+		//the tables are upload targets, concurrent over both families
+		return _uploader.upload_buffer(buffer._buffer, data, size, true);
+	};
+	if (objectCount > 0)
+	{
+		upload(_gpuInstanceBuffer, instances.data(), sizeof(uint32_t) * objectCount);
+		upload(_gpuDrawObjectBuffer, drawObjects.data(), sizeof(GPUDrawObject) * objectCount);
+		_gpuSceneTicket = upload(_gpuMeshBuffer, meshes.data(), sizeof(GPUMeshInfo) * meshCount);
+	}
+	_gpuObjectCount = objectCount;
+	_gpuSceneDirty = false;
+
+	std::cout << "GPU scene built, " << objectCount << " objects in " << batchCount << " batches over " << meshCount << " meshes" << std::endl;
+	return true;
+}
+
+void Vulkaneer::update_cull_descriptor(FrameData& frame)
+{
+	//the slot's last submission finished, but its buffers are retired like the tables all the same
+	const VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (_gpuObjectCount > frame.commandCapacity)
+	{
+		if (frame.indirectCommands._buffer != VK_NULL_HANDLE)
+			_retired.retire_buffer(_timeline.next(), frame.indirectCommands);
+		frame.commandCapacity = std::max(_gpuObjectCount, frame.commandCapacity * 2);
+		frame.indirectCommands = create_buffer(sizeof(VkDrawIndexedIndirectCommand) * frame.commandCapacity, indirectUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+	}
+	const uint32_t batchCount = static_cast<uint32_t>(_indirectBatches.size());
+	if (batchCount > frame.countCapacity)
+	{
+		if (frame.drawCounts._buffer != VK_NULL_HANDLE)
+			_retired.retire_buffer(_timeline.next(), frame.drawCounts);
+		frame.countCapacity = std::max(batchCount, frame.countCapacity * 2);
+
+		//the counts are read back on the cpu for the stats
+		VkBufferCreateInfo countBufferInfo = {};
+		countBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		countBufferInfo.size = sizeof(uint32_t) * frame.countCapacity;
+		countBufferInfo.usage = indirectUsage;
+		VmaAllocationCreateInfo countAllocInfo = {};
+		countAllocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+		countAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		VmaAllocationInfo countMapping;
+		VK_CHECK(vmaCreateBuffer(_allocator, &countBufferInfo, &countAllocInfo, &frame.drawCounts._buffer, &frame.drawCounts._allocation, &countMapping));
+		frame.drawCountData = static_cast<const uint32_t*>(countMapping.pMappedData);
+	}
+
+	//nothing has bound the set yet this frame
+	VkDescriptorBufferInfo drawObjectInfo = { _gpuDrawObjectBuffer._buffer, 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo meshInfo = { _gpuMeshBuffer._buffer, 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo commandInfo = { frame.indirectCommands._buffer, 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo countInfo = { frame.drawCounts._buffer, 0, VK_WHOLE_SIZE };
+	VkWriteDescriptorSet cullWrites[] =
+	{
+		vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &drawObjectInfo, 1),
+		vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &meshInfo, 2),
+		vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &commandInfo, 3),
+		vkn::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &countInfo, 4),
+	};
+	vkUpdateDescriptorSets(_device, 4, cullWrites, 0, nullptr);
+	frame.cullGeneration = _gpuSceneGeneration;
+}
+
+void Vulkaneer::cull_objects_gpu(VkCommandBuffer cmd)
+{
+	glm::vec3 cameraPosition;
+	const GPUCameraData camData = upload_frame_globals(cameraPosition);
+	FrameData& frame = get_current_frame();
+	if (_gpuObjectCount == 0)
+		return;
+	if (frame.cullGeneration != _gpuSceneGeneration)
+		update_cull_descriptor(frame);
+	frame.culledOnGpu = true;
+
+	//counts start at zero, and without draw indirect count so does every command slot since all of them get drawn
+	vkCmdFillBuffer(cmd, frame.drawCounts._buffer, 0, sizeof(uint32_t) * _indirectBatches.size(), 0);
+	if (!_drawIndirectCount)
+		vkCmdFillBuffer(cmd, frame.indirectCommands._buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * _gpuObjectCount, 0);
+
+	VkMemoryBarrier cleared = {};
+	cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &cleared, 0, nullptr, 0, nullptr);
+
+	GPUCullConstants constants = {};
+	const vkn::Frustum frustum = vkn::extract_frustum(camData.viewproj);
+	for (int i = 0; i < 6; i++)
+		constants.frustum[i] = frustum.planes[i];
+	const float projectionScale = _windowExtent.height / (2.f * tan(glm::radians(70.f) * 0.5f));
+	constants.camera = glm::vec4(cameraPosition, projectionScale);
+	constants.objectCount = _gpuObjectCount;
+	constants.lodPixelError = _lodSelection ? LOD_PIXEL_ERROR : -1.f;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &frame.cullDescriptor, 0, nullptr);
+	vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullConstants), &constants);
+	vkCmdDispatch(cmd, (_gpuObjectCount + 63) / 64, 1, 1);
+
+	VkMemoryBarrier culled = {};
+	culled.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	culled.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	culled.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &culled, 0, nullptr, 0, nullptr);
+}
+
+void Vulkaneer::draw_objects_indirect(VkCommandBuffer cmd)
+{
+	FrameData& frame = get_current_frame();
+	_meshletStats = {};
+	_renderedTriangles = 0;
+
+	Mesh* lastMesh = nullptr;
+	Material* lastMaterial = nullptr;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	for (size_t i = 0; i < _indirectBatches.size(); i++)
+	{
+		const IndirectBatch& batch = _indirectBatches[i];
+		if (batch.material != lastMaterial)
+		{
+			bind_material(cmd, *batch.material, frame.objectDescriptor);
+			lastMaterial = batch.material;
+		}
+		if (batch.mesh != lastMesh)
 		{
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
-			lastMesh = object.mesh;
+			if (batch.mesh->_vertexBuffer._buffer != boundVertexBuffer)
+			{
+				VkDeviceSize offset = 0;
+				vkCmdBindVertexBuffers(cmd, 0, 1, &batch.mesh->_vertexBuffer._buffer, &offset);
+				boundVertexBuffer = batch.mesh->_vertexBuffer._buffer;
+			}
+			if (batch.mesh->_indexBuffer._buffer != boundIndexBuffer || batch.mesh->_indexType != boundIndexType)
+			{
+				vkCmdBindIndexBuffer(cmd, batch.mesh->_indexBuffer._buffer, 0, batch.mesh->_indexType);
+				boundIndexBuffer = batch.mesh->_indexBuffer._buffer;
+				boundIndexType = batch.mesh->_indexType;
+			}
+			if (batch.mesh->_vertexFormat != VertexFormat::Full)
+				vkCmdPushConstants(cmd, batch.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexQuantization), &batch.mesh->_quantization);
+			lastMesh = batch.mesh;
 		}
-		vkCmdDraw(cmd, static_cast<uint32_t>(object.mesh->_vertices.size()), 1, 0, i);
+
+		const VkDeviceSize commandOffset = sizeof(VkDrawIndexedIndirectCommand) * batch.firstCommand;
+		if (_drawIndirectCount)
+			vkCmdDrawIndexedIndirectCount(cmd, frame.indirectCommands._buffer, commandOffset, frame.drawCounts._buffer, sizeof(uint32_t) * i,
+				batch.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+		else
+			vkCmdDrawIndexedIndirect(cmd, frame.indirectCommands._buffer, commandOffset, batch.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+		_meshletStats.drawCalls++;
 	}
 }
 
@@ -832,38 +2113,39 @@ AllocatedBuffer Vulkaneer::create_buffer(size_t allocSize, VkBufferUsageFlags us
 	return newBuffer;
 }
 
-size_t Vulkaneer::pad_uniform_buffer_size(size_t originalSize)
+AllocatedBuffer Vulkaneer::create_upload_target(size_t allocSize, VkBufferUsageFlags usage)
 {
-	size_t minUboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
-	size_t alignedSize = originalSize;
-	if (minUboAlignment > 0)
-		alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
-	return alignedSize;
-}
-
-void Vulkaneer::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
-{
-	VkCommandBufferAllocateInfo cmdAllocInfo = vkn::command_buffer_allocate_info(_uploadContext._commandPool, 1);
-	VkCommandBuffer cmd;
-	VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &cmd));
+	const std::vector<uint32_t> families = upload_queue_families();
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = allocSize;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (families.size() > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+		bufferInfo.pQueueFamilyIndices = families.data();
+	}
 
-	VkCommandBufferBeginInfo cmdBeginInfo = vkn::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
-	function(cmd);
-	VK_CHECK(vkEndCommandBuffer(cmd));
+	VmaAllocationCreateInfo vmaallocInfo = {};
+	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-	VkSubmitInfo submit = vkn::submit_info(&cmd);
-	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, _uploadContext._uploadFence));
+	AllocatedBuffer newBuffer;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo, &newBuffer._buffer, &newBuffer._allocation, nullptr));
+	return newBuffer;
+}
 
-	vkWaitForFences(_device, 1, &_uploadContext._uploadFence, true, 9999999999);
-	vkResetFences(_device, 1, &_uploadContext._uploadFence);
-	vkResetCommandPool(_device, _uploadContext._commandPool, 0);
+std::vector<uint32_t> Vulkaneer::upload_queue_families() const
+{
+	if (_transferQueueFamily == _graphicsQueueFamily)
+		return { _graphicsQueueFamily };
+	return { _graphicsQueueFamily, _transferQueueFamily };
 }
 
 //////////////////////////////////////////////////////////////////////////////
 ///PipelineBuilder
 //////////////////////////////////////////////////////////////////////////////
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache)
 {
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -899,7 +2181,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
 	VkPipeline newPipeline;
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
 	{
 		std::cout << "failed to create pipline\n";
 		return VK_NULL_HANDLE;
@@ -1,9 +1,20 @@
 #pragma once
 #include "vk_types.h"
 #include "vk_mesh.h"
+#include "vk_meshlet.h"
+#include "vk_lod.h"
+#include "vk_upload.h"
+#include "vk_timeline.h"
+#include "vk_retire.h"
+#include "vk_pipeline_cache.h"
+#include "vk_frame_allocator.h"
+#include "vk_render_scene.h"
+#include "vk_sort.h"
+#include "vk_asset.h"
 
 #include <deque>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <glm/glm.hpp>
 
@@ -14,13 +25,6 @@ struct Material
 	VkPipelineLayout pipelineLayout;
 };
 
-struct RenderObject
-{
-	Mesh* mesh;
-	Material* material;
-	glm::mat4 transformMatrix;
-};
-
 struct MeshPushConstants
 {
 	glm::vec4 data;
@@ -32,6 +36,63 @@ struct GPUObjectData
 	glm::mat4 modelMatrix;
 };
 
+//per object input of the culling shader, the model matrix sits at the same index of the object buffer
+struct GPUDrawObject
+{
+	uint32_t meshIndex;
+	uint32_t batchIndex;
+	uint32_t commandBase; //first indirect command of the batch
+	uint32_t objectIndex; //into the object buffer
+};
+
+//what the culling shader needs of a mesh to test it and pick the lod to draw
+struct GPUMeshInfo
+{
+	glm::vec4 sphere; //mesh space bounds, xyz origin and w radius
+	int32_t vertexOffset;
+	uint32_t firstIndex;
+	uint32_t lodCount;
+	uint32_t pad;
+	glm::uvec4 lods[vkn::MAX_MESH_LODS]; //x first index relative to the mesh, y index count, z error as float bits
+};
+
+//push constants of the culling shader, 128 bytes is what every device supports
+struct GPUCullConstants
+{
+	glm::vec4 frustum[6]; //world space, see vkn::Frustum
+	glm::vec4 camera; //xyz position, w projection scale
+	uint32_t objectCount;
+	float lodPixelError; //negative to always draw lod 0
+	uint32_t pad[2];
+};
+
+//one material and mesh pair of the gpu driven path, drawn with a single indirect call over its command range
+struct IndirectBatch
+{
+	Mesh* mesh;
+	Material* material;
+	uint32_t firstCommand;
+	uint32_t commandCount;
+};
+
+//state changes the cpu path recorded in a frame
+struct BindStats
+{
+	uint32_t pipelines;
+	uint32_t descriptorSets;
+	uint32_t vertexBuffers;
+	uint32_t indexBuffers;
+};
+
+//what recording a slice of the cpu path's draw list did, summed up once every slice finished
+struct DrawStats
+{
+	vkn::MeshletCullStats meshlets;
+	BindStats binds;
+	uint64_t triangles;
+	uint32_t instancedObjects;
+};
+
 struct GPUSceneData
 {
 	glm::vec4 fogColor; // w is for exponent
@@ -48,24 +109,44 @@ struct GPUCameraData
 	glm::mat4 viewproj;
 };
 
-struct UploadContext
-{
-	VkFence _uploadFence;
-	VkCommandPool _commandPool;
-};
-
 struct FrameData
 {
+	//binary, the swapchain takes no timeline semaphores
 	VkSemaphore _presentSemaphore, _renderSemaphore;
-	VkFence _renderFence;
+	//what the frame's submission signals on the graphics timeline, the slot is free again once it is reached
+	uint64_t submitValue{ 0 };
 
 	VkCommandPool _commandPool;
 	VkCommandBuffer _mainCommandBuffer;
 
-	AllocatedBuffer cameraBuffer;
+	//camera, scene and cpu path object data of the frame, reset once its submission retired
+	vkn::FrameAllocator transient;
+	//the transient buffer generation the camera and scene bindings were written against
+	uint32_t globalGeneration;
 	VkDescriptorSet globalDescriptor;
-	AllocatedBuffer objectBuffer;
+	//the object buffer generation the object and culling sets were written against
+	uint32_t objectGeneration;
+	//where the cpu path put this frame's instance indices in the transient buffer
+	VkDeviceSize instanceOffset;
+	VkDeviceSize instanceRange;
 	VkDescriptorSet objectDescriptor;
+
+	//written by the culling shader every frame, the counts are read back once the frame finished
+	AllocatedBuffer indirectCommands;
+	AllocatedBuffer drawCounts;
+	//drawCounts stays mapped for its whole life
+	const uint32_t* drawCountData{ nullptr };
+	//commands and counts the two buffers have room for, they only grow
+	uint32_t commandCapacity{ 0 };
+	uint32_t countCapacity{ 0 };
+	//the gpu scene generation the culling set's table bindings were written against
+	uint32_t cullGeneration;
+	VkDescriptorSet cullDescriptor;
+	bool culledOnGpu{ false };
+
+	//secondary command buffers of the cpu path, one pool each so every recording thread has its own
+	std::vector<VkCommandPool> recordPools;
+	std::vector<VkCommandBuffer> recordBuffers;
 };
 
 struct Texture
@@ -74,6 +155,19 @@ struct Texture
 	VkImageView imageView;
 };
 
+//a mesh read from disk with its vertex and index data laid out the way create_mesh_buffers takes it, source points
+//into data or into a cooked file that stays mapped until the upload took the data
+struct MeshLoad
+{
+	Mesh mesh;
+	std::vector<uint8_t> data;
+	std::unique_ptr<vkn::MappedFile> file;
+	const uint8_t* source = nullptr;
+	size_t vertexBytes = 0;
+	size_t indexOffset = 0;
+	size_t indexBytes = 0;
+};
+
 struct DeletionQueue
 {
 	std::deque<std::function<void()>> deletors;
@@ -94,6 +188,54 @@ struct DeletionQueue
 };
 
 constexpr unsigned int FRAME_OVERLAP = 3;
+//job system workers are pinned to a core each, off by default since it hurts when other processes compete for the cores
+constexpr bool PIN_JOB_THREADS = false;
+//dirty transform runs at most this many objects apart are uploaded as one copy, clean objects in the gap included
+constexpr uint32_t OBJECT_UPLOAD_MAX_GAP = 4;
+//starting size of each frame's transient buffer, it doubles whenever a frame needs more
+constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 4ull * 1024 * 1024;
+//draws each recording thread gets at least, below twice this the cpu path records inline on the main thread
+constexpr uint32_t PARALLEL_RECORD_MIN_DRAWS = 256;
+//frustum culling, lod selection and draw compaction in a compute shader, one indirect draw per batch, toggled with G
+constexpr bool GPU_DRIVEN_RENDERING = true;
+//adds this many monkeys spread through a large volume around the camera, to compare both paths from 1k to 1M objects
+constexpr unsigned int CULLING_BENCHMARK_OBJECTS = 0;
+//texture descriptor sets the pool has room for, one per material
+constexpr unsigned int MAX_TEXTURE_SETS = 256;
+//persistently mapped staging ring all mesh and texture uploads go through, larger uploads get their own staging buffer
+constexpr VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+//staging bytes a frame may submit, streaming past it waits for the next frames instead of causing a hitch
+constexpr VkDeviceSize UPLOAD_BUDGET_PER_FRAME = 8ull * 1024 * 1024;
+//the buffers every mesh is sub-allocated from, a mesh that does not fit gets buffers of its own
+constexpr VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 128ull * 1024 * 1024;
+constexpr VkDeviceSize GEOMETRY_INDEX_CAPACITY = 64ull * 1024 * 1024;
+//the S streaming test keeps this many chunks of this size queued to measure frame times under a steady upload load
+constexpr VkDeviceSize STREAM_TEST_CHUNK_SIZE = 4ull * 1024 * 1024;
+constexpr uint32_t STREAM_TEST_QUEUED_CHUNKS = 16;
+//meshes loaded straight from obj or gltf get the same optimization passes vkcook --optimize applies
+constexpr bool OPTIMIZE_OBJ_MESHES = true;
+//gpu vertex layout for meshes loaded straight from obj or gltf, cooked meshes keep the one vkcook wrote
+constexpr VertexFormat OBJ_VERTEX_FORMAT = VertexFormat::Packed;
+//meshes loaded straight from obj or gltf get meshlets like vkcook --meshlets, which enables cluster culling for them
+constexpr bool BUILD_OBJ_MESHLETS = true;
+//meshes loaded straight from obj or gltf get a lod chain like vkcook --lods
+constexpr bool GENERATE_OBJ_LODS = true;
+//largest lod error allowed on screen, in pixels
+constexpr float LOD_PIXEL_ERROR = 1.f;
+//fills the scene with a field of monkeys receding from the camera to measure triangle throughput with and without lods
+constexpr bool LOD_BENCHMARK_SCENE = false;
+//textures get a full mip chain built on the cpu before upload
+constexpr bool GENERATE_TEXTURE_MIPS = true;
+//.gltf or .glb added to the scene on startup, empty for none
+constexpr const char* GLTF_SCENE_PATH = "";
+//driver compiled pipelines kept between runs, relative to the working directory like the shader paths
+constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+//seconds between saves of the pipeline cache while running, 0 only saves at shutdown which is enough as long as
+//every pipeline is built during init
+constexpr float PIPELINE_CACHE_SAVE_SECONDS = 0.f;
+//rasterizer backface culling, the meshlet cone test is only valid with it so it follows the same switch
+//off by default because the foliage of the minecraft map is single sided and seen from both sides
+constexpr bool CULL_BACKFACES = false;
 
 class Vulkaneer
 {
@@ -105,13 +247,33 @@ public:
 
 	Material* create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
 	Material* get_material(const std::string& name);
+	//material whose pipeline matches the vertex format of the mesh
+	Material* get_mesh_material(const Mesh& mesh);
 	Mesh* get_mesh(const std::string& name);
-
-	void draw_objects(VkCommandBuffer cmd, RenderObject* first, int count);
+	//drops the mesh and every object using it, its geometry ranges return to the allocator once the frames in
+	//flight are done with them
+	bool unload_mesh(const std::string& name);
+
+	//frustum culls the scene on the cpu, sorts what is left and writes the objects to the frame's transient buffer
+	void prepare_draws();
+	//true when draw_objects records into secondary command buffers, the render pass has to begin for those then
+	bool parallel_recording() const;
+	//records what prepare_draws left inside the render pass, sliced over the worker threads when parallel_recording
+	void draw_objects(VkCommandBuffer cmd, VkFramebuffer framebuffer);
+	//records the culling dispatch, outside of the render pass
+	void cull_objects_gpu(VkCommandBuffer cmd);
+	//points the frame's culling set at the current tables, growing its command and count buffers to fit them
+	void update_cull_descriptor(FrameData& frame);
+	//draws what cull_objects_gpu kept, one indirect call per batch
+	void draw_objects_indirect(VkCommandBuffer cmd);
 
 	FrameData& get_current_frame() { return _frames[_frameNumber % FRAME_OVERLAP]; }
 	AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
-	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+	//device local and rewritten in place by the uploader while frames read it, concurrent over the graphics and the
+	//transfer family when those differ, an exclusive buffer would have to be released back to the transfer family first
+	AllocatedBuffer create_upload_target(size_t allocSize, VkBufferUsageFlags usage);
+	//the families create_upload_target shares buffers between, one when uploads run on the graphics family
+	std::vector<uint32_t> upload_queue_families() const;
 
 private:
 	void init_vulkan();
@@ -128,9 +290,29 @@ private:
 
 	void load_images();
 	void load_meshes();
+	//the cpu side of loading a mesh, safe to run on any thread, the buffers still have to be created afterwards
+	bool read_mesh(const char* objPath, MeshLoad& load);
+	bool read_cooked_mesh(const char* path, MeshLoad& load);
 	void upload_mesh(Mesh& mesh);
-
-	size_t pad_uniform_buffer_size(size_t originalSize);
+	//data holds the vertex buffer with the index buffer indexOffset bytes in, the upload manager is done with it on return
+	void create_mesh_buffers(Mesh& mesh, const uint8_t* data, size_t vertexBufferSize, size_t indexOffset, size_t indexBufferSize);
+	//uploads the meshes, textures and materials of a gltf scene once and adds an object per node and primitive
+	bool load_gltf_scene(const char* path, const glm::mat4& transform);
+
+	void print_geometry_stats();
+	//writes the camera and scene data of the current frame, shared by both render paths
+	GPUCameraData upload_frame_globals(glm::vec3& outCameraPosition);
+	//copies the transforms that changed since the last frame into the object buffer, growing it as the scene grows
+	void upload_object_transforms(VkCommandBuffer cmd);
+	//points the frame's descriptor sets at what it allocated and flushes the allocations, before anything binds them
+	void update_frame_descriptors(FrameData& frame, bool cpuObjects);
+	void bind_material(VkCommandBuffer cmd, const Material& material, VkDescriptorSet objectDescriptor);
+	//draws [begin, end) of the draw list, binding everything it needs from scratch, so slices can go to any thread
+	void record_draws(VkCommandBuffer cmd, uint32_t begin, uint32_t end, DrawStats& stats, std::vector<vkn::IndexRange>& ranges);
+	void init_gpu_culling();
+	//uploads the draw object, instance, mesh and batch tables the culling shader works from, false while meshes are
+	//still uploading
+	bool build_gpu_scene();
 
 public:
 	bool _isInitialized{ false };
@@ -159,6 +341,9 @@ public:
 
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamily;
+	//a queue of its own for uploads when the device has one, the graphics queue otherwise
+	VkQueue _transferQueue;
+	uint32_t _transferQueueFamily;
 
 	VkRenderPass _renderPass;
 	std::vector<VkFramebuffer> _framebuffers;
@@ -169,21 +354,100 @@ public:
 	VkDescriptorPool _descriptorPool;
 
 	FrameData _frames[FRAME_OVERLAP];
-	UploadContext _uploadContext;
 
-	GPUSceneData _sceneParameters;
-	AllocatedBuffer _sceneParameterBuffer;
+	//cpu meshlet culling for meshes that have meshlets, toggled with C, the stats cover the last frame
+	bool _meshletCulling{ true };
+	vkn::MeshletCullStats _meshletStats{};
+	std::vector<vkn::IndexRange> _visibleRanges;
+
+	//per object lod selection from the projected error, toggled with L, the count covers the last frame
+	bool _lodSelection{ true };
+	uint64_t _renderedTriangles{ 0 };
+
+	//every submission to the graphics queue signals the next value, frames and upload acquires alike
+	vkn::Timeline _timeline;
+	vkn::UploadManager _uploader;
+	vkn::GeometryBuffer _geometry;
+	//everything replaced or unloaded at runtime, and the loaded assets at shutdown, destroyed once the timeline passed
+	//the value they were retired with
+	vkn::RetireQueue _retired;
+	//background streaming into a scratch buffer, toggled with S, frame times are reported on every toggle
+	bool _streamTest{ false };
+	AllocatedBuffer _streamTestBuffer{};
 
-	std::vector<RenderObject> _renderables;
+	GPUSceneData _sceneParameters;
+	//dynamic offsets of the camera and scene data in the current frame's transient buffer
+	uint32_t _globalOffsets[2];
+
+	vkn::RenderScene _renderScene;
+	//every object's transform at its dense index, device local and shared by both paths, only what changed is copied
+	//in each frame, the counts cover the last frame
+	AllocatedBuffer _objectBuffer{};
+	uint32_t _objectCapacity{ 0 };
+	uint32_t _objectBufferGeneration{ 0 };
+	std::vector<vkn::ObjectRange> _dirtyObjects;
+	uint64_t _objectUploadBytes{ 0 };
+	uint32_t _objectUploadCopies{ 0 };
 	std::unordered_map<std::string, Mesh> _meshes;
 	std::unordered_map<std::string, Material> _materials;
 	std::unordered_map<std::string, Texture> _loadedTextures;
+	//shared by every glTF texture, created with the first scene
+	VkSampler _gltfSampler{ VK_NULL_HANDLE };
+
+	//cpu path frustum culling over the scene bounds, toggled with F, the counts cover the last frame
+	bool _frustumCulling{ true };
+	std::vector<uint32_t> _visibleObjects;
+	float _cullMs{ 0.f };
+	//cpu path draw order, radix sorted by vkn::make_draw_key when on, toggled with K, the counts cover the last frame
+	bool _drawSorting{ true };
+	std::vector<vkn::KeyedIndex> _drawList;
+	std::vector<vkn::KeyedIndex> _drawListScratch;
+	std::vector<uint32_t> _materialPipelineIds;
+	BindStats _bindStats{};
+	float _sortMs{ 0.f };
+	//runs of sorted draws with the same mesh and material become one instanced draw per lod, toggled with I, the count
+	//covers the last frame
+	bool _instancing{ true };
+	uint32_t _instancedObjects{ 0 };
+	//cpu path recording into secondary command buffers on the worker threads, toggled with P
+	bool _parallelRecording{ true };
+	uint32_t _recordSlices{ 0 };
+	//camera of the frame being recorded, set by prepare_draws
+	GPUCameraData _frameCamera;
+	glm::vec3 _cameraPosition;
+
+	//gpu driven path, the tables are rebuilt whenever the scene changes
+	bool _gpuDriven{ GPU_DRIVEN_RENDERING };
+	bool _drawIndirectCount{ false };
+	bool _gpuSceneDirty{ true };
+	vkn::UploadTicket _gpuSceneTicket{ 0 };
+	uint32_t _gpuObjectCount{ 0 };
+	//changes with every rebuild, each one gets tables of its own while frames in flight read the previous ones
+	uint32_t _gpuSceneGeneration{ 0 };
+	//object buffer index of every draw object, what the vertex shaders look instances up in
+	AllocatedBuffer _gpuInstanceBuffer{};
+	AllocatedBuffer _gpuDrawObjectBuffer{};
+	AllocatedBuffer _gpuMeshBuffer{};
+	std::vector<IndirectBatch> _indirectBatches;
+	VkDescriptorSetLayout _cullSetLayout;
+	VkPipelineLayout _cullPipelineLayout;
+	VkPipeline _cullPipeline{ VK_NULL_HANDLE };
+	//objects the culling shader kept in the last frame that was read back
+	uint32_t _gpuVisibleObjects{ 0 };
+	//cpu time spent recording the last frame's commands
+	float _recordMs{ 0.f };
+
+	//every pipeline is created through it
+	vkn::PipelineCache _pipelineCache;
+	//time spent in pipeline creation since startup, to compare runs with a cold and a warm cache
+	float _pipelineBuildMs{ 0.f };
+	uint32_t _pipelinesBuilt{ 0 };
 };
 
 class PipelineBuilder
 {
 public:
-	VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
+	VkPipeline build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache);
 
 public:
 	std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
@@ -0,0 +1,1131 @@
+#include "vk_mesh.h"
+#include "vk_asset.h"
+#include "vk_mesh_optimizer.h"
+#include "vk_meshlet.h"
+#include "vk_lod.h"
+#include "vk_gltf.h"
+#include "vk_image.h"
+#include "vk_image_compress.h"
+#include "vk_parallel.h"
+#include "vk_jobs.h"
+#include "vk_frame_allocator.h"
+#include "vk_geometry_buffer.h"
+#include "vk_culling.h"
+#include "vk_render_scene.h"
+#include "vk_sort.h"
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	//runs the function the requested number of times and returns the best time in milliseconds
+	double best_of(int iterations, const std::function<void()>& function)
+	{
+		double best = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			function();
+			auto end = Clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		return best;
+	}
+
+	//startup cost of the text obj path versus a cooked .vkmesh, up to the point the data sits in a staging buffer
+	int bench_mesh_load(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench mesh_load <file.obj> [iterations]" << std::endl;
+			return 1;
+		}
+
+		const std::string objPath = args[0];
+		const int iterations = args.size() > 1 ? std::stoi(args[1]) : 5;
+		const std::string cookedPath = objPath.substr(0, objPath.find_last_of('.')) + ".vkmesh";
+
+		Mesh reference;
+		if (!reference.load_from_obj(objPath.c_str()))
+			return 1;
+		if (!vkn::save_mesh_file(cookedPath.c_str(), reference))
+			return 1;
+
+		std::vector<char> staging;
+		double objTime = best_of(iterations, [&]()
+		{
+			Mesh mesh;
+			mesh.load_from_obj(objPath.c_str());
+			const size_t vertexBytes = mesh._vertices.size() * sizeof(Vertex);
+			staging.resize(vertexBytes + mesh._indices.size() * sizeof(uint32_t));
+			memcpy(staging.data(), mesh._vertices.data(), vertexBytes);
+			memcpy(staging.data() + vertexBytes, mesh._indices.data(), mesh._indices.size() * sizeof(uint32_t));
+		});
+
+		double cookedTime = best_of(iterations, [&]()
+		{
+			vkn::MappedFile file;
+			vkn::MeshFileHeader header;
+			vkn::MeshFileBlobs blobs;
+			file.open(cookedPath.c_str());
+			vkn::read_mesh_file(file, header, blobs);
+			staging.resize(header.vertexBytes + header.indexBytes);
+			memcpy(staging.data(), blobs.vertices, header.vertexBytes);
+			memcpy(staging.data() + header.vertexBytes, blobs.indices, header.indexBytes);
+		});
+
+		std::cout << "mesh_load " << objPath << " (" << reference._vertices.size() << " vertices, " << reference._indices.size() / 3 << " triangles)" << std::endl;
+		std::cout << "  obj    : " << objTime << " ms" << std::endl;
+		std::cout << "  cooked : " << cookedTime << " ms (" << objTime / cookedTime << "x faster)" << std::endl;
+		return 0;
+	}
+
+	//serial tinyobj ingest versus the chunked parallel parser, both produce the same welded mesh
+	int bench_obj_parse(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench obj_parse <file.obj> [iterations]" << std::endl;
+			return 1;
+		}
+
+		const std::string objPath = args[0];
+		const int iterations = args.size() > 1 ? std::stoi(args[1]) : 5;
+
+		Mesh serial;
+		Mesh parallel;
+		double serialTime = best_of(iterations, [&]()
+		{
+			serial.load_from_obj(objPath.c_str());
+		});
+		double parallelTime = best_of(iterations, [&]()
+		{
+			parallel.load_from_obj_parallel(objPath.c_str());
+		});
+
+		const bool identical = serial._vertices.size() == parallel._vertices.size() && serial._indices == parallel._indices
+			&& memcmp(serial._vertices.data(), parallel._vertices.data(), serial._vertices.size() * sizeof(Vertex)) == 0
+			&& memcmp(&serial._bounds, &parallel._bounds, sizeof(MeshBounds)) == 0;
+
+		std::cout << "obj_parse " << objPath << " (" << serial._vertices.size() << " vertices, " << serial._indices.size() / 3 << " triangles)" << std::endl;
+		std::cout << "  serial   : " << serialTime << " ms" << std::endl;
+		std::cout << "  parallel : " << parallelTime << " ms on " << vkn::worker_count() << " threads (" << serialTime / parallelTime << "x faster)" << std::endl;
+		std::cout << "  output   : " << (identical ? "identical" : "MISMATCH") << std::endl;
+		return identical ? 0 : 1;
+	}
+
+	//cost of each optimization pass and the vertex cache statistics it leaves behind
+	int bench_mesh_optimize(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench mesh_optimize <file.obj>" << std::endl;
+			return 1;
+		}
+
+		Mesh mesh;
+		if (!mesh.load_from_obj_parallel(args[0].c_str()))
+			return 1;
+
+		auto print_stats = [&](const char* stage, double ms)
+		{
+			const vkn::VertexCacheStats stats = vkn::analyze_vertex_cache(mesh._indices, mesh._vertices.size());
+			std::cout << "  " << stage << "ACMR " << stats.acmr << ", ATVR " << stats.atvr;
+			if (ms >= 0.0)
+				std::cout << " (" << ms << " ms)";
+			std::cout << std::endl;
+		};
+
+		std::cout << "mesh_optimize " << args[0] << " (" << mesh._vertices.size() << " vertices, " << mesh._indices.size() / 3 << " triangles)" << std::endl;
+		print_stats("input        : ", -1.0);
+		print_stats("vertex cache : ", best_of(1, [&]() { vkn::optimize_vertex_cache(mesh._indices, mesh._vertices.size()); }));
+		print_stats("overdraw     : ", best_of(1, [&]() { vkn::optimize_overdraw(mesh._indices, mesh._vertices); }));
+		print_stats("vertex fetch : ", best_of(1, [&]() { vkn::optimize_vertex_fetch(mesh._vertices, mesh._indices); }));
+		return 0;
+	}
+
+	//memory per vertex format and the worst error a round trip through the packed formats introduces
+	int bench_vertex_pack(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench vertex_pack <file.obj>" << std::endl;
+			return 1;
+		}
+
+		Mesh mesh;
+		if (!mesh.load_from_obj_parallel(args[0].c_str()))
+			return 1;
+
+		std::cout << "vertex_pack " << args[0] << " (" << mesh._vertices.size() << " vertices)" << std::endl;
+		const std::vector<Vertex> reference = mesh._vertices;
+		const char* names[] = { "full        ", "packed      ", "packed_color" };
+		for (VertexFormat format : { VertexFormat::Full, VertexFormat::Packed, VertexFormat::PackedColor })
+		{
+			Mesh packed = mesh;
+			packed._vertexFormat = format;
+			std::vector<uint8_t> data;
+			const double packTime = best_of(5, [&]() { packed.pack_vertices(data); });
+			packed.unpack_vertices(data.data(), reference.size());
+
+			float positionError = 0.f;
+			float normalError = 0.f;
+			float uvError = 0.f;
+			for (size_t i = 0; i < reference.size(); i++)
+			{
+				const Vertex& a = reference[i];
+				const Vertex& b = packed._vertices[i];
+				positionError = std::max(positionError, glm::length(a.position - b.position));
+				uvError = std::max({ uvError, std::abs(a.uv.x - b.uv.x), std::abs(a.uv.y - b.uv.y) });
+				if (glm::length(a.normal) > 0.f)
+				{
+					const float cosine = glm::dot(glm::normalize(a.normal), glm::normalize(b.normal));
+					normalError = std::max(normalError, glm::degrees(std::acos(std::min(cosine, 1.f))));
+				}
+			}
+
+			std::cout << "  " << names[static_cast<uint32_t>(format)] << " : " << vertex_stride(format) << " bytes/vertex, "
+				<< data.size() / 1024 << " KB, pack " << packTime << " ms, max error position " << positionError
+				<< " (extent " << glm::length(mesh._bounds.max - mesh._bounds.min) << "), normal " << normalError << " deg, uv " << uvError << std::endl;
+		}
+		return 0;
+	}
+
+	//meshlet build cost, then cull rates from random viewpoints around the mesh with every culled meshlet checked
+	//against its triangles: spheres must hold all their vertices and cone culled triangles must all face away
+	int bench_meshlet_cull(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench meshlet_cull <file.obj> [views]" << std::endl;
+			return 1;
+		}
+
+		const int views = args.size() > 1 ? std::stoi(args[1]) : 64;
+		Mesh mesh;
+		if (!mesh.load_from_obj_parallel(args[0].c_str()))
+			return 1;
+		vkn::optimize_mesh(mesh);
+		const double buildTime = best_of(1, [&]() { vkn::build_meshlets(mesh); });
+
+		size_t errors = 0;
+		for (const Meshlet& meshlet : mesh._meshlets)
+		{
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++)
+			{
+				const glm::vec3& p = mesh._vertices[mesh._indices[meshlet.firstIndex + i]].position;
+				errors += glm::length(p - meshlet.center) > meshlet.radius * 1.0001f + 1e-6f;
+			}
+		}
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		const glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+
+		vkn::MeshletCullStats stats = {};
+		std::vector<vkn::IndexRange> ranges;
+		double cullTime = 0.0;
+		for (int v = 0; v < views; v++)
+		{
+			//somewhere between inside the bounds and a couple of radii out, looking at a random point of the mesh
+			glm::vec3 direction{ unit(random), unit(random), unit(random) };
+			if (glm::length(direction) < 1e-3f)
+				direction = { 0.f, 0.f, 1.f };
+			const glm::vec3 eye = mesh._bounds.origin + glm::normalize(direction) * mesh._bounds.radius * (0.5f + 2.f * std::abs(unit(random)));
+			const glm::vec3 target = mesh._bounds.origin + glm::vec3{ unit(random), unit(random), unit(random) } * mesh._bounds.radius * 0.5f;
+			const glm::mat4 view = glm::lookAt(eye, target, glm::vec3{ 0.f, 1.f, 0.f });
+			const vkn::Frustum frustum = vkn::extract_frustum(projection * view);
+
+			ranges.clear();
+			cullTime += best_of(1, [&]() { vkn::cull_meshlets(mesh._meshlets, frustum, eye, true, ranges, stats); });
+
+			for (const Meshlet& meshlet : mesh._meshlets)
+			{
+				if (!vkn::meshlet_backfacing(meshlet, eye))
+					continue;
+				for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+				{
+					const uint32_t* triangle = &mesh._indices[meshlet.firstIndex + t * 3];
+					const glm::vec3& p0 = mesh._vertices[triangle[0]].position;
+					const glm::vec3& p1 = mesh._vertices[triangle[1]].position;
+					const glm::vec3& p2 = mesh._vertices[triangle[2]].position;
+					errors += glm::dot(glm::cross(p1 - p0, p2 - p0), eye - p0) > 0.f;
+				}
+			}
+		}
+
+		const float tested = float(stats.tested);
+		std::cout << "meshlet_cull " << args[0] << " (" << mesh._meshlets.size() << " meshlets, " << mesh._indices.size() / 3 << " triangles)" << std::endl;
+		std::cout << "  build     : " << buildTime << " ms" << std::endl;
+		std::cout << "  cull      : " << cullTime / views << " ms per view over " << views << " views" << std::endl;
+		std::cout << "  frustum   : " << 100.f * stats.frustumCulled / tested << "% culled" << std::endl;
+		std::cout << "  backface  : " << 100.f * stats.backfaceCulled / tested << "% culled" << std::endl;
+		std::cout << "  draws     : " << float(stats.drawCalls) / views << " per view" << std::endl;
+		std::cout << "  errors    : " << errors << std::endl;
+		return errors == 0 ? 0 : 1;
+	}
+
+	//lod chain cost and quality, then the triangles a field of instances receding from the camera submits with and
+	//without lod selection, the same layout as the engine's LOD_BENCHMARK_SCENE
+	int bench_lod_chain(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench lod_chain <file.obj> [rows] [pixel error]" << std::endl;
+			return 1;
+		}
+
+		const int rows = args.size() > 1 ? std::stoi(args[1]) : 40;
+		const float pixelError = args.size() > 2 ? std::stof(args[2]) : 1.f;
+		Mesh mesh;
+		if (!mesh.load_from_obj_parallel(args[0].c_str()))
+			return 1;
+		vkn::optimize_mesh(mesh);
+		const double buildTime = best_of(1, [&]() { vkn::generate_lods(mesh); });
+
+		std::cout << "lod_chain " << args[0] << " (" << mesh._lods[0].indexCount / 3 << " triangles, radius " << mesh._bounds.radius << ")" << std::endl;
+		std::cout << "  build : " << buildTime << " ms" << std::endl;
+		for (size_t i = 0; i < mesh._lods.size(); i++)
+		{
+			const MeshLod& lod = mesh._lods[i];
+			const vkn::VertexCacheStats stats = vkn::analyze_vertex_cache(std::vector<uint32_t>(mesh._indices.begin() + lod.firstIndex,
+				mesh._indices.begin() + lod.firstIndex + lod.indexCount), mesh._vertices.size());
+			std::cout << "  lod " << i << " : " << lod.indexCount / 3 << " triangles, error " << lod.error << ", ACMR " << stats.acmr << std::endl;
+		}
+
+		const glm::vec3 camera{ 0.f, 6.f, 10.f };
+		const float projectionScale = 900.f / (2.f * std::tan(glm::radians(70.f) * 0.5f));
+		uint64_t fullTriangles = 0;
+		uint64_t lodTriangles = 0;
+		std::vector<uint32_t> histogram(mesh._lods.size(), 0);
+		const double selectTime = best_of(5, [&]()
+		{
+			fullTriangles = 0;
+			lodTriangles = 0;
+			std::fill(histogram.begin(), histogram.end(), 0);
+			for (int z = 0; z < rows; z++)
+			{
+				for (int x = -10; x <= 10; x++)
+				{
+					const glm::mat4 model = glm::translate(glm::mat4{ 1.f }, glm::vec3{ x * 3.f, 4.f, -z * 5.f });
+					const uint32_t lod = vkn::select_lod(mesh, model, camera, projectionScale, pixelError);
+					histogram[lod]++;
+					fullTriangles += mesh._lods[0].indexCount / 3;
+					lodTriangles += mesh._lods[lod].indexCount / 3;
+				}
+			}
+		});
+
+		std::cout << "  scene : " << rows * 21 << " instances, lod selection " << selectTime << " ms" << std::endl;
+		std::cout << "  lods  :";
+		for (uint32_t count : histogram)
+			std::cout << " " << count;
+		std::cout << std::endl;
+		std::cout << "  full  : " << fullTriangles << " triangles per frame" << std::endl;
+		std::cout << "  lod   : " << lodTriangles << " triangles per frame (" << float(fullTriangles) / lodTriangles << "x fewer)" << std::endl;
+		return 0;
+	}
+
+	//gltf scene load time, and the geometry memory sharing one mesh between the nodes that reference it saves over
+	//baking a copy per node
+	int bench_gltf_load(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench gltf_load <file.gltf|glb> [iterations]" << std::endl;
+			return 1;
+		}
+
+		const int iterations = args.size() > 1 ? std::stoi(args[1]) : 5;
+		vkn::GltfScene scene;
+		bool loaded = true;
+		const double loadTime = best_of(iterations, [&]()
+		{
+			scene = {};
+			loaded = vkn::load_gltf(args[0].c_str(), scene);
+		});
+		if (!loaded)
+			return 1;
+
+		auto mesh_bytes = [](const Mesh& mesh)
+		{
+			return mesh._vertices.size() * sizeof(Vertex) + mesh._indices.size() * sizeof(uint32_t);
+		};
+
+		size_t sharedBytes = 0;
+		size_t triangles = 0;
+		for (const vkn::GltfPrimitive& primitive : scene.primitives)
+		{
+			sharedBytes += mesh_bytes(primitive.mesh);
+			triangles += primitive.mesh._indices.size() / 3;
+		}
+
+		size_t flattenedBytes = 0;
+		size_t drawnTriangles = 0;
+		size_t renderables = 0;
+		for (const vkn::GltfInstance& instance : scene.instances)
+		{
+			const vkn::GltfMesh& mesh = scene.meshes[instance.mesh];
+			for (uint32_t p = mesh.firstPrimitive; p < mesh.firstPrimitive + mesh.primitiveCount; p++)
+			{
+				flattenedBytes += mesh_bytes(scene.primitives[p].mesh);
+				drawnTriangles += scene.primitives[p].mesh._indices.size() / 3;
+				renderables++;
+			}
+		}
+
+		size_t imageBytes = 0;
+		for (const vkn::ImageData& image : scene.images)
+			imageBytes += image.pixels.size();
+
+		std::cout << "gltf_load " << args[0] << std::endl;
+		std::cout << "  load       : " << loadTime << " ms on " << vkn::worker_count() << " threads" << std::endl;
+		std::cout << "  scene      : " << scene.meshes.size() << " meshes, " << scene.primitives.size() << " primitives, "
+			<< scene.instances.size() << " instances, " << renderables << " renderables" << std::endl;
+		std::cout << "  triangles  : " << triangles << " unique, " << drawnTriangles << " drawn" << std::endl;
+		std::cout << "  images     : " << scene.images.size() << " (" << imageBytes / 1024 << " KB decoded)" << std::endl;
+		std::cout << "  geometry   : " << sharedBytes / 1024 << " KB shared, " << flattenedBytes / 1024 << " KB flattened";
+		if (sharedBytes > 0)
+			std::cout << " (" << float(flattenedBytes) / sharedBytes << "x)";
+		std::cout << std::endl;
+		return 0;
+	}
+
+	//mip chain generation against a straightforward per channel pow() implementation of the same filter, the table
+	//lookups round differently by one srgb step now and then and each level builds on the previous one, so the
+	//error can grow slightly down the chain
+	int bench_image_mips(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench image_mips <image> [iterations]" << std::endl;
+			return 1;
+		}
+
+		const int iterations = args.size() > 1 ? std::stoi(args[1]) : 3;
+		vkn::ImageData source;
+		const double decodeTime = best_of(1, [&]() { vkn::load_image(args[0].c_str(), source); });
+		if (source.pixels.empty())
+			return 1;
+
+		vkn::ImageData fast;
+		const double fastTime = best_of(iterations, [&]()
+		{
+			fast = source;
+			vkn::generate_mips(fast);
+		});
+
+		auto to_linear = [](uint8_t value)
+		{
+			const float c = value / 255.f;
+			return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		};
+		auto to_srgb = [](float l)
+		{
+			const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+			return static_cast<uint8_t>(std::min(255.f, c * 255.f + 0.5f));
+		};
+
+		vkn::ImageData reference;
+		const double referenceTime = best_of(1, [&]()
+		{
+			reference = source;
+			const uint32_t levels = vkn::mip_level_count(source.width, source.height);
+			reference.pixels.resize(vkn::mip_level_offset(reference, levels));
+			for (uint32_t level = 1; level < levels; level++)
+			{
+				const uint32_t srcWidth = vkn::mip_level_width(reference, level - 1);
+				const uint32_t srcHeight = vkn::mip_level_height(reference, level - 1);
+				const uint32_t dstWidth = vkn::mip_level_width(reference, level);
+				const uint32_t dstHeight = vkn::mip_level_height(reference, level);
+				const uint8_t* src = reference.pixels.data() + vkn::mip_level_offset(reference, level - 1);
+				uint8_t* dst = reference.pixels.data() + vkn::mip_level_offset(reference, level);
+				for (uint32_t y = 0; y < dstHeight; y++)
+				{
+					for (uint32_t x = 0; x < dstWidth; x++)
+					{
+						const uint32_t xs[2] = { std::min(x * 2, srcWidth - 1), std::min(x * 2 + 1, srcWidth - 1) };
+						const uint32_t ys[2] = { std::min(y * 2, srcHeight - 1), std::min(y * 2 + 1, srcHeight - 1) };
+						for (uint32_t c = 0; c < 4; c++)
+						{
+							float sum = 0.f;
+							for (uint32_t sy : ys)
+							{
+								for (uint32_t sx : xs)
+								{
+									const uint8_t value = src[(size_t(sy) * srcWidth + sx) * 4 + c];
+									sum += c == 3 ? value / 255.f : to_linear(value);
+								}
+							}
+							dst[(size_t(y) * dstWidth + x) * 4 + c] = c == 3 ? static_cast<uint8_t>(sum * 0.25f * 255.f + 0.5f) : to_srgb(sum * 0.25f);
+						}
+					}
+				}
+			}
+			reference.mipLevels = levels;
+		});
+
+		int maxError = 0;
+		for (size_t i = source.pixels.size(); i < reference.pixels.size(); i++)
+			maxError = std::max(maxError, std::abs(int(fast.pixels[i]) - int(reference.pixels[i])));
+
+		std::cout << "image_mips " << args[0] << " (" << source.width << "x" << source.height << ", " << fast.mipLevels << " levels)" << std::endl;
+		std::cout << "  decode    : " << decodeTime << " ms" << std::endl;
+		std::cout << "  reference : " << referenceTime << " ms" << std::endl;
+		std::cout << "  mips      : " << fastTime << " ms on " << vkn::worker_count() << " threads (" << referenceTime / fastTime << "x faster)" << std::endl;
+		std::cout << "  memory    : " << source.pixels.size() / 1024 << " KB -> " << fast.pixels.size() / 1024 << " KB" << std::endl;
+		std::cout << "  max error : " << maxError << std::endl;
+		return 0;
+	}
+
+	//encode throughput and quality of every block format on level 0 of an image, optionally cropped to its top left
+	//corner to keep large textures quick
+	int bench_texture_compress(const std::vector<std::string>& args)
+	{
+		if (args.empty())
+		{
+			std::cout << "usage: vkbench texture_compress <image> [crop size]" << std::endl;
+			return 1;
+		}
+
+		vkn::ImageData source;
+		if (!vkn::load_image(args[0].c_str(), source))
+			return 1;
+
+		vkn::ImageData image;
+		image.width = args.size() > 1 ? std::min<uint32_t>(source.width, std::stoi(args[1])) : source.width;
+		image.height = args.size() > 1 ? std::min<uint32_t>(source.height, std::stoi(args[1])) : source.height;
+		image.pixels.resize(size_t(image.width) * image.height * 4);
+		for (uint32_t y = 0; y < image.height; y++)
+			memcpy(image.pixels.data() + size_t(y) * image.width * 4, source.pixels.data() + size_t(y) * source.width * 4, size_t(image.width) * 4);
+
+		auto psnr = [](double squaredError, size_t samples)
+		{
+			if (squaredError == 0.0)
+				return 99.0;
+			return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+		};
+
+		const double megapixels = double(image.width) * image.height / 1e6;
+		std::cout << "texture_compress " << args[0] << " (" << image.width << "x" << image.height << ", " << vkn::worker_count() << " threads)" << std::endl;
+		const char* names[] = { "rgba8", "bc1", "bc3", "bc7" };
+		for (vkn::TextureFormat format : { vkn::TextureFormat::Bc1, vkn::TextureFormat::Bc3, vkn::TextureFormat::Bc7 })
+		{
+			vkn::ImageData compressed;
+			const double time = best_of(1, [&]() { vkn::compress_image(image, format, compressed); });
+			vkn::ImageData decoded;
+			vkn::decompress_image(compressed, decoded);
+
+			double colorError = 0.0;
+			double alphaError = 0.0;
+			for (size_t i = 0; i < image.pixels.size(); i++)
+			{
+				const double d = double(image.pixels[i]) - double(decoded.pixels[i]);
+				(i % 4 == 3 ? alphaError : colorError) += d * d;
+			}
+
+			const size_t texels = size_t(image.width) * image.height;
+			std::cout << "  " << names[static_cast<uint32_t>(format)] << " : " << megapixels / (time / 1000.0) << " MPix/s, "
+				<< psnr(colorError, texels * 3) << " dB rgb, " << psnr(alphaError, texels) << " dB alpha, "
+				<< float(image.pixels.size()) / compressed.pixels.size() << ":1" << std::endl;
+		}
+		return 0;
+	}
+
+	//streams meshes of random sizes and vertex formats in and out of a range allocator the size of the engine's
+	//vertex buffer, keeping it close to full so the free list has to work for every allocation
+	int bench_geometry_alloc(const std::vector<std::string>& args)
+	{
+		const int operations = args.size() > 0 ? std::stoi(args[0]) : 1000000;
+		const VkDeviceSize capacity = (args.size() > 1 ? std::stoull(args[1]) : 128ull) * 1024 * 1024;
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> logSize(std::log(4.f * 1024.f), std::log(4.f * 1024.f * 1024.f));
+		const uint32_t strides[] = { vertex_stride(VertexFormat::Full), vertex_stride(VertexFormat::Packed), vertex_stride(VertexFormat::PackedColor) };
+
+		vkn::RangeAllocator allocator;
+		allocator.init(capacity);
+		struct Live
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+		std::vector<Live> live;
+		int allocations = 0;
+		int failures = 0;
+		float worstFragmentation = 0.f;
+
+		const double time = best_of(1, [&]()
+		{
+			for (int i = 0; i < operations; i++)
+			{
+				//the longer allocations keep failing the more likely a free gets, which holds the fill level steady
+				if (live.empty() || rng() % 2 == 0)
+				{
+					const uint32_t stride = strides[rng() % 3];
+					const VkDeviceSize size = static_cast<VkDeviceSize>(std::exp(logSize(rng))) / stride * stride + stride;
+					VkDeviceSize offset;
+					if (allocator.allocate(size, stride, offset))
+					{
+						live.push_back({ offset, size });
+						allocations++;
+						continue;
+					}
+					failures++;
+					worstFragmentation = std::max(worstFragmentation, allocator.stats().fragmentation);
+				}
+				const size_t victim = rng() % live.size();
+				allocator.free(live[victim].offset, live[victim].size);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+		});
+
+		const vkn::RangeStats stats = allocator.stats();
+		std::cout << operations << " operations in " << time << " ms, " << time * 1000.0 / operations << " us each" << std::endl;
+		std::cout << allocations << " allocations, " << failures << " failed, worst fragmentation at a failure "
+			<< worstFragmentation * 100.f << "%" << std::endl;
+		std::cout << "end state: " << stats.allocations << " live, " << stats.used * 100.0 / stats.capacity << "% used, "
+			<< stats.freeRanges << " free ranges, largest " << stats.largestFree / 1024 << " KB, "
+			<< stats.fragmentation * 100.f << "% fragmented" << std::endl;
+		return 0;
+	}
+
+	//object culling at scene scale, the scalar test over an array of spheres against the structure of arrays one on a
+	//single thread and spread over the workers, all three have to keep exactly the same objects
+	int bench_frustum_cull(const std::vector<std::string>& args)
+	{
+		std::vector<size_t> counts;
+		for (const std::string& arg : args)
+			counts.push_back(std::stoull(arg));
+		if (counts.empty())
+			counts = { 100000, 1000000 };
+
+		//objects scattered through a cube around the camera, which sees roughly a tenth of it
+		const glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3{ 0.f, 6.f, 10.f }, glm::vec3{ 0.f }, glm::vec3{ 0.f, 1.f, 0.f });
+		const vkn::Frustum frustum = vkn::extract_frustum(projection * view);
+
+		int result = 0;
+		for (size_t count : counts)
+		{
+			std::mt19937 rng(7);
+			std::uniform_real_distribution<float> position(-200.f, 200.f);
+			std::uniform_real_distribution<float> radius(0.5f, 4.f);
+			std::vector<glm::vec4> spheres(count);
+			vkn::SphereArrays arrays;
+			arrays.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				spheres[i] = glm::vec4(position(rng), position(rng), position(rng), radius(rng));
+				arrays.set(i, glm::vec3(spheres[i]), spheres[i].w);
+			}
+
+			std::vector<uint32_t> scalarVisible;
+			scalarVisible.reserve(count);
+			const double scalarTime = best_of(10, [&]()
+			{
+				scalarVisible.clear();
+				for (size_t i = 0; i < count; i++)
+				{
+					if (vkn::sphere_in_frustum(frustum, glm::vec3(spheres[i]), spheres[i].w))
+						scalarVisible.push_back(static_cast<uint32_t>(i));
+				}
+			});
+
+			std::vector<uint32_t> simdVisible(count);
+			size_t simdCount = 0;
+			const double simdTime = best_of(10, [&]() { simdCount = vkn::cull_sphere_range(frustum, arrays, 0, count, simdVisible.data()); });
+			simdVisible.resize(simdCount);
+
+			std::vector<uint32_t> parallelVisible;
+			const double parallelTime = best_of(10, [&]() { vkn::cull_spheres(frustum, arrays, parallelVisible); });
+
+			const bool match = simdVisible == scalarVisible && parallelVisible == scalarVisible;
+			std::cout << "frustum_cull " << count << " objects, " << scalarVisible.size() << " visible" << std::endl;
+			std::cout << "  scalar    : " << scalarTime << " ms, " << scalarTime * 1e6 / count << " ns per object" << std::endl;
+			std::cout << "  simd      : " << simdTime << " ms, " << simdTime * 1e6 / count << " ns per object, " << scalarTime / simdTime << "x" << std::endl;
+			std::cout << "  threaded  : " << parallelTime << " ms, " << parallelTime * 1e6 / count << " ns per object, " << scalarTime / parallelTime
+				<< "x on " << (count < vkn::PARALLEL_CULL_THRESHOLD ? 1 : vkn::worker_count()) << " threads" << std::endl;
+			std::cout << "  results   : " << (match ? "identical" : "MISMATCH") << std::endl;
+			result |= match ? 0 : 1;
+		}
+		return result;
+	}
+
+	//the per frame passes over a scene kept as one struct per object, the way the engine used to, against the same
+	//scene in a RenderScene: culling, then gathering transforms and mesh/material keys of what is visible
+	//both culls use the scalar test so the difference is the memory layout, the simd cull is listed on top of that
+	int bench_render_scene(const std::vector<std::string>& args)
+	{
+		std::vector<size_t> counts;
+		for (const std::string& arg : args)
+			counts.push_back(std::stoull(arg));
+		if (counts.empty())
+			counts = { 100000, 1000000 };
+
+		//a handful of meshes living in map nodes like the engine's, materials are only ever compared, never read
+		std::unordered_map<std::string, Mesh> meshMap;
+		std::vector<Mesh*> meshes;
+		for (int m = 0; m < 16; m++)
+		{
+			Mesh& mesh = meshMap["mesh" + std::to_string(m)];
+			mesh._bounds.origin = glm::vec3(0.f);
+			mesh._bounds.radius = 1.f + m * 0.25f;
+			meshes.push_back(&mesh);
+		}
+		std::vector<uint64_t> materialStorage(8);
+		std::vector<Material*> materials;
+		for (uint64_t& material : materialStorage)
+			materials.push_back(reinterpret_cast<Material*>(&material));
+
+		const glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3{ 0.f, 6.f, 10.f }, glm::vec3{ 0.f }, glm::vec3{ 0.f, 1.f, 0.f });
+		const vkn::Frustum frustum = vkn::extract_frustum(projection * view);
+
+		struct ObjectStruct
+		{
+			Mesh* mesh;
+			Material* material;
+			glm::mat4 transform;
+			glm::vec4 sphere;
+		};
+
+		for (size_t count : counts)
+		{
+			std::mt19937 rng(11);
+			std::uniform_real_distribution<float> position(-200.f, 200.f);
+			std::vector<ObjectStruct> structs(count);
+			vkn::RenderScene scene;
+			std::vector<vkn::RenderHandle> handles(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				ObjectStruct& object = structs[i];
+				object.mesh = meshes[rng() % meshes.size()];
+				object.material = materials[rng() % materials.size()];
+				object.transform = glm::translate(glm::mat4{ 1.f }, glm::vec3{ position(rng), position(rng), position(rng) });
+				object.sphere = glm::vec4(glm::vec3(object.transform[3]), object.mesh->_bounds.radius);
+				handles[i] = scene.add(object.mesh, object.material, object.transform);
+			}
+
+			std::vector<uint32_t> visible;
+			visible.reserve(count);
+			std::vector<glm::mat4> upload(count);
+			std::vector<uint64_t> keys(count);
+			uint64_t checksum[2] = {};
+
+			const double structCull = best_of(10, [&]()
+			{
+				visible.clear();
+				for (size_t i = 0; i < count; i++)
+				{
+					if (vkn::sphere_in_frustum(frustum, glm::vec3(structs[i].sphere), structs[i].sphere.w))
+						visible.push_back(static_cast<uint32_t>(i));
+				}
+			});
+			const double structGather = best_of(10, [&]()
+			{
+				for (size_t i = 0; i < visible.size(); i++)
+				{
+					const ObjectStruct& object = structs[visible[i]];
+					upload[i] = object.transform;
+					keys[i] = reinterpret_cast<uintptr_t>(object.material) ^ reinterpret_cast<uintptr_t>(object.mesh);
+				}
+			});
+			checksum[0] = visible.size();
+
+			const vkn::SphereArrays& bounds = scene.bounds();
+			const double arrayCull = best_of(10, [&]()
+			{
+				visible.clear();
+				for (size_t i = 0; i < count; i++)
+				{
+					if (vkn::sphere_in_frustum(frustum, glm::vec3(bounds.x[i], bounds.y[i], bounds.z[i]), bounds.radius[i]))
+						visible.push_back(static_cast<uint32_t>(i));
+				}
+			});
+			const double simdCull = best_of(10, [&]() { vkn::cull_spheres(frustum, bounds, visible); });
+			const double arrayGather = best_of(10, [&]()
+			{
+				const std::vector<glm::mat4>& transforms = scene.transforms();
+				const std::vector<uint32_t>& meshIds = scene.mesh_ids();
+				const std::vector<uint32_t>& materialIds = scene.material_ids();
+				for (size_t i = 0; i < visible.size(); i++)
+				{
+					upload[i] = transforms[visible[i]];
+					keys[i] = (uint64_t(materialIds[visible[i]]) << 32) | meshIds[visible[i]];
+				}
+			});
+			checksum[1] = visible.size();
+
+			//a tenth of the scene removed through handles and added again, every stale handle has to be rejected
+			std::vector<size_t> victims(count / 10);
+			for (size_t& victim : victims)
+				victim = rng() % count;
+			size_t staleAccepted = 0;
+			const double churn = best_of(1, [&]()
+			{
+				for (size_t victim : victims)
+				{
+					if (!scene.remove(handles[victim]))
+						continue;
+					const vkn::RenderHandle stale = handles[victim];
+					handles[victim] = scene.add(structs[victim].mesh, structs[victim].material, structs[victim].transform);
+					staleAccepted += scene.valid(stale);
+				}
+			});
+
+			std::cout << "render_scene " << count << " objects, " << checksum[1] << " visible" << std::endl;
+			std::cout << "  cull      : structs " << structCull << " ms (" << sizeof(ObjectStruct) << " bytes per object), arrays " << arrayCull
+				<< " ms (16 bytes), " << structCull / arrayCull << "x, simd arrays " << simdCull << " ms" << std::endl;
+			std::cout << "  gather    : structs " << structGather << " ms, arrays " << arrayGather << " ms, " << structGather / arrayGather << "x" << std::endl;
+			std::cout << "  churn     : " << churn * 1e6 / (2.0 * victims.size()) << " ns per remove or add, " << staleAccepted << " stale handles accepted" << std::endl;
+			if (checksum[0] != checksum[1] || staleAccepted != 0 || scene.size() != count)
+				return 1;
+		}
+		return 0;
+	}
+
+	//draw lists in scene order sorted by draw key, the radix sort against std::stable_sort, and the pipeline, material
+	//and mesh changes a submission walking the list would make before and after
+	int bench_draw_sort(const std::vector<std::string>& args)
+	{
+		std::vector<size_t> counts;
+		for (const std::string& arg : args)
+			counts.push_back(std::stoull(arg));
+		if (counts.empty())
+			counts = { 10000, 100000, 1000000 };
+
+		for (size_t count : counts)
+		{
+			std::mt19937 rng(3);
+			std::uniform_real_distribution<float> depth(0.f, 1.f);
+			struct Draw
+			{
+				uint32_t pipeline;
+				uint32_t material;
+				uint32_t mesh;
+			};
+			std::vector<Draw> draws(count);
+			std::vector<vkn::KeyedIndex> items(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				//materials belong to one of a few pipelines, like the engine's one per vertex format
+				const uint32_t material = rng() % 64;
+				draws[i] = { material % 3, material, static_cast<uint32_t>(rng() % 256) };
+				items[i] = { vkn::make_draw_key(0, draws[i].pipeline, draws[i].material, draws[i].mesh, depth(rng)), static_cast<uint32_t>(i) };
+			}
+
+			auto state_changes = [&](const std::vector<vkn::KeyedIndex>& list, uint32_t (&changes)[3])
+			{
+				changes[0] = changes[1] = changes[2] = 0;
+				Draw last = { ~0u, ~0u, ~0u };
+				for (const vkn::KeyedIndex& item : list)
+				{
+					const Draw& draw = draws[item.index];
+					changes[0] += draw.pipeline != last.pipeline;
+					changes[1] += draw.material != last.material;
+					changes[2] += draw.mesh != last.mesh || draw.material != last.material;
+					last = draw;
+				}
+			};
+			uint32_t before[3];
+			state_changes(items, before);
+
+			std::vector<vkn::KeyedIndex> sorted;
+			std::vector<vkn::KeyedIndex> scratch;
+			const double radixTime = best_of(10, [&]()
+			{
+				sorted = items;
+				vkn::radix_sort(sorted, scratch);
+			});
+			std::vector<vkn::KeyedIndex> reference;
+			const double stdTime = best_of(10, [&]()
+			{
+				reference = items;
+				std::stable_sort(reference.begin(), reference.end(), [](const vkn::KeyedIndex& a, const vkn::KeyedIndex& b) { return a.key < b.key; });
+			});
+			uint32_t after[3];
+			state_changes(sorted, after);
+
+			bool match = true;
+			for (size_t i = 0; i < count; i++)
+				match &= sorted[i].index == reference[i].index;
+
+			std::cout << "draw_sort " << count << " draws" << std::endl;
+			std::cout << "  radix     : " << radixTime << " ms, std::stable_sort " << stdTime << " ms, " << stdTime / radixTime << "x" << std::endl;
+			std::cout << "  pipelines : " << before[0] << " -> " << after[0] << " changes" << std::endl;
+			std::cout << "  materials : " << before[1] << " -> " << after[1] << " changes" << std::endl;
+			std::cout << "  meshes    : " << before[2] << " -> " << after[2] << " changes" << std::endl;
+			std::cout << "  results   : " << (match ? "identical" : "MISMATCH") << std::endl;
+			if (!match)
+				return 1;
+		}
+		return 0;
+	}
+
+	//job system scheduling cost per empty task, per task of a dependency chain, and the scaling efficiency of a batch
+	//of equal compute bound tasks, for each total thread count given (the waiting thread included), "pin" pins workers
+	int bench_jobs(const std::vector<std::string>& args)
+	{
+		bool pin = false;
+		std::vector<uint32_t> threadCounts;
+		for (const std::string& arg : args)
+		{
+			if (arg == "pin")
+				pin = true;
+			else
+				threadCounts.push_back(static_cast<uint32_t>(std::stoul(arg)));
+		}
+		if (threadCounts.empty())
+		{
+			const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+			for (uint32_t count = 1; count < cores; count *= 2)
+				threadCounts.push_back(count);
+			threadCounts.push_back(cores);
+		}
+
+		constexpr size_t emptyTasks = 100000;
+		constexpr size_t chainTasks = 10000;
+		constexpr size_t workTasks = 4096;
+		constexpr int workIterations = 20000;
+
+		auto empty_job = [](void*, size_t) {};
+		auto work_job = [](void* data, size_t index)
+		{
+			float value = static_cast<float>(index);
+			for (int i = 0; i < workIterations; i++)
+				value = std::sqrt(value * value + 1.f);
+			static_cast<float*>(data)[index] = value;
+		};
+
+		std::vector<float> reference(workTasks);
+		for (size_t i = 0; i < workTasks; i++)
+			work_job(reference.data(), i);
+
+		std::cout << "jobs " << emptyTasks << " empty, " << chainTasks << " chained, " << workTasks << " tasks of "
+			<< workIterations << " sqrt" << (pin ? ", pinned" : "") << std::endl;
+		double singleTime = 0.0;
+		for (uint32_t threads : threadCounts)
+		{
+			vkn::JobSystem system;
+			system.init(std::max(1u, threads) - 1, pin);
+
+			const double emptyTime = best_of(5, [&]()
+			{
+				vkn::JobCounter counter;
+				for (size_t i = 0; i < emptyTasks; i++)
+					system.submit({ empty_job, nullptr, i, &counter });
+				system.wait(counter);
+			});
+
+			//every task only becomes runnable once the one before it finished
+			const double chainTime = best_of(5, [&]()
+			{
+				std::unique_ptr<vkn::JobCounter[]> counters(new vkn::JobCounter[chainTasks]);
+				system.submit({ empty_job, nullptr, 0, &counters[0] });
+				for (size_t i = 1; i < chainTasks; i++)
+					system.submit_after(counters[i - 1], { empty_job, nullptr, i, &counters[i] });
+				system.wait(counters[chainTasks - 1]);
+			});
+
+			std::vector<float> results(workTasks);
+			const double workTime = best_of(5, [&]()
+			{
+				vkn::JobCounter counter;
+				for (size_t i = 0; i < workTasks; i++)
+					system.submit({ work_job, results.data(), i, &counter });
+				system.wait(counter);
+			});
+			if (threads == threadCounts[0])
+				singleTime = workTime * threadCounts[0];
+
+			const bool match = results == reference;
+			std::cout << "  " << threads << " threads : " << emptyTime * 1e6 / emptyTasks << " ns per task, "
+				<< chainTime * 1e6 / chainTasks << " ns per chained task, work " << workTime << " ms, "
+				<< 100.0 * singleTime / (workTime * threads) << "% efficiency" << (match ? "" : ", MISMATCH") << std::endl;
+			if (!match)
+				return 1;
+		}
+		return 0;
+	}
+
+	//writing a frame's object matrices in draw order, plain copies against the non temporal stores the frame allocator
+	//uses, into plain memory here, the gap is wider on the write combined memory the engine writes to
+	int bench_frame_write(const std::vector<std::string>& args)
+	{
+		std::vector<size_t> counts;
+		for (const std::string& arg : args)
+			counts.push_back(std::stoull(arg));
+		if (counts.empty())
+			counts = { 10000, 100000, 1000000 };
+
+		for (size_t count : counts)
+		{
+			std::mt19937 rng(5);
+			std::vector<glm::mat4> transforms(count);
+			for (size_t i = 0; i < count; i++)
+				transforms[i] = glm::translate(glm::mat4{ 1.f }, glm::vec3(float(rng() % 1000), float(rng() % 1000), float(rng() % 1000)));
+			std::vector<uint32_t> order(count);
+			for (size_t i = 0; i < count; i++)
+				order[i] = static_cast<uint32_t>(i);
+			std::shuffle(order.begin(), order.end(), rng);
+
+			//a destination that starts on a cache line like the allocator's storage alignment guarantees
+			std::vector<glm::mat4> storage(count + 1);
+			glm::mat4* destination = reinterpret_cast<glm::mat4*>((reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+
+			const double copyTime = best_of(10, [&]()
+			{
+				for (size_t i = 0; i < count; i++)
+					memcpy(&destination[i], &transforms[order[i]], sizeof(glm::mat4));
+			});
+			const double streamTime = best_of(10, [&]()
+			{
+				for (size_t i = 0; i < count; i++)
+					vkn::stream_copy(&destination[i], &transforms[order[i]], sizeof(glm::mat4));
+			});
+			bool match = true;
+			for (size_t i = 0; i < count; i++)
+				match &= destination[i] == transforms[order[i]];
+
+			std::cout << "frame_write " << count << " objects, " << count * sizeof(glm::mat4) / (1024.f * 1024.f) << " MB" << std::endl;
+			std::cout << "  memcpy    : " << copyTime << " ms, " << count * sizeof(glm::mat4) / (copyTime * 1e6) << " GB/s" << std::endl;
+			std::cout << "  streamed  : " << streamTime << " ms, " << count * sizeof(glm::mat4) / (streamTime * 1e6) << " GB/s, "
+				<< copyTime / streamTime << "x" << std::endl;
+			if (!match)
+				return 1;
+		}
+		return 0;
+	}
+
+	//a frame's transform upload when a share of the objects moved, the dirty ranges the render scene hands out against
+	//rewriting every object, bytes and the cpu time to find the ranges and pack them for the copy
+	int bench_object_upload(const std::vector<std::string>& args)
+	{
+		std::vector<size_t> counts;
+		for (const std::string& arg : args)
+			counts.push_back(std::stoull(arg));
+		if (counts.empty())
+			counts = { 100000, 1000000 };
+
+		Mesh mesh;
+		mesh._bounds.origin = glm::vec3(0.f);
+		mesh._bounds.radius = 1.f;
+		uint64_t materialStorage = 0;
+		Material* material = reinterpret_cast<Material*>(&materialStorage);
+		const float movedShares[] = { 0.f, 0.001f, 0.01f, 0.1f, 1.f };
+
+		for (size_t count : counts)
+		{
+			std::mt19937 rng(13);
+			std::uniform_real_distribution<float> position(-200.f, 200.f);
+			vkn::RenderScene scene;
+			std::vector<vkn::RenderHandle> handles(count);
+			for (size_t i = 0; i < count; i++)
+				handles[i] = scene.add(&mesh, material, glm::translate(glm::mat4{ 1.f }, glm::vec3(position(rng), position(rng), position(rng))));
+			std::vector<vkn::ObjectRange> ranges;
+			scene.take_dirty_ranges(4, ranges);
+
+			std::vector<glm::mat4> staging(count);
+			const double fullTime = best_of(10, [&]()
+			{
+				memcpy(staging.data(), scene.transforms().data(), sizeof(glm::mat4) * count);
+			});
+
+			std::cout << "object_upload " << count << " objects, full rewrite " << sizeof(glm::mat4) * count / 1024.f << " KB in " << fullTime << " ms" << std::endl;
+			for (float share : movedShares)
+			{
+				const size_t moved = static_cast<size_t>(count * share);
+				std::vector<uint32_t> movers(moved);
+				for (uint32_t& mover : movers)
+					mover = static_cast<uint32_t>(rng() % count);
+
+				//only finding and packing the ranges counts, moving the objects is the game's cost
+				size_t bytes = 0;
+				double dirtyTime = 1e30;
+				for (int iteration = 0; iteration < 10; iteration++)
+				{
+					for (uint32_t mover : movers)
+						scene.set_transform(handles[mover], glm::translate(glm::mat4{ 1.f }, glm::vec3(position(rng), position(rng), position(rng))));
+
+					const auto start = Clock::now();
+					scene.take_dirty_ranges(4, ranges);
+					bytes = 0;
+					for (const vkn::ObjectRange& range : ranges)
+					{
+						memcpy(reinterpret_cast<uint8_t*>(staging.data()) + bytes, &scene.transforms()[range.first], sizeof(glm::mat4) * range.count);
+						bytes += sizeof(glm::mat4) * range.count;
+					}
+					dirtyTime = std::min(dirtyTime, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+				}
+				std::cout << "  " << share * 100.f << "% moved : " << bytes / 1024.f << " KB in " << ranges.size() << " copies, "
+					<< dirtyTime << " ms, " << 100.0 * bytes / (sizeof(glm::mat4) * count) << "% of a full rewrite" << std::endl;
+			}
+		}
+		return 0;
+	}
+
+	struct Benchmark
+	{
+		const char* name;
+		int (*run)(const std::vector<std::string>& args);
+	};
+
+	const Benchmark benchmarks[] =
+	{
+		{ "mesh_load", bench_mesh_load },
+		{ "obj_parse", bench_obj_parse },
+		{ "mesh_optimize", bench_mesh_optimize },
+		{ "vertex_pack", bench_vertex_pack },
+		{ "meshlet_cull", bench_meshlet_cull },
+		{ "lod_chain", bench_lod_chain },
+		{ "gltf_load", bench_gltf_load },
+		{ "image_mips", bench_image_mips },
+		{ "texture_compress", bench_texture_compress },
+		{ "geometry_alloc", bench_geometry_alloc },
+		{ "frustum_cull", bench_frustum_cull },
+		{ "render_scene", bench_render_scene },
+		{ "draw_sort", bench_draw_sort },
+		{ "jobs", bench_jobs },
+		{ "frame_write", bench_frame_write },
+		{ "object_upload", bench_object_upload },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: vkbench <benchmark> [args...]" << std::endl << "benchmarks:" << std::endl;
+		for (const Benchmark& b : benchmarks)
+			std::cout << "  " << b.name << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> args(argv + 2, argv + argc);
+	for (const Benchmark& b : benchmarks)
+	{
+		if (b.name == std::string(argv[1]))
+			return b.run(args);
+	}
+
+	std::cout << "unknown benchmark " << argv[1] << std::endl;
+	return 1;
+}
@@ -0,0 +1,214 @@
+#include "vk_mesh.h"
+#include "vk_asset.h"
+#include "vk_mesh_optimizer.h"
+#include "vk_meshlet.h"
+#include "vk_lod.h"
+#include "vk_image.h"
+#include "vk_image_compress.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct CookOptions
+	{
+		bool optimize{ false };
+		bool meshlets{ false };
+		bool lods{ false };
+		VertexFormat vertexFormat{ VertexFormat::Full };
+		vkn::TextureQuality textureQuality{ vkn::TextureQuality::High };
+	};
+
+	void print_usage()
+	{
+		std::cout << "usage: vkcook [--optimize] [--meshlets] [--lods] [--format full|packed|packed_color] [--texture-quality fast|high] <input>... [-o output]" << std::endl;
+		std::cout << "  .obj inputs become .vkmesh, images (.png .jpg .tga .bmp) become .vktex" << std::endl;
+		std::cout << "  without -o every input is cooked next to itself with the cooked extension" << std::endl;
+		std::cout << "  --optimize reorders triangles and vertices for the vertex cache, overdraw and vertex fetch" << std::endl;
+		std::cout << "  --meshlets groups the triangles into meshlets with bounds and normal cones for cluster culling" << std::endl;
+		std::cout << "  --lods appends a simplified lod chain to the index buffer, each level about half the triangles of the last" << std::endl;
+		std::cout << "  --format selects the vertex layout, packed is 16 bytes, packed_color adds rgba8 for 20, full is 44" << std::endl;
+		std::cout << "  --texture-quality picks bc1, or bc3 for images with alpha, when fast and bc7 when high, the default" << std::endl;
+	}
+
+	bool parse_texture_quality(const std::string& name, vkn::TextureQuality& outQuality)
+	{
+		if (name == "fast")
+			outQuality = vkn::TextureQuality::Fast;
+		else if (name == "high")
+			outQuality = vkn::TextureQuality::High;
+		else
+			return false;
+		return true;
+	}
+
+	bool is_image(const std::string& input)
+	{
+		std::string extension = input.substr(input.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+		return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+	}
+
+	bool parse_vertex_format(const std::string& name, VertexFormat& outFormat)
+	{
+		if (name == "full")
+			outFormat = VertexFormat::Full;
+		else if (name == "packed")
+			outFormat = VertexFormat::Packed;
+		else if (name == "packed_color")
+			outFormat = VertexFormat::PackedColor;
+		else
+			return false;
+		return true;
+	}
+
+	std::string cooked_path_for(const std::string& input)
+	{
+		return input.substr(0, input.find_last_of('.')) + (is_image(input) ? ".vktex" : ".vkmesh");
+	}
+
+	bool cook_texture(const std::string& input, const std::string& output, const CookOptions& options)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		vkn::ImageData image;
+		if (!vkn::load_image(input.c_str(), image))
+		{
+			std::cout << "Failed to load " << input << std::endl;
+			return false;
+		}
+
+		vkn::generate_mips(image);
+		const vkn::TextureFormat format = vkn::select_texture_format(image, options.textureQuality);
+		vkn::ImageData compressed;
+		vkn::compress_image(image, format, compressed);
+		if (!vkn::save_texture_file(output.c_str(), compressed))
+		{
+			std::cout << "Failed to write " << output << std::endl;
+			return false;
+		}
+
+		const char* formatNames[] = { "rgba8", "bc1", "bc3", "bc7" };
+		auto end = std::chrono::high_resolution_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+		std::cout << "Cooked " << input << " -> " << output << " (" << image.width << "x" << image.height << ", " << compressed.mipLevels << " mips, "
+			<< formatNames[static_cast<uint32_t>(format)] << ", " << compressed.pixels.size() / 1024 << " KB) in " << diff.count() << " ms" << std::endl;
+		return true;
+	}
+
+	bool cook_mesh(const std::string& input, const std::string& output, const CookOptions& options)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Mesh mesh;
+		if (!mesh.load_from_obj_parallel(input.c_str()))
+		{
+			std::cout << "Failed to load " << input << std::endl;
+			return false;
+		}
+
+		if (options.optimize)
+		{
+			const vkn::MeshOptimizeStats stats = vkn::optimize_mesh(mesh);
+			std::cout << "  optimized, ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+				<< ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+		}
+		if (options.meshlets)
+		{
+			vkn::build_meshlets(mesh);
+			size_t totalVertices = 0;
+			for (const Meshlet& meshlet : mesh._meshlets)
+				totalVertices += meshlet.vertexCount;
+			if (!mesh._meshlets.empty())
+				std::cout << "  built " << mesh._meshlets.size() << " meshlets, " << float(mesh._indices.size() / 3) / mesh._meshlets.size() << " triangles and "
+					<< float(totalVertices) / mesh._meshlets.size() << " vertices on average" << std::endl;
+		}
+		if (options.lods)
+		{
+			vkn::generate_lods(mesh);
+			if (!mesh._lods.empty())
+			{
+				std::cout << "  generated " << mesh._lods.size() << " lods, triangles";
+				for (const MeshLod& lod : mesh._lods)
+					std::cout << " " << lod.indexCount / 3;
+				std::cout << ", coarsest error " << mesh._lods.back().error << std::endl;
+			}
+		}
+
+		mesh._vertexFormat = options.vertexFormat;
+		if (!vkn::save_mesh_file(output.c_str(), mesh, options.optimize ? vkn::MESH_FILE_FLAG_OPTIMIZED : 0))
+		{
+			std::cout << "Failed to write " << output << std::endl;
+			return false;
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+		std::cout << "Cooked " << input << " -> " << output << " (" << mesh._vertices.size() << " vertices, "
+			<< (mesh._lods.empty() ? mesh._indices.size() : mesh._lods[0].indexCount) / 3 << " triangles, " << vertex_stride(mesh._vertexFormat) << " byte vertices) in " << diff.count() << " ms" << std::endl;
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> inputs;
+	std::string output;
+	CookOptions options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			output = argv[++i];
+		else if (arg == "--optimize")
+			options.optimize = true;
+		else if (arg == "--meshlets")
+			options.meshlets = true;
+		else if (arg == "--lods")
+			options.lods = true;
+		else if (arg == "--format" && i + 1 < argc)
+		{
+			if (!parse_vertex_format(argv[++i], options.vertexFormat))
+			{
+				print_usage();
+				return 1;
+			}
+		}
+		else if (arg == "--texture-quality" && i + 1 < argc)
+		{
+			if (!parse_texture_quality(argv[++i], options.textureQuality))
+			{
+				print_usage();
+				return 1;
+			}
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		else
+			inputs.push_back(arg);
+	}
+
+	if (inputs.empty() || (!output.empty() && inputs.size() > 1))
+	{
+		print_usage();
+		return 1;
+	}
+
+	bool success = true;
+	for (const std::string& input : inputs)
+	{
+		const std::string cooked = output.empty() ? cooked_path_for(input) : output;
+		success &= is_image(input) ? cook_texture(input, cooked, options) : cook_mesh(input, cooked, options);
+	}
+
+	return success ? 0 : 1;
+}